@@ -2,9 +2,23 @@
 
 #include <imgui.h>
 
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <memory>
 #include <mutex>
-
-// From ImGui examples
+#include <utility>
+#include <vector>
+
+// From ImGui examples, reworked to keep a bounded amount of text.
+//
+// Text lives in a fixed-size ring of bytes, with a second ring indexing where each line starts.
+// A line is never split across the end of the buffer: if it doesn't fit before the end we wrap
+// to the start, so every line can be handed to ImGui as one contiguous range. When space or
+// index slots run out, the oldest lines are dropped. Nothing is allocated after construction.
 struct AppLog
 {
     static AppLog& get()
@@ -13,14 +27,20 @@ struct AppLog
         return log;
     }
 
+    static constexpr std::size_t kCapacity = 4u << 20; // Bytes of text kept
+    static constexpr std::size_t kMaxLines = 1u << 16;
+
     std::mutex m_Mutex;
 
-    ImGuiTextBuffer Buf;
+    // Bumped on every change, so the UI knows to redraw
+    std::atomic<unsigned> m_Revision = 0;
+
     ImGuiTextFilter Filter;
-    ImVector<int>   LineOffsets; // Index to lines offset. We maintain this with AddLog() calls.
-    bool            AutoScroll;  // Keep scrolling if already at the bottom.
+    bool            AutoScroll; // Keep scrolling if already at the bottom.
 
     AppLog()
+    : m_Text(std::make_unique<char[]>(kCapacity))
+    , m_Lines(kMaxLines)
     {
         AutoScroll = true;
         Clear();
@@ -28,27 +48,28 @@ struct AppLog
 
     void Clear()
     {
-        Buf.clear();
-        LineOffsets.clear();
-        LineOffsets.push_back(0);
+        m_FirstSerial += m_LineCount;
+        m_Head      = 0;
+        m_FirstLine = 0;
+        m_LineCount = 0;
+        m_Matches.clear();
+        ++m_Revision;
     }
 
-    void Log(const char* fmt, ...) IM_FMTARGS(2)
+    // Copies already formatted text into the log, one line per '\n'.
+    void Append(const char* text, std::size_t size)
     {
         std::lock_guard<std::mutex> lock(m_Mutex);
 
-        int     old_size = Buf.size();
-        va_list args;
-        va_start(args, fmt);
-        Buf.appendfv(fmt, args);
-        va_end(args);
-        for (int new_size = Buf.size(); old_size < new_size; old_size++)
+        const char* end = text + size;
+        while (text < end)
         {
-            if (Buf[old_size] == '\n')
-            {
-                LineOffsets.push_back(old_size + 1);
-            }
+            const char* newline = static_cast<const char*>(std::memchr(text, '\n', end - text));
+            const char* lineEnd = newline != nullptr ? newline : end;
+            appendLine(text, lineEnd - text);
+            text = newline != nullptr ? newline + 1 : end;
         }
+        ++m_Revision;
     }
 
     void Draw(const char* title)
@@ -73,7 +94,12 @@ struct AppLog
         ImGui::SameLine();
         bool copy = ImGui::Button("Copy");
         ImGui::SameLine();
-        Filter.Draw("Filter", -100.0f);
+        if (Filter.Draw("Filter", -100.0f))
+        {
+            // Only a new filter invalidates the matches, new lines are picked up incrementally below
+            m_Matches.clear();
+            m_FilteredUpTo = m_FirstSerial;
+        }
 
         ImGui::Separator();
 
@@ -85,45 +111,31 @@ struct AppLog
                 ImGui::LogToClipboard();
 
             ImGui::PushStyleVar(ImGuiStyleVar_ItemSpacing, ImVec2(0, 0));
-            const char* buf     = Buf.begin();
-            const char* buf_end = Buf.end();
             if (Filter.IsActive())
             {
-                // In this example we don't use the clipper when Filter is enabled.
-                // This is because we don't have random access to the result of our filter.
-                // A real application processing logs with ten of thousands of entries may want to store the result of
-                // search/filter.. especially if the filtering function is not trivial (e.g. reg-exp).
-                for (int line_no = 0; line_no < LineOffsets.Size; line_no++)
+                updateMatches();
+
+                ImGuiListClipper clipper;
+                clipper.Begin(static_cast<int>(m_Matches.size()));
+                while (clipper.Step())
                 {
-                    const char* line_start = buf + LineOffsets[line_no];
-                    const char* line_end   = (line_no + 1 < LineOffsets.Size) ? (buf + LineOffsets[line_no + 1] - 1) : buf_end;
-                    if (Filter.PassFilter(line_start, line_end))
+                    for (int match_no = clipper.DisplayStart; match_no < clipper.DisplayEnd; match_no++)
+                    {
+                        auto [line_start, line_end] = lineText(m_Matches[match_no] - m_FirstSerial);
                         ImGui::TextUnformatted(line_start, line_end);
+                    }
                 }
+                clipper.End();
             }
             else
             {
-                // The simplest and easy way to display the entire buffer:
-                //   ImGui::TextUnformatted(buf_begin, buf_end);
-                // And it'll just work. TextUnformatted() has specialization for large blob of text and will fast-forward
-                // to skip non-visible lines. Here we instead demonstrate using the clipper to only process lines that are
-                // within the visible area.
-                // If you have tens of thousands of items and their processing cost is non-negligible, coarse clipping them
-                // on your side is recommended. Using ImGuiListClipper requires
-                // - A) random access into your data
-                // - B) items all being the  same height,
-                // both of which we can handle since we have an array pointing to the beginning of each line of text.
-                // When using the filter (in the block of code above) we don't have random access into the data to display
-                // anymore, which is why we don't use the clipper. Storing or skimming through the search result would make
-                // it possible (and would be recommended if you want to search through tens of thousands of entries).
                 ImGuiListClipper clipper;
-                clipper.Begin(LineOffsets.Size);
+                clipper.Begin(static_cast<int>(m_LineCount));
                 while (clipper.Step())
                 {
                     for (int line_no = clipper.DisplayStart; line_no < clipper.DisplayEnd; line_no++)
                     {
-                        const char* line_start = buf + LineOffsets[line_no];
-                        const char* line_end   = (line_no + 1 < LineOffsets.Size) ? (buf + LineOffsets[line_no + 1] - 1) : buf_end;
+                        auto [line_start, line_end] = lineText(line_no);
                         ImGui::TextUnformatted(line_start, line_end);
                     }
                 }
@@ -138,4 +150,93 @@ struct AppLog
         }
         ImGui::EndChild();
     }
+
+    // private:
+    struct Line
+    {
+        std::uint32_t offset;
+        std::uint32_t length;
+    };
+
+    std::unique_ptr<char[]> m_Text;
+    std::vector<Line>       m_Lines;         // Ring of kMaxLines, oldest at m_FirstLine
+    std::size_t             m_Head      = 0; // Where the next line is written in m_Text
+    std::size_t             m_FirstLine = 0;
+    std::size_t             m_LineCount = 0;
+
+    // Every line gets a serial number that never changes, so the filter results survive old lines being dropped
+    std::uint64_t             m_FirstSerial  = 0; // Serial of the oldest stored line
+    std::uint64_t             m_FilteredUpTo = 0; // Lines before this serial have been run through the filter
+    std::deque<std::uint64_t> m_Matches;          // Serials of stored lines that pass the filter, oldest first
+
+    // Lines are numbered oldest first
+    auto line(std::size_t index) const -> Line const&
+    {
+        return m_Lines[(m_FirstLine + index) % kMaxLines];
+    }
+
+    auto lineText(std::size_t index) const -> std::pair<const char*, const char*>
+    {
+        auto const& l = line(index);
+        return { m_Text.get() + l.offset, m_Text.get() + l.offset + l.length };
+    }
+
+    void dropOldest()
+    {
+        m_FirstLine = (m_FirstLine + 1) % kMaxLines;
+        --m_LineCount;
+        ++m_FirstSerial;
+    }
+
+    // Forgets matches that have been dropped and filters the lines that arrived since the last call
+    void updateMatches()
+    {
+        while (!m_Matches.empty() && m_Matches.front() < m_FirstSerial)
+        {
+            m_Matches.pop_front();
+        }
+
+        const std::uint64_t endSerial = m_FirstSerial + m_LineCount;
+        for (std::uint64_t serial = std::max(m_FilteredUpTo, m_FirstSerial); serial < endSerial; ++serial)
+        {
+            auto [line_start, line_end] = lineText(serial - m_FirstSerial);
+            if (Filter.PassFilter(line_start, line_end))
+            {
+                m_Matches.push_back(serial);
+            }
+        }
+        m_FilteredUpTo = endSerial;
+    }
+
+    void appendLine(const char* text, std::size_t length)
+    {
+        length = std::min(length, kCapacity);
+
+        if (m_Head + length > kCapacity)
+        {
+            // Anything still stored past the head is older than everything before it, drop it and wrap
+            while (m_LineCount > 0 && line(0).offset >= m_Head)
+            {
+                dropOldest();
+            }
+            m_Head = 0;
+        }
+
+        // The oldest lines sit just ahead of the head, drop the ones we're about to overwrite
+        while (m_LineCount > 0)
+        {
+            auto const& oldest  = line(0);
+            const bool  overlap = oldest.offset < m_Head + length && oldest.offset + oldest.length > m_Head;
+            if (!overlap && m_LineCount < kMaxLines)
+            {
+                break;
+            }
+            dropOldest();
+        }
+
+        std::memcpy(m_Text.get() + m_Head, text, length);
+        m_Lines[(m_FirstLine + m_LineCount) % kMaxLines] = { static_cast<std::uint32_t>(m_Head), static_cast<std::uint32_t>(length) };
+        ++m_LineCount;
+        m_Head += length;
+    }
 };
@@ -21,7 +21,8 @@ namespace spdlog
             {
                 memory_buf_t formatted;
                 applog_sink<Mutex>::formatter_->format(msg, formatted);
-                AppLog::get().Log("%s", fmt::to_string(formatted).c_str());
+                // Straight from spdlog's stack buffer into the log, no intermediate string
+                AppLog::get().Append(formatted.data(), formatted.size());
             }
             void flush_() override
             {
@@ -1,11 +1,15 @@
 #include "application.h"
+#include "config.h"
+#include "frame_arena.h"
+#include "frame_scheduler.h"
+#include "profiler.h"
 
 #include "simulation/circuit_runner.h"
 #include "simulation/commands/add_component_command.h"
 #include "simulation/commands/command.h"
 
 #include "ui/actions/action.h"
-#include "ui/actions/ui_close_requested_action.h"
+#include "ui/events/event.h"
 
 #include "ui/canvas_controller.h"
 #include "ui/canvas_view_model.h"
@@ -15,23 +19,46 @@
 
 #include <SDL.h>
 
+#include <exception>
 #include <memory>
+#include <memory_resource>
+#include <optional>
+#include <variant>
 #include <vector>
 
 Application::Application(std::string const& title, usize width, usize height)
 {
+    Profiler::setThreadName("UI");
+
     m_CircuitRunner    = std::make_unique<CircuitRunner>();
+    m_FrameScheduler   = std::make_unique<FrameScheduler>();
+    m_FrameArena       = std::make_unique<FrameArena>(Config::kFrameArenaSize);
     m_WindowRenderer   = std::make_unique<WindowRenderer>(title, Size{ static_cast<f64>(width), static_cast<f64>(height) });
     m_UIRenderer       = std::make_unique<UIRenderer>(&*m_WindowRenderer);
     m_UIInputHandler   = std::make_unique<UIInputHandler>();
     m_CanvasController = std::make_unique<CanvasController>();
 
     m_CanvasViewModel = CanvasViewModel::create(m_CircuitRunner->circuit());
+
+    m_CircuitRunner->setOnChanged([this]()
+    {
+        m_FrameScheduler->requestWake();
+    });
 }
 
 Application::~Application()
 {
     spdlog::info("Application::~Application()");
+
+    if (m_LoadThread.joinable())
+    {
+        m_LoadThread.join();
+    }
+
+    m_CircuitRunner->metrics().dump(Config::kMetricsPath);
+
+    // The runner's callback points at the scheduler, so make sure it's stopped first
+    m_CircuitRunner.reset();
 }
 
 bool Application::running() const
@@ -39,20 +66,23 @@ bool Application::running() const
     return !m_CloseRequested;
 }
 
-bool Application::nextFrame() const
+bool Application::nextFrame()
 {
-    // TODO: Frame delta, 60fps etc.
-    std::chrono::milliseconds frameTime(16);
-    std::this_thread::sleep_for(frameTime);
+    m_FrameScheduler->waitForNextFrame();
+    m_FrameScheduler->beginFrame();
+    m_FrameHadActivity = false;
     return true;
 }
 
 void Application::handleInput()
 {
+    PROFILE_SCOPE("Application::handleInput");
+
     // Events from SDL
     SDL_Event event;
     while (SDL_PollEvent(&event))
     {
+        m_FrameHadActivity = true;
         m_WindowRenderer->handleEvent(event);
         m_UIRenderer->handleEvent(event);
         switch (event.type)
@@ -75,38 +105,177 @@ void Application::tick()
 
 void Application::render()
 {
+    PROFILE_SCOPE("Application::render");
+
     m_UIRenderer->clear();
     m_WindowRenderer->clear();
 
+    // The canvas texture persists between frames, this only redraws the parts that changed
     m_WindowRenderer->setDrawToCanvas();
-    m_WindowRenderer->clear();
     m_CanvasViewModel->draw(&*m_WindowRenderer);
 
     m_WindowRenderer->setDrawToScreen();
-    auto actions = m_UIRenderer->draw();
-    m_WindowRenderer->draw();
 
-    for (auto& action : actions)
+    // Everything from here to the end of the frame lives in the frame arena
+    auto actions  = std::pmr::vector<Action>(&*m_FrameArena);
+    auto events   = std::pmr::vector<Event>(&*m_FrameArena);
+    auto commands = std::pmr::vector<Command*>(&*m_FrameArena);
+    actions.reserve(64);
+    events.reserve(64);
+    commands.reserve(64);
+
+    if (m_LoadThread.joinable() && m_LoadFinished)
+    {
+        m_LoadThread.join();
+        if (m_LoadSucceeded)
+        {
+            circuitReplaced();
+            spdlog::info("Opened circuit {}", Config::kCircuitJsonPath);
+        }
+    }
+
+    m_UIRenderer->setLoadProgress(m_LoadThread.joinable() ? std::optional<f32>(m_LoadProgress) : std::nullopt);
+    m_UIRenderer->setFrameArenaStats(m_FrameArena->lastFrameStats());
+    m_UIRenderer->setSimMetrics(m_CircuitRunner->metrics().snapshot());
+    {
+        PROFILE_SCOPE("Application::render/ui");
+        m_UIRenderer->draw(actions);
+        m_WindowRenderer->draw();
+    }
+
+    if (!actions.empty())
+    {
+        m_FrameHadActivity = true;
+    }
+
+    for (auto const& action : actions)
     {
-        if (auto closeAction = dynamic_cast<UICloseRequestedAction*>(&*action))
+        if (std::holds_alternative<UICloseRequestedAction>(action))
         {
             m_CloseRequested = true;
         }
+        else if (auto const* saveAction = std::get_if<UISaveCircuitAction>(&action))
+        {
+            const bool binary = saveAction->format == CircuitFormat::Binary;
+            const auto path   = binary ? Config::kCircuitPath : Config::kCircuitJsonPath;
+            if (binary ? m_CircuitRunner->saveCircuit(path) : m_CircuitRunner->saveCircuitJson(path))
+            {
+                spdlog::info("Saved circuit to {}", path);
+            }
+            else
+            {
+                spdlog::error("Could not save circuit to {}", path);
+            }
+        }
+        else if (auto const* loadAction = std::get_if<UILoadCircuitAction>(&action))
+        {
+            if (loadAction->format == CircuitFormat::Json)
+            {
+                if (!m_LoadThread.joinable())
+                {
+                    m_LoadProgress = 0.0f;
+                    m_LoadFinished = false;
+                    m_LoadThread   = std::thread([this]()
+                    {
+                        // Nothing may escape the thread, an uncaught exception there would end the program
+                        try
+                        {
+                            m_LoadSucceeded = m_CircuitRunner->loadCircuitJson(Config::kCircuitJsonPath, [this](f32 progress)
+                            {
+                                m_LoadProgress = progress;
+                                m_FrameScheduler->requestWake();
+                            });
+                        }
+                        catch (std::exception const& e)
+                        {
+                            spdlog::error("Could not load {}: {}", Config::kCircuitJsonPath, e.what());
+                            m_LoadSucceeded = false;
+                        }
+                        m_LoadFinished = true;
+                        m_FrameScheduler->requestWake();
+                    });
+                }
+            }
+            else if (m_CircuitRunner->loadCircuit(Config::kCircuitPath))
+            {
+                circuitReplaced();
+                spdlog::info("Opened circuit {}", Config::kCircuitPath);
+            }
+        }
+        else if (std::holds_alternative<UIDumpMetricsAction>(action))
+        {
+            if (m_CircuitRunner->metrics().dump(Config::kMetricsPath))
+            {
+                spdlog::info("Wrote simulation metrics to {}", Config::kMetricsPath);
+            }
+            else
+            {
+                spdlog::error("Could not write simulation metrics to {}", Config::kMetricsPath);
+            }
+        }
     }
 
-    auto commands = std::vector<std::unique_ptr<Command>>();
-    for (auto& event : m_UIInputHandler->handleInput(&*m_CanvasViewModel, std::move(actions)))
     {
-        for (auto& command : m_CanvasController->handleCanvasEvent(std::move(event)))
+        PROFILE_SCOPE("Application::render/input");
+        m_UIInputHandler->handleInput(&*m_CanvasViewModel, actions, events);
+
+        // The canvas can still be panned and zoomed while a load runs, but not edited, the
+        // edits would be lost when the loaded circuit replaces this one
+        if (!m_LoadThread.joinable())
         {
-            commands.push_back(std::move(command));
+            for (auto const& event : events)
+            {
+                m_CanvasController->handleCanvasEvent(event, *m_FrameArena, commands);
+            }
         }
     }
 
-    m_CircuitRunner->sendCommands(std::move(commands));
+    // Keep rendering at full rate while anything is changing
+    const u64      circuitRevision = m_CircuitRunner->circuit().revision;
+    const u64      circuitValues   = m_CircuitRunner->circuit().valueRevision;
+    const unsigned logRevision     = AppLog::get().m_Revision;
+    if (!commands.empty() || circuitRevision != m_CircuitRevision || circuitValues != m_CircuitValues || logRevision != m_LogRevision)
+    {
+        m_FrameHadActivity = true;
+        m_CircuitRevision  = circuitRevision;
+        m_CircuitValues    = circuitValues;
+        m_LogRevision      = logRevision;
+    }
+
+    {
+        // Copies the commands out of the arena
+        PROFILE_SCOPE("Application::render/sendCommands");
+        m_CircuitRunner->sendCommands(commands, m_CircuitGeneration);
+    }
+
+    {
+        // The simulation thread edits the circuit, so hold it off while the view model reads it
+        PROFILE_SCOPE("Application::render/viewModel");
+        auto lock = m_CircuitRunner->lock();
+        m_CanvasViewModel->update();
+    }
 
-    m_CanvasViewModel->update();
+    m_FrameScheduler->endWork();
 
-    m_UIRenderer->present();
-    m_WindowRenderer->present();
+    {
+        PROFILE_SCOPE("Application::render/present");
+        m_UIRenderer->present();
+        m_WindowRenderer->present();
+    }
+
+    m_FrameScheduler->endFrame(m_FrameHadActivity);
+
+    // The containers above still point into the arena, so clear them before it's reset
+    actions.clear();
+    events.clear();
+    commands.clear();
+    m_FrameArena->reset();
+}
+
+void Application::circuitReplaced()
+{
+    // The old selection's ids, and any drag's, mean nothing in the new circuit
+    m_CanvasViewModel->setSelection({});
+    m_CanvasController->reset();
+    m_CircuitGeneration = m_CircuitRunner->generation();
 }
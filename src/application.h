@@ -5,8 +5,11 @@
 #include <atomic>
 #include <memory>
 #include <string>
+#include <thread>
 
 class CircuitRunner;
+class FrameArena;
+class FrameScheduler;
 class WindowRenderer;
 class UIRenderer;
 class UIInputHandler;
@@ -20,20 +23,41 @@ public:
     ~Application();
 
     bool running() const;
-    bool nextFrame() const;
+    bool nextFrame();
 
     void handleInput();
     void tick();
     void render();
 
 protected:
+    // Called once a load has replaced the circuit
+    void circuitReplaced();
+
     std::atomic_bool m_CloseRequested = false;
 
+    std::unique_ptr<FrameScheduler> m_FrameScheduler;
+
+    // Backs everything that only lives for one frame, reset at the end of render()
+    std::unique_ptr<FrameArena> m_FrameArena;
+
+    // Whether anything happened this frame that might need another one straight after
+    bool     m_FrameHadActivity = false;
+    u64      m_CircuitRevision  = 0;
+    u64      m_CircuitValues    = 0; // The circuit's valueRevision
+    unsigned m_LogRevision      = 0;
+
     std::unique_ptr<CircuitRunner> m_CircuitRunner;
+    u64                            m_CircuitGeneration = 0; // The runner's generation the UI's ids belong to
 
     std::unique_ptr<WindowRenderer>   m_WindowRenderer;
     std::unique_ptr<UIRenderer>       m_UIRenderer;
     std::unique_ptr<UIInputHandler>   m_UIInputHandler;
     std::unique_ptr<CanvasController> m_CanvasController;
     std::unique_ptr<CanvasViewModel>  m_CanvasViewModel;
+
+    // JSON circuits load on a thread of their own so big ones don't stall the UI
+    std::thread      m_LoadThread;
+    std::atomic<f32> m_LoadProgress  = 0.0f;
+    std::atomic_bool m_LoadFinished  = false;
+    std::atomic_bool m_LoadSucceeded = false;
 };
@@ -7,4 +7,56 @@ namespace Config
     constexpr auto kScreenHeight = 1080.0f;
     constexpr auto kCanvasWidth  = 1280.0f;
     constexpr auto kCanvasHeight = 720.0f;
+
+    // Frame pacing. After kIdleAfterFrames frames without any input or state change we only
+    // render again on input, a wake request, or every kIdleWakeIntervalMs.
+    constexpr auto kTargetFrameRate    = 60.0;
+    constexpr auto kIdleAfterFrames    = 8u;
+    constexpr auto kIdleWakeIntervalMs = 250;
+
+    // Size of the bump allocator for per-frame actions, events and commands
+    constexpr auto kFrameArenaSize = 1u << 20;
+
+    // Hot-path diagnostics (hover, canvas events, the sim loop) log at most once per interval per call site
+    constexpr auto kLogIntervalMs = 250;
+
+    // Scope profiler: samples kept per thread between collections, and timings per scope in the rolling stats
+    constexpr auto kProfilerRingSize = 1u << 14;
+    constexpr auto kProfilerWindow   = 240u;
+
+    // Scopes kept per thread in one trace capture, and where the capture is written
+    constexpr auto kTraceCapacity = 1u << 20;
+    constexpr auto kTracePath     = "trace.json";
+
+    // Where Save and Open read and write the circuit
+    constexpr auto kCircuitPath     = "circuit.nandy";
+    constexpr auto kCircuitJsonPath = "circuit.json";
+
+    // Built library prefabs are cached here between runs, one file per definition
+    constexpr auto kPrefabCacheDir = "prefab_cache";
+
+    // Where the simulation metrics are written on request and at exit
+    constexpr auto kMetricsPath = "sim_metrics.json";
+
+    // Memory cap for the undo/redo history, the oldest steps are dropped past this
+    constexpr auto kHistoryCapacity = 64u << 20;
+
+    // World-space offset of a duplicated selection from the original
+    constexpr auto kDuplicateOffset = 40.0;
+
+    // Canvas zoom limits and per-notch zoom factor
+    constexpr auto kMinZoom  = 0.001f;
+    constexpr auto kMaxZoom  = 10.0f;
+    constexpr auto kZoomStep = 1.1f;
+
+    // Level-of-detail thresholds, in on-screen pixels of a component's width
+    constexpr auto kLodFullDetailMinSize = 24.0f; // Full gate glyphs at or above this
+    constexpr auto kLodBoxMinSize        = 3.0f;  // Plain boxes at or above this, density tiles below
+    constexpr auto kLodDensityTileSize   = 12.0f; // Minimum on-screen size of a density tile
+
+    // World-space cell size of the canvas spatial index
+    constexpr auto kSpatialCellSize = 256.0f;
+
+    // Screen-space size of the tiles the canvas is redrawn in when parts of it change
+    constexpr auto kCanvasTileSize = 64.0f;
 }; // namespace Config
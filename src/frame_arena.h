@@ -0,0 +1,164 @@
+#pragma once
+
+#include "types.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// A bump allocator for things that only live for a single frame: the action, event and command
+// queues and the objects in them. Allocating is a pointer bump, deallocating does nothing, and
+// reset() at the end of the frame throws everything away at once.
+// It's a std::pmr::memory_resource, so std::pmr containers can allocate from it directly.
+//
+// Anything that has to outlive the frame must be copied out before reset().
+class FrameArena final : public std::pmr::memory_resource
+{
+public:
+    struct Stats final
+    {
+        usize allocations     = 0; // Served from the arena
+        usize bytes           = 0; // Arena bytes in use, including alignment padding
+        usize heapAllocations = 0; // Didn't fit in the arena and fell back to the heap
+    };
+
+    explicit FrameArena(usize capacity);
+    ~FrameArena() override;
+
+    FrameArena(FrameArena const&)            = delete;
+    FrameArena& operator=(FrameArena const&) = delete;
+
+    // Constructs a T that lives until the next reset()
+    template <typename T, typename... Args>
+    auto make(Args&&... args) -> T*;
+
+    // Destroys everything made with make(), and rewinds the arena to empty
+    void reset();
+
+    auto stats() const -> Stats const&;
+    auto lastFrameStats() const -> Stats const&;
+
+private:
+    void* do_allocate(std::size_t bytes, std::size_t alignment) override;
+    void  do_deallocate(void* p, std::size_t bytes, std::size_t alignment) override;
+    bool  do_is_equal(std::pmr::memory_resource const& other) const noexcept override;
+
+    // Intrusive list of objects that need their destructor run on reset(), itself allocated in the arena
+    struct Destructor final
+    {
+        void (*destroy)(void*);
+        void*       object;
+        Destructor* next;
+    };
+
+    std::unique_ptr<std::byte[]> m_Buffer;
+    usize                        m_Capacity;
+    usize                        m_Offset      = 0;
+    Destructor*                  m_Destructors = nullptr;
+
+    std::vector<std::pair<void*, std::size_t>> m_Overflow;
+
+    Stats m_Stats;
+    Stats m_LastFrameStats;
+};
+
+inline FrameArena::FrameArena(usize capacity)
+: m_Buffer(std::make_unique<std::byte[]>(capacity))
+, m_Capacity(capacity)
+{
+    m_Overflow.reserve(64);
+}
+
+inline FrameArena::~FrameArena()
+{
+    reset();
+}
+
+template <typename T, typename... Args>
+inline auto FrameArena::make(Args&&... args) -> T*
+{
+    auto* object = new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+
+    if constexpr (!std::is_trivially_destructible_v<T>)
+    {
+        auto* destructor = new (allocate(sizeof(Destructor), alignof(Destructor))) Destructor{
+            [](void* p)
+            {
+                static_cast<T*>(p)->~T();
+            },
+            object,
+            m_Destructors,
+        };
+        m_Destructors = destructor;
+    }
+
+    return object;
+}
+
+inline void FrameArena::reset()
+{
+    // Newest first, like the stack
+    for (auto* destructor = m_Destructors; destructor != nullptr; destructor = destructor->next)
+    {
+        destructor->destroy(destructor->object);
+    }
+    m_Destructors = nullptr;
+
+    for (auto const& [p, alignment] : m_Overflow)
+    {
+        ::operator delete(p, std::align_val_t(alignment));
+    }
+    m_Overflow.clear();
+
+    m_Offset         = 0;
+    m_LastFrameStats = m_Stats;
+    m_Stats          = {};
+}
+
+inline auto FrameArena::stats() const -> Stats const&
+{
+    return m_Stats;
+}
+
+inline auto FrameArena::lastFrameStats() const -> Stats const&
+{
+    return m_LastFrameStats;
+}
+
+inline void* FrameArena::do_allocate(std::size_t bytes, std::size_t alignment)
+{
+    const auto  address = reinterpret_cast<std::uintptr_t>(m_Buffer.get() + m_Offset);
+    const usize aligned = m_Offset + (alignment - address % alignment) % alignment;
+    if (aligned + bytes <= m_Capacity)
+    {
+        m_Offset = aligned + bytes;
+
+        ++m_Stats.allocations;
+        m_Stats.bytes = m_Offset;
+
+        return m_Buffer.get() + aligned;
+    }
+
+    // Out of space, this frame is unusually busy. Keep going from the heap and tidy up on reset().
+    void* p = ::operator new(bytes, std::align_val_t(alignment));
+    m_Overflow.emplace_back(p, alignment);
+
+    ++m_Stats.heapAllocations;
+
+    return p;
+}
+
+inline void FrameArena::do_deallocate(void*, std::size_t, std::size_t)
+{
+    // Everything is released at once in reset()
+}
+
+inline bool FrameArena::do_is_equal(std::pmr::memory_resource const& other) const noexcept
+{
+    return this == &other;
+}
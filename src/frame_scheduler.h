@@ -0,0 +1,121 @@
+#pragma once
+
+#include "config.h"
+#include "types.h"
+
+#include <SDL.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+// Decides when the next frame should start.
+//
+// While things are happening, frames are paced against a deadline one frame period after the
+// previous present. We sleep until just before that deadline, minus how long a frame usually
+// takes to build, so input is sampled as late as possible and the present lands on time. This
+// works the same with or without vsync: with vsync the present itself snaps to the blank.
+//
+// Once a few frames go by with nothing changing, we drop into idle mode and block on the SDL
+// event queue until there is input, a wake request from another thread, or a slow timeout.
+class FrameScheduler final
+{
+public:
+    FrameScheduler();
+
+    // Blocks until it's time to start the next frame
+    void waitForNextFrame();
+
+    void beginFrame();
+    void endWork();                  // Call just before presenting, the present isn't counted as work
+    void endFrame(bool hadActivity); // Call after presenting
+
+    // Thread-safe. Makes an idle wait return early, e.g. when the simulation has changed.
+    void requestWake();
+
+    auto idle() const -> bool;
+    auto averageWorkTime() const -> std::chrono::duration<f64, std::milli>;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr auto kFramePeriod = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<f64>(1.0 / Config::kTargetFrameRate));
+    static constexpr auto kMargin      = std::chrono::duration_cast<Clock::duration>(std::chrono::microseconds(1500));
+
+    Clock::time_point m_FrameStart;
+    Clock::time_point m_LastPresent;
+    Clock::duration   m_AverageWork = Clock::duration::zero();
+
+    u32               m_QuietFrames = 0;
+    std::atomic<bool> m_Idle        = false;
+    std::atomic<bool> m_WakePending = false;
+    u32               m_WakeEventType;
+};
+
+inline FrameScheduler::FrameScheduler()
+: m_FrameStart(Clock::now())
+, m_LastPresent(Clock::now())
+, m_WakeEventType(SDL_RegisterEvents(1))
+{
+}
+
+inline void FrameScheduler::waitForNextFrame()
+{
+    if (m_Idle)
+    {
+        // Leaves the event in the queue for handleInput() to pick up
+        SDL_WaitEventTimeout(nullptr, Config::kIdleWakeIntervalMs);
+        m_WakePending = false;
+        return;
+    }
+
+    const auto wakeAt = m_LastPresent + kFramePeriod - m_AverageWork - kMargin;
+    if (wakeAt > Clock::now())
+    {
+        std::this_thread::sleep_until(wakeAt);
+    }
+}
+
+inline void FrameScheduler::beginFrame()
+{
+    m_FrameStart = Clock::now();
+}
+
+inline void FrameScheduler::endWork()
+{
+    // Exponential moving average, weighted towards spikes so one slow frame doesn't make us late twice
+    const auto work = Clock::now() - m_FrameStart;
+    m_AverageWork   = work > m_AverageWork ? (m_AverageWork + work) / 2 : (m_AverageWork * 7 + work) / 8;
+    m_AverageWork   = std::min<Clock::duration>(m_AverageWork, kFramePeriod);
+}
+
+inline void FrameScheduler::endFrame(bool hadActivity)
+{
+    m_LastPresent = Clock::now();
+
+    m_QuietFrames = hadActivity ? 0 : m_QuietFrames + 1;
+    m_Idle        = m_QuietFrames >= Config::kIdleAfterFrames;
+}
+
+inline void FrameScheduler::requestWake()
+{
+    if (!m_Idle || m_WakePending.exchange(true))
+    {
+        return;
+    }
+
+    SDL_Event event{};
+    event.type = m_WakeEventType;
+    SDL_PushEvent(&event);
+}
+
+inline auto FrameScheduler::idle() const -> bool
+{
+    return m_Idle;
+}
+
+inline auto FrameScheduler::averageWorkTime() const -> std::chrono::duration<f64, std::milli>
+{
+    return m_AverageWork;
+}
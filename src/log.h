@@ -0,0 +1,115 @@
+#pragma once
+
+#include "types.h"
+
+#include <spdlog/spdlog.h>
+
+#include <atomic>
+#include <chrono>
+
+// Thin macros over spdlog for code that runs every frame or every step.
+//
+// - Calls below LOG_ACTIVE_LEVEL are compiled out, arguments and all. Release builds keep info and up.
+// - Arguments are only evaluated once the runtime level and the rate limit say the line will be written,
+//   so an expensive toString() in a disabled call costs a branch.
+// - The _EVERY variants write at most one line per interval from each call site, and say how many
+//   were skipped since the last one.
+
+#define LOG_LEVEL_TRACE 0
+#define LOG_LEVEL_DEBUG 1
+#define LOG_LEVEL_INFO  2
+#define LOG_LEVEL_WARN  3
+#define LOG_LEVEL_ERROR 4
+
+#ifndef LOG_ACTIVE_LEVEL
+#ifdef NDEBUG
+#define LOG_ACTIVE_LEVEL LOG_LEVEL_INFO
+#else
+#define LOG_ACTIVE_LEVEL LOG_LEVEL_TRACE
+#endif
+#endif
+
+namespace Log
+{
+    // One per call site. Lets a line through at most once per interval, from any thread.
+    class RateLimit final
+    {
+    public:
+        explicit RateLimit(std::chrono::milliseconds interval);
+
+        // Returns true if this call may log. skipped is set to how many calls were held back before it.
+        auto allow(u32& skipped) -> bool;
+
+    private:
+        using Clock = std::chrono::steady_clock;
+
+        const Clock::duration   m_Interval;
+        std::atomic<Clock::rep> m_NextAllowed = 0;
+        std::atomic<u32>        m_Skipped     = 0;
+    };
+
+    inline RateLimit::RateLimit(std::chrono::milliseconds interval)
+    : m_Interval(std::chrono::duration_cast<Clock::duration>(interval))
+    {
+    }
+
+    inline auto RateLimit::allow(u32& skipped) -> bool
+    {
+        const auto now  = Clock::now().time_since_epoch().count();
+        auto       next = m_NextAllowed.load(std::memory_order_relaxed);
+        if (now < next || !m_NextAllowed.compare_exchange_strong(next, now + m_Interval.count(), std::memory_order_relaxed))
+        {
+            m_Skipped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        skipped = m_Skipped.exchange(0, std::memory_order_relaxed);
+        return true;
+    }
+
+    constexpr auto toSpdlog(int level) -> spdlog::level::level_enum
+    {
+        return static_cast<spdlog::level::level_enum>(level);
+    }
+} // namespace Log
+
+#define LOG_AT(level, ...)                                      \
+    do                                                          \
+    {                                                           \
+        if constexpr ((level) >= LOG_ACTIVE_LEVEL)              \
+        {                                                       \
+            if (spdlog::should_log(Log::toSpdlog(level)))       \
+            {                                                   \
+                spdlog::log(Log::toSpdlog(level), __VA_ARGS__); \
+            }                                                   \
+        }                                                       \
+    } while (0)
+
+// interval is anything std::chrono::milliseconds can be made from
+#define LOG_AT_EVERY(level, interval, ...)                                                          \
+    do                                                                                              \
+    {                                                                                               \
+        if constexpr ((level) >= LOG_ACTIVE_LEVEL)                                                  \
+        {                                                                                           \
+            static Log::RateLimit logRateLimit_(std::chrono::milliseconds(interval));               \
+            u32                   logSkipped_ = 0;                                                  \
+            if (spdlog::should_log(Log::toSpdlog(level)) && logRateLimit_.allow(logSkipped_))       \
+            {                                                                                       \
+                spdlog::log(Log::toSpdlog(level), __VA_ARGS__);                                     \
+                if (logSkipped_ > 0)                                                                \
+                {                                                                                   \
+                    spdlog::log(Log::toSpdlog(level), "  ({} similar lines skipped)", logSkipped_); \
+                }                                                                                   \
+            }                                                                                       \
+        }                                                                                           \
+    } while (0)
+
+#define LOG_TRACE(...) LOG_AT(LOG_LEVEL_TRACE, __VA_ARGS__)
+#define LOG_DEBUG(...) LOG_AT(LOG_LEVEL_DEBUG, __VA_ARGS__)
+#define LOG_INFO(...)  LOG_AT(LOG_LEVEL_INFO, __VA_ARGS__)
+#define LOG_WARN(...)  LOG_AT(LOG_LEVEL_WARN, __VA_ARGS__)
+#define LOG_ERROR(...) LOG_AT(LOG_LEVEL_ERROR, __VA_ARGS__)
+
+#define LOG_TRACE_EVERY(interval, ...) LOG_AT_EVERY(LOG_LEVEL_TRACE, interval, __VA_ARGS__)
+#define LOG_DEBUG_EVERY(interval, ...) LOG_AT_EVERY(LOG_LEVEL_DEBUG, interval, __VA_ARGS__)
+#define LOG_INFO_EVERY(interval, ...)  LOG_AT_EVERY(LOG_LEVEL_INFO, interval, __VA_ARGS__)
@@ -1,5 +1,6 @@
 #include "application.h"
 #include "config.h"
+#include "profiler.h"
 #include "types.h"
 
 #include "applog_sink.h"
@@ -34,6 +35,8 @@ int main(int argc, char** argv)
     {
         if (application.nextFrame())
         {
+            PROFILE_SCOPE("Frame");
+
             application.handleInput();
             application.tick();
             application.render();
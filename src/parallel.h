@@ -0,0 +1,133 @@
+#pragma once
+
+#include "types.h"
+
+#include <algorithm>
+#include <atomic>
+#include <numeric>
+#include <span>
+#include <thread>
+#include <vector>
+
+// Fork-join helpers for the big linear passes over a circuit, like building its netlist or checking a
+// loaded file.
+//
+// Work is split into one contiguous chunk per thread. The chunks depend only on the count, minChunk and
+// workerCount(), never on timing, so anything written per chunk comes out the same on every run. Counts
+// below minChunk run inline on the calling thread without starting any threads.
+namespace Parallel
+{
+    // Threads work is split across, the calling one included
+    auto workerCount() -> u32;
+
+    // 0 goes back to one per core
+    void setWorkerCount(u32 count);
+
+    // How many chunks forChunks() will split count into
+    auto chunkCount(usize count, usize minChunk) -> usize;
+
+    // Calls fn(chunk, begin, end) for each chunk of [0, count), and returns once they're all done
+    template <typename F>
+    void forChunks(usize count, usize minChunk, F&& fn);
+
+    // Whether pred(i) holds for every i in [0, count)
+    template <typename Pred>
+    auto allOf(usize count, usize minChunk, Pred&& pred) -> bool;
+
+    // In place, over chunks of at least minChunk
+    void inclusiveScan(std::span<u32> values, usize minChunk);
+
+    namespace detail
+    {
+        inline std::atomic<u32> s_WorkerCount = 0;
+    } // namespace detail
+
+    inline auto workerCount() -> u32
+    {
+        const u32 count = detail::s_WorkerCount.load(std::memory_order_relaxed);
+        return count > 0 ? count : std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    inline void setWorkerCount(u32 count)
+    {
+        detail::s_WorkerCount.store(count, std::memory_order_relaxed);
+    }
+
+    inline auto chunkCount(usize count, usize minChunk) -> usize
+    {
+        return std::clamp<usize>(count / std::max<usize>(minChunk, 1), 1, workerCount());
+    }
+
+    template <typename F>
+    inline void forChunks(usize count, usize minChunk, F&& fn)
+    {
+        const usize chunks = chunkCount(count, minChunk);
+        auto        bounds = [&](usize chunk)
+        {
+            return count * chunk / chunks;
+        };
+
+        std::vector<std::thread> threads;
+        threads.reserve(chunks - 1);
+        for (usize chunk = 1; chunk < chunks; ++chunk)
+        {
+            threads.emplace_back([&, chunk]()
+            {
+                fn(chunk, bounds(chunk), bounds(chunk + 1));
+            });
+        }
+
+        fn(usize{ 0 }, usize{ 0 }, bounds(1));
+
+        for (auto& thread : threads)
+        {
+            thread.join();
+        }
+    }
+
+    template <typename Pred>
+    inline auto allOf(usize count, usize minChunk, Pred&& pred) -> bool
+    {
+        std::atomic<bool> result = true;
+        forChunks(count, minChunk, [&](usize, usize begin, usize end)
+        {
+            for (usize i = begin; i < end; ++i)
+            {
+                if (!pred(i))
+                {
+                    result.store(false, std::memory_order_relaxed);
+                    return;
+                }
+            }
+        });
+        return result.load(std::memory_order_relaxed);
+    }
+
+    inline void inclusiveScan(std::span<u32> values, usize minChunk)
+    {
+        const usize chunks = chunkCount(values.size(), minChunk);
+        if (chunks == 1)
+        {
+            std::inclusive_scan(values.begin(), values.end(), values.begin());
+            return;
+        }
+
+        // Scan each chunk, then add everything before it
+        std::vector<u32> totals(chunks + 1, 0);
+        forChunks(values.size(), minChunk, [&](usize chunk, usize begin, usize end)
+        {
+            std::inclusive_scan(values.begin() + begin, values.begin() + end, values.begin() + begin);
+            totals[chunk + 1] = values[end - 1];
+        });
+
+        std::inclusive_scan(totals.begin(), totals.end(), totals.begin());
+
+        forChunks(values.size(), minChunk, [&](usize chunk, usize begin, usize end)
+        {
+            for (usize i = begin; i < end; ++i)
+            {
+                values[i] += totals[chunk];
+            }
+        });
+    }
+} // namespace Parallel
@@ -0,0 +1,604 @@
+#pragma once
+
+#include "config.h"
+#include "types.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Scope timers for the UI and simulation threads.
+//
+// Each thread writes finished scopes into its own ring buffer, so timing a scope never takes a
+// lock or allocates. Once a frame the UI thread calls collect(), which copies whatever is new out
+// of every ring into per-scope rolling windows, and keeps the last complete top-level scope of
+// each thread for a flame-style breakdown. Every ring slot carries a sequence number, so a sample
+// that's overwritten while collect() copies it is skipped rather than read torn. A ring that's been
+// lapped since the last collect() only gives up the samples still in it.
+//
+// A thread's buffers are freed once it has exited and everything in them has been read.
+//
+// Separately, a trace capture appends every scope to a second, much larger per-thread buffer that's
+// reserved up front and only touched while capturing. Stopping the capture writes it out as Chrome
+// trace-event JSON from a background thread, for chrome://tracing or Perfetto.
+//
+// With neither the stats nor a trace on, a ProfileScope is a relaxed load and a branch.
+class Profiler final
+{
+public:
+    struct Sample final
+    {
+        const char* name;  // Must outlive the profiler, in practice a string literal
+        u64         start; // Nanoseconds
+        u64         end;
+        u32         depth; // Nesting level on its thread, 0 for top-level scopes
+    };
+
+    struct Stats final
+    {
+        const char* name;
+        u32         depth;
+        f64         minMs;
+        f64         meanMs;
+        f64         p99Ms;
+    };
+
+    // One per thread that has timed anything. Written only by its thread, read by collect().
+    class ThreadBuffer final
+    {
+    public:
+        explicit ThreadBuffer(std::string name);
+
+        void push(Sample const& sample);
+
+        // Copies out sample index, returning false if its slot has since been reused or is being written
+        auto read(u64 index, Sample& sample) const -> bool;
+
+        std::string m_Name;
+        u32         m_Depth = 0;
+
+        // private:
+        // A ring entry. sequence is odd while it's being written, and 2 * (index + 1) once sample
+        // index is in it, so a reader can tell it got the whole sample and the one it asked for.
+        struct Slot final
+        {
+            std::atomic<u64>         sequence = 0;
+            std::atomic<const char*> name     = nullptr;
+            std::atomic<u64>         start    = 0;
+            std::atomic<u64>         end      = 0;
+            std::atomic<u32>         depth    = 0;
+        };
+
+        std::unique_ptr<Slot[]> m_Samples;
+        std::atomic<u64>        m_Head   = 0;     // Samples ever written
+        std::atomic<bool>       m_Exited = false; // Its thread has finished, nothing more will be written
+
+        std::unique_ptr<Sample[]> m_Trace;          // Config::kTraceCapacity, left untouched until a capture
+        std::atomic<u64>          m_TraceCount = 0; // Samples in this capture, the rest are dropped
+    };
+
+    ~Profiler();
+
+    static auto get() -> Profiler&;
+
+    // Rolling stats for the Right pane
+    static auto enabled() -> bool;
+    static void setEnabled(bool enabled);
+
+    // Trace capture. startTrace() returns false while the previous capture is still being written.
+    static auto tracing() -> bool;
+    auto startTrace() -> bool;
+    void stopTrace(std::string path);
+    auto writingTrace() const -> bool;
+
+    // The calling thread's ring, created on first use and released when the thread exits
+    static auto threadBuffer() -> ThreadBuffer&;
+    static void setThreadName(std::string name);
+
+    static auto now() -> u64;
+
+    // UI thread only. Pulls new samples from every thread.
+    void collect();
+
+    struct ThreadView final
+    {
+        std::string         name;
+        std::vector<Stats>  stats;     // In order of first appearance
+        std::vector<Sample> lastFrame; // The latest top-level scope and everything inside it, by start time
+    };
+
+    // UI thread only. The state as of the last collect().
+    auto threads() const -> std::vector<ThreadView> const&;
+
+private:
+    friend class ProfileScope;
+
+    Profiler() = default;
+
+    // Rolling window of durations for one scope name on one thread
+    struct Series final
+    {
+        const char*                              name;
+        u32                                      depth;
+        std::array<f32, Config::kProfilerWindow> durationsMs{};
+        u32                                      count = 0;
+        u32                                      next  = 0;
+
+        void add(f32 durationMs);
+        auto stats() const -> Stats;
+    };
+
+    struct Reader final
+    {
+        std::shared_ptr<ThreadBuffer> buffer;
+        u64                           read = 0;
+        std::vector<Series>           series;
+        std::vector<Sample>           scratch;
+        std::vector<Sample>           open; // Nested samples whose top-level scope hasn't finished yet
+    };
+
+    // Holds a thread's buffer for as long as the thread runs
+    struct BufferOwner final
+    {
+        ~BufferOwner();
+
+        std::shared_ptr<ThreadBuffer> buffer;
+    };
+
+    void writeTrace(std::string const& path, u64 captureStart);
+
+    // Drops the buffers of threads that have exited, once no capture needs them. Takes m_Mutex held.
+    void releaseExited();
+
+    static constexpr u8 kStatsFlag = 1;
+    static constexpr u8 kTraceFlag = 2;
+
+    static inline std::atomic<u8> s_Flags = 0;
+
+    std::mutex                                 m_Mutex; // Guards m_Buffers
+    std::vector<std::shared_ptr<ThreadBuffer>> m_Buffers; // Readers and trace writes hold their own references
+
+    u64               m_TraceStart = 0;
+    std::thread       m_TraceWriter;
+    std::atomic<bool> m_WritingTrace = false;
+
+    std::vector<Reader>     m_Readers;
+    std::vector<ThreadView> m_Threads;
+};
+
+// Times the enclosing scope
+class ProfileScope final
+{
+public:
+    explicit ProfileScope(const char* name);
+    ~ProfileScope();
+
+    ProfileScope(ProfileScope const&)            = delete;
+    ProfileScope& operator=(ProfileScope const&) = delete;
+
+private:
+    Profiler::ThreadBuffer* m_Buffer = nullptr;
+    const char*             m_Name;
+    u64                     m_Start = 0;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b)       PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_SCOPE(name)        ProfileScope PROFILE_CONCAT(profileScope_, __LINE__)(name)
+
+inline Profiler::ThreadBuffer::ThreadBuffer(std::string name)
+: m_Name(std::move(name))
+, m_Samples(std::make_unique<Slot[]>(Config::kProfilerRingSize))
+, m_Trace(new Sample[Config::kTraceCapacity]) // Default-initialised, so the pages aren't touched until used
+{
+}
+
+inline void Profiler::ThreadBuffer::push(Sample const& sample)
+{
+    const u64 head = m_Head.load(std::memory_order_relaxed);
+
+    // A seqlock: mark the slot as being written before touching it, and as holding sample head after
+    auto& slot = m_Samples[head % Config::kProfilerRingSize];
+    slot.sequence.store(2 * head + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.name.store(sample.name, std::memory_order_relaxed);
+    slot.start.store(sample.start, std::memory_order_relaxed);
+    slot.end.store(sample.end, std::memory_order_relaxed);
+    slot.depth.store(sample.depth, std::memory_order_relaxed);
+    slot.sequence.store(2 * head + 2, std::memory_order_release);
+
+    m_Head.store(head + 1, std::memory_order_release);
+
+    if (Profiler::tracing())
+    {
+        const u64 count = m_TraceCount.load(std::memory_order_relaxed);
+        if (count < Config::kTraceCapacity)
+        {
+            m_Trace[count] = sample;
+            m_TraceCount.store(count + 1, std::memory_order_release);
+        }
+    }
+}
+
+inline auto Profiler::ThreadBuffer::read(u64 index, Sample& sample) const -> bool
+{
+    auto const& slot     = m_Samples[index % Config::kProfilerRingSize];
+    const u64   sequence = 2 * index + 2;
+    if (slot.sequence.load(std::memory_order_acquire) != sequence)
+    {
+        return false;
+    }
+
+    sample = {
+        slot.name.load(std::memory_order_relaxed),
+        slot.start.load(std::memory_order_relaxed),
+        slot.end.load(std::memory_order_relaxed),
+        slot.depth.load(std::memory_order_relaxed),
+    };
+
+    // Unchanged since the first check, so nothing was written over it while it was copied
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return slot.sequence.load(std::memory_order_relaxed) == sequence;
+}
+
+inline Profiler::BufferOwner::~BufferOwner()
+{
+    if (!buffer)
+    {
+        return;
+    }
+
+    auto& profiler = get();
+
+    std::lock_guard<std::mutex> lock(profiler.m_Mutex);
+    buffer->m_Exited.store(true, std::memory_order_release);
+    profiler.releaseExited();
+}
+
+inline Profiler::~Profiler()
+{
+    if (m_TraceWriter.joinable())
+    {
+        m_TraceWriter.join();
+    }
+}
+
+inline auto Profiler::get() -> Profiler&
+{
+    static Profiler profiler;
+    return profiler;
+}
+
+inline auto Profiler::enabled() -> bool
+{
+    return (s_Flags.load(std::memory_order_relaxed) & kStatsFlag) != 0;
+}
+
+inline void Profiler::setEnabled(bool enabled)
+{
+    enabled ? s_Flags.fetch_or(kStatsFlag, std::memory_order_relaxed) : s_Flags.fetch_and(static_cast<u8>(~kStatsFlag), std::memory_order_relaxed);
+}
+
+inline auto Profiler::tracing() -> bool
+{
+    return (s_Flags.load(std::memory_order_relaxed) & kTraceFlag) != 0;
+}
+
+inline auto Profiler::startTrace() -> bool
+{
+    if (tracing() || m_WritingTrace)
+    {
+        return false;
+    }
+
+    if (m_TraceWriter.joinable())
+    {
+        m_TraceWriter.join();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        releaseExited();
+        for (auto& buffer : m_Buffers)
+        {
+            buffer->m_TraceCount.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    m_TraceStart = now();
+    s_Flags.fetch_or(kTraceFlag, std::memory_order_release);
+    return true;
+}
+
+inline void Profiler::stopTrace(std::string path)
+{
+    if (!tracing())
+    {
+        return;
+    }
+
+    s_Flags.fetch_and(static_cast<u8>(~kTraceFlag), std::memory_order_release);
+
+    m_WritingTrace = true;
+    m_TraceWriter  = std::thread([this, path = std::move(path), captureStart = m_TraceStart]()
+    {
+        writeTrace(path, captureStart);
+
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_WritingTrace = false;
+        releaseExited();
+    });
+}
+
+inline auto Profiler::writingTrace() const -> bool
+{
+    return m_WritingTrace;
+}
+
+inline void Profiler::writeTrace(std::string const& path, u64 captureStart)
+{
+    struct Capture
+    {
+        std::string                   name;
+        std::shared_ptr<ThreadBuffer> buffer;
+        u64                           count;
+    };
+
+    std::vector<Capture> captures;
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        for (auto& buffer : m_Buffers)
+        {
+            captures.push_back({ buffer->m_Name, buffer, buffer->m_TraceCount.load(std::memory_order_acquire) });
+        }
+    }
+
+    // Complete ("X") events in microseconds from the start of the capture, one tid per thread.
+    // Scope and thread names are plain identifiers, so they go in without escaping.
+    std::ofstream file(path);
+    auto          out   = std::ostreambuf_iterator<char>(file);
+    bool          first = true;
+
+    fmt::format_to(out, "{{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    for (usize tid = 0; tid < captures.size(); ++tid)
+    {
+        auto const& capture = captures[tid];
+        fmt::format_to(out, "{}{{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":{},\"args\":{{\"name\":\"{}\"}}}}", first ? "" : ",\n", tid, capture.name);
+        first = false;
+
+        for (u64 i = 0; i < capture.count; ++i)
+        {
+            auto const& sample = capture.buffer->m_Trace[i];
+            if (sample.start < captureStart)
+            {
+                continue;
+            }
+
+            fmt::format_to(out, ",\n{{\"name\":\"{}\",\"ph\":\"X\",\"pid\":1,\"tid\":{},\"ts\":{:.3f},\"dur\":{:.3f}}}", sample.name, tid, (sample.start - captureStart) / 1e3, (sample.end - sample.start) / 1e3);
+        }
+    }
+    fmt::format_to(out, "\n]}}\n");
+
+    if (file)
+    {
+        spdlog::info("Wrote trace to {}", path);
+    }
+    else
+    {
+        spdlog::error("Could not write trace to {}", path);
+    }
+}
+
+inline auto Profiler::threadBuffer() -> ThreadBuffer&
+{
+    thread_local BufferOwner owner;
+    if (!owner.buffer)
+    {
+        auto& profiler = get();
+
+        std::lock_guard<std::mutex> lock(profiler.m_Mutex);
+        owner.buffer = std::make_shared<ThreadBuffer>("Thread " + std::to_string(profiler.m_Buffers.size()));
+        profiler.m_Buffers.push_back(owner.buffer);
+    }
+    return *owner.buffer;
+}
+
+inline void Profiler::releaseExited()
+{
+    // A capture being recorded or written still wants what the thread did before it exited
+    if (tracing() || m_WritingTrace)
+    {
+        return;
+    }
+
+    std::erase_if(m_Buffers, [](std::shared_ptr<ThreadBuffer> const& buffer)
+    {
+        return buffer->m_Exited.load(std::memory_order_relaxed);
+    });
+}
+
+inline void Profiler::setThreadName(std::string name)
+{
+    auto& buffer = threadBuffer();
+
+    std::lock_guard<std::mutex> lock(get().m_Mutex);
+    buffer.m_Name = std::move(name);
+}
+
+inline auto Profiler::now() -> u64
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+inline void Profiler::collect()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        for (auto const& buffer : m_Buffers)
+        {
+            if (std::none_of(m_Readers.begin(), m_Readers.end(), [&](Reader const& reader) { return reader.buffer == buffer; }))
+            {
+                m_Readers.emplace_back().buffer = buffer;
+                m_Threads.push_back({});
+            }
+        }
+        for (usize i = 0; i < m_Readers.size(); ++i)
+        {
+            m_Threads[i].name = m_Readers[i].buffer->m_Name;
+        }
+    }
+
+    constexpr u64 kRingSize = Config::kProfilerRingSize;
+
+    for (usize i = 0; i < m_Readers.size();)
+    {
+        auto& reader = m_Readers[i];
+        auto& view   = m_Threads[i];
+
+        // Checked first, so once it's set this read gets everything the thread ever wrote
+        const bool exited = reader.buffer->m_Exited.load(std::memory_order_acquire);
+
+        // Copy out what's new and still in the ring
+        const u64 head  = reader.buffer->m_Head.load(std::memory_order_acquire);
+        const u64 first = std::max(reader.read, head > kRingSize ? head - kRingSize : 0);
+        reader.scratch.clear();
+        for (u64 index = first; index < head; ++index)
+        {
+            Sample sample;
+            if (reader.buffer->read(index, sample))
+            {
+                reader.scratch.push_back(sample);
+            }
+        }
+        reader.read = head;
+
+        // Scopes finish inside out, so a top-level sample follows everything nested in it. What came
+        // after the last one belongs to a scope that's still running, and waits for the next collect().
+        for (auto const& sample : reader.scratch)
+        {
+            if (sample.depth != 0)
+            {
+                if (reader.open.size() < kRingSize)
+                {
+                    reader.open.push_back(sample);
+                }
+                continue;
+            }
+
+            view.lastFrame.clear();
+            view.lastFrame.push_back(sample);
+            for (auto const& nested : reader.open)
+            {
+                if (nested.start >= sample.start)
+                {
+                    view.lastFrame.push_back(nested);
+                }
+            }
+            reader.open.clear();
+        }
+        std::sort(view.lastFrame.begin(), view.lastFrame.end(), [](Sample const& a, Sample const& b)
+        {
+            return a.start != b.start ? a.start < b.start : a.depth < b.depth;
+        });
+
+        for (auto const& sample : reader.scratch)
+        {
+            auto series = std::find_if(reader.series.begin(), reader.series.end(), [&](Series const& s)
+            {
+                return s.name == sample.name && s.depth == sample.depth;
+            });
+            if (series == reader.series.end())
+            {
+                reader.series.push_back({ sample.name, sample.depth });
+                series = reader.series.end() - 1;
+            }
+            series->add(static_cast<f32>((sample.end - sample.start) / 1e6));
+        }
+
+        view.stats.clear();
+        for (auto const& series : reader.series)
+        {
+            view.stats.push_back(series.stats());
+        }
+
+        // Nothing more is coming, so let its buffers go
+        if (exited)
+        {
+            m_Readers.erase(m_Readers.begin() + i);
+            m_Threads.erase(m_Threads.begin() + i);
+            continue;
+        }
+        ++i;
+    }
+}
+
+inline auto Profiler::threads() const -> std::vector<ThreadView> const&
+{
+    return m_Threads;
+}
+
+inline void Profiler::Series::add(f32 durationMs)
+{
+    durationsMs[next] = durationMs;
+    next              = (next + 1) % durationsMs.size();
+    count             = std::min<u32>(count + 1, durationsMs.size());
+}
+
+inline auto Profiler::Series::stats() const -> Stats
+{
+    Stats result{ name, depth, 0.0, 0.0, 0.0 };
+    if (count == 0)
+    {
+        return result;
+    }
+
+    std::array<f32, Config::kProfilerWindow> sorted;
+    std::copy_n(durationsMs.begin(), count, sorted.begin());
+
+    f64 sum = 0.0;
+    for (u32 i = 0; i < count; ++i)
+    {
+        sum += sorted[i];
+    }
+
+    const u32 p99 = count * 99 / 100;
+    std::nth_element(sorted.begin(), sorted.begin() + p99, sorted.begin() + count);
+
+    result.minMs  = *std::min_element(sorted.begin(), sorted.begin() + count);
+    result.meanMs = sum / count;
+    result.p99Ms  = sorted[p99];
+    return result;
+}
+
+inline ProfileScope::ProfileScope(const char* name)
+: m_Name(name)
+{
+    if (Profiler::s_Flags.load(std::memory_order_relaxed) == 0)
+    {
+        return;
+    }
+
+    m_Buffer = &Profiler::threadBuffer();
+    ++m_Buffer->m_Depth;
+    m_Start = Profiler::now();
+}
+
+inline ProfileScope::~ProfileScope()
+{
+    if (m_Buffer == nullptr)
+    {
+        return;
+    }
+
+    const u64 end = Profiler::now();
+    --m_Buffer->m_Depth;
+    m_Buffer->push({ m_Name, m_Start, end, m_Buffer->m_Depth });
+}
@@ -1,28 +1,133 @@
 #pragma once
 
-#include "components/component.h"
-#include "components/nand_gate.h"
+#include "simulation/circuit_block.h"
+#include "simulation/components/component.h"
+#include "simulation/netlist.h"
+#include "simulation/node.h"
+#include "simulation/wire.h"
 
 #include "types.h"
 
-#include <memory>
+#include <algorithm>
+#include <atomic>
+#include <span>
+#include <unordered_map>
 #include <vector>
 
+// The circuit is stored as parallel arrays (structure of arrays), indexed by ComponentId and NodeId.
+// Edits take spans so a whole selection is applied in one pass, and the netlist is only
+// brought up to date once, on the next step() after the topology changed. Edits are recorded
+// as they're made, so that's a patch of the parts they touched rather than a recompile,
+// unless there were too many of them for a patch to be worth it.
+//
+// Nodes joined by wires form nets (see Netlist), and a net's value is only kept at its root's
+// entry in nodeValues. nodeValue() looks a node's up.
 class Circuit
 {
 public:
     Circuit();
     ~Circuit();
 
-    void step();
+    // What one step() did
+    struct StepStats final
+    {
+        u32 events          = 0; // Net value changes propagated
+        u32 gateEvaluations = 0;
+        u32 worklist        = 0; // Largest the changed-net or pending-gate list got
+    };
+
+    auto step() -> StepStats;
+
+    // Whether step() would do nothing: no edits to compile, no changes to propagate and no clocks to tick
+    auto isSettled() const -> bool;
+
+    auto addComponent(ComponentKind kind, Position position, Facing facing = Facing::Right) -> ComponentId;
+
+    // Returns the wires that were attached to the removed components, so they can be put back
+    auto removeComponents(std::span<ComponentId const> ids) -> std::vector<Wire>;
+    void restoreComponents(std::span<ComponentId const> ids);
+    void moveComponents(std::span<ComponentId const> ids, Delta delta);
+
+    // Wires aren't deduplicated, the same wire can be connected more than once. Disconnecting
+    // removes one copy per wire given, and returns the ones that were actually there.
+    void connect(std::span<Wire const> wires);
+    auto disconnect(std::span<Wire const> wires) -> std::vector<Wire>;
+
+    // Copies the given live components and the wires between them, relative to their top-left corner
+    auto extractBlock(std::span<ComponentId const> ids) const -> CircuitBlock;
+
+    // Appends a block with its origin at position. The new components are numbered
+    // consecutively from the returned id, in block order.
+    auto appendBlock(CircuitBlock const& block, Position position) -> ComponentId;
+
+    auto componentCount() const -> usize;
+    auto nodeOf(ComponentId id, u32 pin) const -> NodeId;
+
+    // The net a node is on, by its root, as of the last step. Nodes added since are on their own.
+    auto netOf(NodeId node) const -> NodeId;
+    auto nodeValue(NodeId node) const -> u8;
+
+    // The compiled netlist, rebuilt first if the topology has changed
+    auto netlist() -> Netlist const&;
+
+    // Uses a netlist built elsewhere for the current arrays, e.g. one loaded from a file, instead of compiling one
+    void adoptNetlist(Netlist netlist);
+
+    // Takes over another circuit's components, nodes and wires, e.g. one loaded off to the side
+    void replaceWith(Circuit&& other);
 
-    void addNAND(Position position);
+    // Bumped on every change, so views can tell when they need to refresh
+    std::atomic<u64> revision = 0;
+    // Bumped by every change that isn't a move: components or wires coming or going, or a new circuit
+    std::atomic<u64> structureRevision = 0;
+    // Components moved since a view last emptied this, so while structureRevision stands still it only
+    // has to refresh those. Emptied here instead, with structureRevision bumped, if nothing is reading it.
+    std::vector<ComponentId> movedComponents;
+    // Bumped by each step that changed a net's value, which leaves revision alone
+    std::atomic<u64> valueRevision = 0;
 
     // private:
-    // components
-    std::vector<Component*> components;
-    // nodes
-    // wires
+    // Components, indexed by ComponentId
+    std::vector<ComponentKind> kinds;
+    std::vector<Position>      positions;
+    std::vector<Facing>        facings;
+    std::vector<u8>            alive;
+    std::vector<NodeId>        firstNodes;
+
+    // Nodes, indexed by NodeId
+    std::vector<ComponentId> nodeComponents;
+    std::vector<u8>          nodeValues;
+
+    // Wires
+    std::vector<Wire> wires;
+
+private:
+    void compile();
+    void patchNetlist();
+    void refreshNetlist();
+    void restartPropagation();
+
+    // Copies each net's value from its root to all of its nodes, before the nets are rebuilt
+    void spreadNetValues();
+
+    // Turns an edit into a full recompile once patching would be as much work
+    void checkEditBudget();
+    void setNet(NodeId net, u8 value);
+
+    // Bumps revision and structureRevision
+    void structureChanged();
+
+    // Steps between clock edges
+    static constexpr u64 kClockHalfPeriod = 64;
+
+    Netlist                  netlist_;
+    bool                     netlistDirty_ = true; // Needs compiling from scratch, edits_ aren't kept
+    NetlistEdits             edits_;
+    ComponentId              netlistComponents_ = 0; // Components the netlist covers, the rest are new
+    u64                      ticks_        = 0;
+    std::vector<NodeId>      changedNets_;
+    std::vector<ComponentId> pendingGates_;
+    std::vector<u8>          gatePending_;
 };
 
 inline Circuit::Circuit()
@@ -31,18 +136,469 @@ inline Circuit::Circuit()
 
 inline Circuit::~Circuit()
 {
-    // TODO: RAII
-    for (auto component : components)
+}
+
+// A whole net changes at once, gates take one step to respond.
+// Only gates with a changed input are evaluated.
+inline auto Circuit::step() -> StepStats
+{
+    refreshNetlist();
+
+    auto const& nets   = netlist_.nets;
+    const bool  ticked = ++ticks_ % kClockHalfPeriod == 0 && !netlist_.clocks.empty();
+    if (ticked)
+    {
+        for (auto clock : netlist_.clocks)
+        {
+            setNet(nets[clock], !nodeValues[nets[clock]]);
+        }
+    }
+
+    for (usize i = 0; i < changedNets_.size(); ++i)
+    {
+        const auto net = changedNets_[i];
+        for (u32 j = netlist_.readerStarts[net]; j < netlist_.readerStarts[net + 1]; ++j)
+        {
+            const auto gate = netlist_.readers[j];
+            if (!gatePending_[gate])
+            {
+                gatePending_[gate] = true;
+                pendingGates_.push_back(gate);
+            }
+        }
+    }
+    StepStats stats;
+    stats.events          = static_cast<u32>(changedNets_.size());
+    stats.gateEvaluations = static_cast<u32>(pendingGates_.size());
+    stats.worklist        = std::max(stats.events, stats.gateEvaluations);
+    changedNets_.clear();
+
+    for (auto gate : pendingGates_)
+    {
+        const auto first = firstNodes[gate];
+        gatePending_[gate] = false;
+        setNet(nets[first + 2], !(nodeValues[nets[first]] && nodeValues[nets[first + 1]]));
+    }
+    pendingGates_.clear();
+
+    // The gates' changes are queued for the next step to propagate
+    if (ticked || !changedNets_.empty())
+    {
+        ++valueRevision;
+    }
+
+    return stats;
+}
+
+inline auto Circuit::addComponent(ComponentKind kind, Position position, Facing facing) -> ComponentId
+{
+    const auto id        = static_cast<ComponentId>(kinds.size());
+    const auto firstNode = static_cast<NodeId>(nodeComponents.size());
+
+    kinds.push_back(kind);
+    positions.push_back(position);
+    facings.push_back(facing);
+    alive.push_back(true);
+    firstNodes.push_back(firstNode);
+
+    nodeComponents.insert(nodeComponents.end(), componentInfo(kind).nodeCount, id);
+    nodeValues.insert(nodeValues.end(), componentInfo(kind).nodeCount, false);
+
+    // New ids are past netlistComponents_, so the next patch picks this up without recording anything
+    structureChanged();
+
+    return id;
+}
+
+inline auto Circuit::removeComponents(std::span<ComponentId const> ids) -> std::vector<Wire>
+{
+    for (auto id : ids)
+    {
+        alive[id] = false;
+    }
+
+    std::vector<Wire> removed;
+    std::erase_if(wires, [&](Wire const& wire)
+    {
+        if (alive[nodeComponents[wire.from]] && alive[nodeComponents[wire.to]])
+        {
+            return false;
+        }
+
+        removed.push_back(wire);
+        return true;
+    });
+
+    if (!netlistDirty_)
+    {
+        edits_.touched.insert(edits_.touched.end(), ids.begin(), ids.end());
+        edits_.removedWires.insert(edits_.removedWires.end(), removed.begin(), removed.end());
+        checkEditBudget();
+    }
+    structureChanged();
+
+    return removed;
+}
+
+inline void Circuit::restoreComponents(std::span<ComponentId const> ids)
+{
+    for (auto id : ids)
+    {
+        alive[id] = true;
+    }
+
+    if (!netlistDirty_)
+    {
+        edits_.touched.insert(edits_.touched.end(), ids.begin(), ids.end());
+        checkEditBudget();
+    }
+    structureChanged();
+}
+
+inline void Circuit::moveComponents(std::span<ComponentId const> ids, Delta delta)
+{
+    for (auto id : ids)
     {
-        delete component;
+        positions[id].x += delta.dx;
+        positions[id].y += delta.dy;
     }
+
+    if (movedComponents.size() + ids.size() > kinds.size())
+    {
+        movedComponents.clear();
+        ++structureRevision;
+    }
+    else
+    {
+        movedComponents.insert(movedComponents.end(), ids.begin(), ids.end());
+    }
+    ++revision;
 }
 
-inline void Circuit::step()
+inline void Circuit::connect(std::span<Wire const> newWires)
 {
+    wires.insert(wires.end(), newWires.begin(), newWires.end());
+
+    if (!netlistDirty_)
+    {
+        edits_.addedWires.insert(edits_.addedWires.end(), newWires.begin(), newWires.end());
+        checkEditBudget();
+    }
+    structureChanged();
 }
 
-inline void Circuit::addNAND(Position position)
+inline auto Circuit::disconnect(std::span<Wire const> oldWires) -> std::vector<Wire>
 {
-    components.push_back(new NandGate(position));
+    const auto key = [](Wire const& wire)
+    {
+        return static_cast<u64>(wire.from) << 32 | wire.to;
+    };
+
+    // How many copies of each wire to remove
+    std::unordered_map<u64, u32> doomed;
+    doomed.reserve(oldWires.size());
+    for (auto const& wire : oldWires)
+    {
+        ++doomed[key(wire)];
+    }
+
+    std::vector<Wire> removed;
+    std::erase_if(wires, [&](Wire const& wire)
+    {
+        const auto it = doomed.find(key(wire));
+        if (it == doomed.end() || it->second == 0)
+        {
+            return false;
+        }
+
+        --it->second;
+        removed.push_back(wire);
+        return true;
+    });
+
+    if (!netlistDirty_)
+    {
+        edits_.removedWires.insert(edits_.removedWires.end(), removed.begin(), removed.end());
+        checkEditBudget();
+    }
+    structureChanged();
+    return removed;
+}
+
+inline auto Circuit::extractBlock(std::span<ComponentId const> ids) const -> CircuitBlock
+{
+    CircuitBlock block;
+
+    // Remap table from circuit node to block node, for picking out the internal wires
+    std::vector<NodeId> nodeRemap(nodeComponents.size(), kInvalidNodeId);
+
+    Position origin = { 0.0, 0.0 };
+    for (auto id : ids)
+    {
+        if (!alive[id])
+        {
+            continue;
+        }
+
+        const auto index     = static_cast<u32>(block.kinds.size());
+        const auto firstNode = static_cast<NodeId>(block.nodeComponents.size());
+        const auto nodeCount = componentInfo(kinds[id]).nodeCount;
+
+        origin = index == 0 ? positions[id] : Position{ std::min(origin.x, positions[id].x), std::min(origin.y, positions[id].y) };
+
+        block.kinds.push_back(kinds[id]);
+        block.positions.push_back(positions[id]);
+        block.facings.push_back(facings[id]);
+        block.firstNodes.push_back(firstNode);
+        block.nodeComponents.insert(block.nodeComponents.end(), nodeCount, index);
+
+        for (u32 pin = 0; pin < nodeCount; ++pin)
+        {
+            nodeRemap[firstNodes[id] + pin] = firstNode + pin;
+        }
+    }
+
+    block.origin = origin;
+    for (auto& position : block.positions)
+    {
+        position = { position.x - origin.x, position.y - origin.y };
+    }
+
+    for (auto const& wire : wires)
+    {
+        if (nodeRemap[wire.from] != kInvalidNodeId && nodeRemap[wire.to] != kInvalidNodeId)
+        {
+            block.wires.push_back({ nodeRemap[wire.from], nodeRemap[wire.to] });
+        }
+    }
+
+    return block;
+}
+
+inline auto Circuit::appendBlock(CircuitBlock const& block, Position position) -> ComponentId
+{
+    const auto firstId   = static_cast<ComponentId>(kinds.size());
+    const auto firstNode = static_cast<NodeId>(nodeComponents.size());
+
+    kinds.insert(kinds.end(), block.kinds.begin(), block.kinds.end());
+    facings.insert(facings.end(), block.facings.begin(), block.facings.end());
+    alive.resize(alive.size() + block.componentCount(), true);
+    nodeValues.resize(nodeValues.size() + block.nodeCount(), false);
+
+    positions.reserve(positions.size() + block.componentCount());
+    for (auto const& relative : block.positions)
+    {
+        positions.push_back({ position.x + relative.x, position.y + relative.y });
+    }
+
+    firstNodes.reserve(firstNodes.size() + block.componentCount());
+    for (auto node : block.firstNodes)
+    {
+        firstNodes.push_back(firstNode + node);
+    }
+
+    nodeComponents.reserve(nodeComponents.size() + block.nodeCount());
+    for (auto component : block.nodeComponents)
+    {
+        nodeComponents.push_back(firstId + component);
+    }
+
+    wires.reserve(wires.size() + block.wires.size());
+    for (auto const& wire : block.wires)
+    {
+        wires.push_back({ firstNode + wire.from, firstNode + wire.to });
+    }
+
+    if (!netlistDirty_)
+    {
+        edits_.addedWires.insert(edits_.addedWires.end(), wires.end() - block.wires.size(), wires.end());
+        checkEditBudget();
+    }
+    structureChanged();
+
+    return firstId;
+}
+
+inline auto Circuit::componentCount() const -> usize
+{
+    return kinds.size();
+}
+
+inline auto Circuit::nodeOf(ComponentId id, u32 pin) const -> NodeId
+{
+    return firstNodes[id] + pin;
+}
+
+inline auto Circuit::netOf(NodeId node) const -> NodeId
+{
+    return node < netlist_.nets.size() ? netlist_.nets[node] : node;
+}
+
+inline auto Circuit::nodeValue(NodeId node) const -> u8
+{
+    return nodeValues[netOf(node)];
+}
+
+inline void Circuit::compile()
+{
+    spreadNetValues();
+    netlist_.build(kinds, alive, firstNodes, nodeComponents, wires);
+    restartPropagation();
+}
+
+// Like restartPropagation(), but only for what the edits changed
+inline void Circuit::patchNetlist()
+{
+    const auto firstNew = netlistComponents_;
+    netlist_.patch(kinds, alive, firstNodes, nodeComponents, edits_, firstNew, nodeValues, changedNets_);
+    netlistComponents_ = static_cast<ComponentId>(kinds.size());
+    gatePending_.resize(kinds.size(), false);
+
+    // Removed gates don't get evaluated, new and restored ones do
+    if (!edits_.touched.empty())
+    {
+        std::erase_if(pendingGates_, [&](ComponentId gate)
+        {
+            if (alive[gate])
+            {
+                return false;
+            }
+
+            gatePending_[gate] = false;
+            return true;
+        });
+    }
+
+    auto evaluate = [&](ComponentId id)
+    {
+        if (alive[id] && kinds[id] == ComponentKind::NAND && !gatePending_[id])
+        {
+            gatePending_[id] = true;
+            pendingGates_.push_back(id);
+        }
+    };
+
+    for (auto id : edits_.touched)
+    {
+        evaluate(id);
+    }
+    for (ComponentId id = firstNew; id < kinds.size(); ++id)
+    {
+        evaluate(id);
+    }
+
+    edits_.clear();
+}
+
+inline auto Circuit::isSettled() const -> bool
+{
+    const bool compiled = !netlistDirty_ && edits_.size() == 0 && netlistComponents_ == kinds.size();
+    return compiled && changedNets_.empty() && pendingGates_.empty() && netlist_.clocks.empty();
+}
+
+inline void Circuit::refreshNetlist()
+{
+    if (netlistDirty_)
+    {
+        compile();
+    }
+    else if (edits_.size() > 0 || netlistComponents_ != kinds.size())
+    {
+        patchNetlist();
+    }
+}
+
+inline void Circuit::checkEditBudget()
+{
+    // Past this a patch rewrites about as much as a build does, so it may as well be one
+    if (edits_.size() > wires.size() / 8 + 1024)
+    {
+        netlistDirty_ = true;
+        edits_.clear();
+    }
+}
+
+inline void Circuit::structureChanged()
+{
+    ++structureRevision;
+    ++revision;
+}
+
+inline void Circuit::adoptNetlist(Netlist netlist)
+{
+    netlist_ = std::move(netlist);
+    restartPropagation();
+    structureChanged();
+}
+
+inline void Circuit::replaceWith(Circuit&& other)
+{
+    kinds          = std::move(other.kinds);
+    positions      = std::move(other.positions);
+    facings        = std::move(other.facings);
+    alive          = std::move(other.alive);
+    firstNodes     = std::move(other.firstNodes);
+    nodeComponents = std::move(other.nodeComponents);
+    nodeValues     = std::move(other.nodeValues);
+    wires          = std::move(other.wires);
+
+    // Keep its netlist if it was already compiled, so that can happen before the swap. Ours doesn't
+    // describe the new nodes, so it mustn't be used to spread their values either way.
+    changedNets_.clear();
+    pendingGates_.clear();
+    if (!other.netlistDirty_ && other.edits_.size() == 0 && other.netlistComponents_ == kinds.size())
+    {
+        netlist_ = std::move(other.netlist_);
+        restartPropagation();
+    }
+    else
+    {
+        netlist_      = Netlist{};
+        netlistDirty_ = true;
+    }
+    structureChanged();
+}
+
+inline auto Circuit::netlist() -> Netlist const&
+{
+    refreshNetlist();
+    return netlist_;
+}
+
+inline void Circuit::restartPropagation()
+{
+    netlistDirty_      = false;
+    netlistComponents_ = static_cast<ComponentId>(kinds.size());
+    edits_.clear();
+
+    // Connectivity changed, so every gate's inputs may have too
+    gatePending_.assign(kinds.size(), false);
+    pendingGates_ = netlist_.gates;
+    for (auto gate : pendingGates_)
+    {
+        gatePending_[gate] = true;
+    }
+
+    // Each net starts out with its root's value, the gates driving it put it right on the next step
+    changedNets_.clear();
+}
+
+inline void Circuit::spreadNetValues()
+{
+    auto const& nets = netlist_.nets;
+    for (NodeId node = 0; node < std::min(nets.size(), nodeValues.size()); ++node)
+    {
+        nodeValues[node] = nodeValues[nets[node]];
+    }
+}
+
+inline void Circuit::setNet(NodeId net, u8 value)
+{
+    if (nodeValues[net] == value)
+    {
+        return;
+    }
+
+    nodeValues[net] = value;
+    changedNets_.push_back(net);
 }
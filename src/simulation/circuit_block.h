@@ -0,0 +1,48 @@
+#pragma once
+
+#include "types.h"
+
+#include "simulation/components/component.h"
+#include "simulation/node.h"
+#include "simulation/wire.h"
+
+#include <vector>
+
+// A relocatable copy of part of a circuit, laid out like Circuit's own arrays but with every
+// index relative to the block: component i is the block's ith component, node n its nth node,
+// and positions are relative to the block's origin. Only wires with both ends inside the block
+// are kept. Circuit::appendBlock() splices one in with a single append per array.
+struct CircuitBlock final
+{
+    std::vector<ComponentKind> kinds;
+    std::vector<Position>      positions;
+    std::vector<Facing>        facings;
+    std::vector<NodeId>        firstNodes;
+    std::vector<u32>           nodeComponents;
+    std::vector<Wire>          wires;
+
+    // Where the block was copied from, if it came out of a circuit
+    Position origin = { 0.0, 0.0 };
+
+    auto componentCount() const -> usize;
+    auto nodeCount() const -> usize;
+    auto empty() const -> bool;
+
+    // Bump when the arrays, or the types in them, change layout. The prefab cache stores them raw.
+    static constexpr u32 kLayoutVersion = 1;
+};
+
+inline auto CircuitBlock::componentCount() const -> usize
+{
+    return kinds.size();
+}
+
+inline auto CircuitBlock::nodeCount() const -> usize
+{
+    return nodeComponents.size();
+}
+
+inline auto CircuitBlock::empty() const -> bool
+{
+    return kinds.empty();
+}
@@ -0,0 +1,598 @@
+#pragma once
+
+#include "parallel.h"
+#include "types.h"
+
+#include "simulation/circuit.h"
+#include "simulation/components/component.h"
+#include "simulation/components/component_registry.h"
+#include "simulation/netlist.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#ifdef _WIN32
+#include <iterator>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Binary circuit files.
+//
+// A header, a table of sections, then each section's array exactly as it sits in memory, every one
+// starting on a kAlignment boundary. Mapping the file gives the circuit's SoA arrays and its compiled
+// netlist as spans straight into the page cache: nothing is parsed, and two processes opening the
+// same file share its pages. Loading into an editable Circuit is one bulk copy per array, and the
+// stored netlist is adopted as is rather than rebuilt.
+//
+// Component kinds are written as indices into a table of their registry names (kindName()), so
+// reordering ComponentKind doesn't break old files. Everything else is raw native-endian data; the
+// header records the byte order and every section its element size, and a file that doesn't match
+// is rejected rather than converted.
+namespace CircuitFile
+{
+    constexpr std::array<char, 8> kMagic     = { 'N', 'A', 'N', 'D', 'Y', 'C', 'I', 'R' };
+    constexpr u32                 kVersion   = 3;
+    constexpr u32                 kByteOrder = 0x01020304;
+    constexpr u64                 kAlignment = 64;
+
+    enum class Section : u32
+    {
+        // Components
+        Kinds = 1,
+        Positions,
+        Facings,
+        Alive,
+        FirstNodes,
+
+        // Nodes
+        NodeComponents,
+        NodeValues,
+
+        Wires,
+
+        // Netlist
+        FanoutStarts,
+        Fanout,
+        ReaderStarts,
+        Readers,
+        Gates,
+        Clocks,
+
+        // String table: '\0'-terminated registry kind names, Kinds indexes them in order. Registry
+        // names from version 3.
+        KindNames,
+
+        // Each node's net, from version 2, when readers started being listed by net. Ids are stored
+        // in files, and 16 was held for a section that was never written.
+        Nets = 17,
+    };
+
+    struct Header final
+    {
+        std::array<char, 8> magic;
+        u32                 version;
+        u32                 byteOrder;
+        u64                 componentCount;
+        u64                 nodeCount;
+        u64                 wireCount;
+        u32                 sectionCount;
+        u32                 reserved;
+    };
+
+    struct SectionEntry final
+    {
+        Section id;
+        u32     elementSize;
+        u64     offset; // From the start of the file
+        u64     count;  // Elements, not bytes
+    };
+
+    // Writes the circuit and its compiled netlist. Returns false if the file couldn't be written.
+    auto save(Circuit& circuit, std::string const& path) -> bool;
+} // namespace CircuitFile
+
+// A circuit file mapped read-only. The spans it hands out are valid for its lifetime.
+class MappedCircuitFile final
+{
+public:
+    // Returns nullptr, after logging why, if the file can't be opened or isn't a valid circuit file
+    static auto open(std::string const& path) -> std::unique_ptr<MappedCircuitFile>;
+
+    ~MappedCircuitFile();
+
+    MappedCircuitFile(MappedCircuitFile const&)            = delete;
+    MappedCircuitFile& operator=(MappedCircuitFile const&) = delete;
+
+    auto header() const -> CircuitFile::Header const&;
+
+    // Empty if the file doesn't have the section
+    template <typename T>
+    auto section(CircuitFile::Section id) const -> std::span<T const>;
+
+    // Replaces everything in circuit with the file's contents
+    void loadInto(Circuit& circuit) const;
+
+private:
+    MappedCircuitFile(std::byte const* data, usize size);
+
+    auto validate() const -> bool;
+
+    // Our kind for each entry in the file's kind name table. Logs and returns nullopt on a name the
+    // registry doesn't know.
+    auto kindTable() const -> std::optional<std::vector<ComponentKind>>;
+    auto entry(CircuitFile::Section id) const -> CircuitFile::SectionEntry const*;
+
+    std::byte const* m_Data;
+    usize            m_Size;
+#ifdef _WIN32
+    std::vector<std::byte> m_Contents; // No mmap, read into memory instead
+#endif
+};
+
+namespace CircuitFile
+{
+    namespace detail
+    {
+        template <typename T>
+        auto sectionFor(Section id, std::span<T const> data) -> std::pair<SectionEntry, std::span<std::byte const>>
+        {
+            return { { id, sizeof(T), 0, data.size() }, std::as_bytes(data) };
+        }
+    } // namespace detail
+
+    inline auto save(Circuit& circuit, std::string const& path) -> bool
+    {
+        auto const& netlist = circuit.netlist();
+
+        // Kinds as indices into the name table
+        std::string names;
+        for (u32 kind = 0; kind < kComponentInfos.size(); ++kind)
+        {
+            names += kindName(static_cast<ComponentKind>(kind));
+            names += '\0';
+        }
+
+        // Only each net's root holds its value in memory, every node gets it in the file
+        std::vector<u8> values(circuit.nodeValues.size());
+        for (NodeId node = 0; node < values.size(); ++node)
+        {
+            values[node] = circuit.nodeValue(node);
+        }
+
+        std::vector<u8> kinds(circuit.kinds.size());
+        std::transform(circuit.kinds.begin(), circuit.kinds.end(), kinds.begin(), [](ComponentKind kind)
+        {
+            return static_cast<u8>(kind);
+        });
+
+        const std::array sections = {
+            detail::sectionFor<u8>(Section::Kinds, kinds),
+            detail::sectionFor<Position>(Section::Positions, circuit.positions),
+            detail::sectionFor<Facing>(Section::Facings, circuit.facings),
+            detail::sectionFor<u8>(Section::Alive, circuit.alive),
+            detail::sectionFor<NodeId>(Section::FirstNodes, circuit.firstNodes),
+            detail::sectionFor<ComponentId>(Section::NodeComponents, circuit.nodeComponents),
+            detail::sectionFor<u8>(Section::NodeValues, values),
+            detail::sectionFor<Wire>(Section::Wires, circuit.wires),
+            detail::sectionFor<u32>(Section::FanoutStarts, netlist.fanoutStarts),
+            detail::sectionFor<NodeId>(Section::Fanout, netlist.fanout),
+            detail::sectionFor<u32>(Section::ReaderStarts, netlist.readerStarts),
+            detail::sectionFor<ComponentId>(Section::Readers, netlist.readers),
+            detail::sectionFor<ComponentId>(Section::Gates, netlist.gates),
+            detail::sectionFor<NodeId>(Section::Clocks, netlist.clocks),
+            detail::sectionFor<NodeId>(Section::Nets, netlist.nets),
+            detail::sectionFor<char>(Section::KindNames, std::span<char const>(names)),
+        };
+
+        Header header{};
+        header.magic          = kMagic;
+        header.version        = kVersion;
+        header.byteOrder      = kByteOrder;
+        header.componentCount = circuit.kinds.size();
+        header.nodeCount      = circuit.nodeComponents.size();
+        header.wireCount      = circuit.wires.size();
+        header.sectionCount   = static_cast<u32>(sections.size());
+
+        auto alignUp = [](u64 offset)
+        {
+            return (offset + kAlignment - 1) / kAlignment * kAlignment;
+        };
+
+        std::array<SectionEntry, sections.size()> table;
+        u64                                       offset = alignUp(sizeof(Header) + sizeof(table));
+        for (usize i = 0; i < sections.size(); ++i)
+        {
+            table[i]        = sections[i].first;
+            table[i].offset = offset;
+            offset          = alignUp(offset + sections[i].second.size());
+        }
+
+        // Written to a temporary file and renamed over the old one, so a failed or interrupted save
+        // leaves the previous file as it was
+        const auto      tempPath = path + ".tmp";
+        std::error_code error;
+        {
+            std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+            file.write(reinterpret_cast<char const*>(&header), sizeof(header));
+            file.write(reinterpret_cast<char const*>(table.data()), sizeof(table));
+
+            constexpr std::array<char, kAlignment> kPadding{};
+            u64                                    written = sizeof(Header) + sizeof(table);
+            for (usize i = 0; i < sections.size(); ++i)
+            {
+                file.write(kPadding.data(), table[i].offset - written);
+                file.write(reinterpret_cast<char const*>(sections[i].second.data()), sections[i].second.size());
+                written = table[i].offset + sections[i].second.size();
+            }
+
+            if (!file.flush())
+            {
+                file.close();
+                std::filesystem::remove(tempPath, error);
+                return false;
+            }
+        }
+
+        std::filesystem::rename(tempPath, path, error);
+        if (error)
+        {
+            std::filesystem::remove(tempPath, error);
+            return false;
+        }
+        return true;
+    }
+} // namespace CircuitFile
+
+inline MappedCircuitFile::MappedCircuitFile(std::byte const* data, usize size)
+: m_Data(data)
+, m_Size(size)
+{
+}
+
+inline auto MappedCircuitFile::open(std::string const& path) -> std::unique_ptr<MappedCircuitFile>
+{
+    std::unique_ptr<MappedCircuitFile> file;
+
+#ifdef _WIN32
+    std::ifstream stream(path, std::ios::binary);
+    if (!stream)
+    {
+        spdlog::error("Could not open circuit file {}", path);
+        return nullptr;
+    }
+
+    std::vector<char> contents((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+    file.reset(new MappedCircuitFile(nullptr, contents.size()));
+    file->m_Contents.resize(contents.size());
+    std::memcpy(file->m_Contents.data(), contents.data(), contents.size());
+    file->m_Data = file->m_Contents.data();
+#else
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        spdlog::error("Could not open circuit file {}", path);
+        return nullptr;
+    }
+
+    struct stat status{};
+    void*       data = MAP_FAILED;
+    if (::fstat(fd, &status) == 0 && status.st_size > 0)
+    {
+        data = ::mmap(nullptr, status.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    ::close(fd); // The mapping keeps the file alive
+
+    if (data == MAP_FAILED)
+    {
+        spdlog::error("Could not map circuit file {}", path);
+        return nullptr;
+    }
+
+    file.reset(new MappedCircuitFile(static_cast<std::byte const*>(data), status.st_size));
+#endif
+
+    if (!file->validate())
+    {
+        spdlog::error("{} is not a valid circuit file", path);
+        return nullptr;
+    }
+
+    return file;
+}
+
+inline MappedCircuitFile::~MappedCircuitFile()
+{
+#ifndef _WIN32
+    ::munmap(const_cast<std::byte*>(m_Data), m_Size);
+#endif
+}
+
+inline auto MappedCircuitFile::header() const -> CircuitFile::Header const&
+{
+    return *reinterpret_cast<CircuitFile::Header const*>(m_Data);
+}
+
+template <typename T>
+inline auto MappedCircuitFile::section(CircuitFile::Section id) const -> std::span<T const>
+{
+    auto const* found = entry(id);
+    if (found == nullptr || found->elementSize != sizeof(T))
+    {
+        return {};
+    }
+
+    return { reinterpret_cast<T const*>(m_Data + found->offset), found->count };
+}
+
+inline auto MappedCircuitFile::entry(CircuitFile::Section id) const -> CircuitFile::SectionEntry const*
+{
+    auto const* table = reinterpret_cast<CircuitFile::SectionEntry const*>(m_Data + sizeof(CircuitFile::Header));
+    for (u32 i = 0; i < header().sectionCount; ++i)
+    {
+        if (table[i].id == id)
+        {
+            return &table[i];
+        }
+    }
+    return nullptr;
+}
+
+// Checks the layout, that the arrays agree on their sizes, that every stored id is in range, and that
+// the netlist is shaped the way the simulation and Netlist::patch() rely on, as anything else would take
+// them down. That's a few linear passes over the ids, nothing is decoded.
+inline auto MappedCircuitFile::validate() const -> bool
+{
+    using CircuitFile::Section;
+
+    if (m_Size < sizeof(CircuitFile::Header))
+    {
+        return false;
+    }
+
+    auto const& h = header();
+    if (h.magic != CircuitFile::kMagic || h.version != CircuitFile::kVersion || h.byteOrder != CircuitFile::kByteOrder)
+    {
+        return false;
+    }
+
+    if (sizeof(CircuitFile::Header) + static_cast<u64>(h.sectionCount) * sizeof(CircuitFile::SectionEntry) > m_Size)
+    {
+        return false;
+    }
+
+    auto const* table = reinterpret_cast<CircuitFile::SectionEntry const*>(m_Data + sizeof(CircuitFile::Header));
+    for (u32 i = 0; i < h.sectionCount; ++i)
+    {
+        auto const& s = table[i];
+        if (s.offset % CircuitFile::kAlignment != 0 || s.elementSize == 0 || s.count > (m_Size - std::min<u64>(s.offset, m_Size)) / s.elementSize)
+        {
+            return false;
+        }
+    }
+
+    const u64 components = h.componentCount;
+    const u64 nodes      = h.nodeCount;
+
+    auto kinds          = section<u8>(Section::Kinds);
+    auto facings        = section<Facing>(Section::Facings);
+    auto alive          = section<u8>(Section::Alive);
+    auto firstNodes     = section<NodeId>(Section::FirstNodes);
+    auto nodeComponents = section<ComponentId>(Section::NodeComponents);
+    auto wires          = section<Wire>(Section::Wires);
+    auto fanoutStarts   = section<u32>(Section::FanoutStarts);
+    auto fanout         = section<NodeId>(Section::Fanout);
+    auto readerStarts   = section<u32>(Section::ReaderStarts);
+    auto readers        = section<ComponentId>(Section::Readers);
+    auto gates          = section<ComponentId>(Section::Gates);
+    auto clocks         = section<NodeId>(Section::Clocks);
+    auto nets           = section<NodeId>(Section::Nets);
+
+    const bool sizesMatch =
+        kinds.size() == components &&
+        section<Position>(Section::Positions).size() == components &&
+        facings.size() == components &&
+        alive.size() == components &&
+        firstNodes.size() == components &&
+        nodeComponents.size() == nodes &&
+        section<u8>(Section::NodeValues).size() == nodes &&
+        wires.size() == h.wireCount &&
+        fanoutStarts.size() == nodes + 1 &&
+        fanout.size() == wires.size() &&
+        readerStarts.size() == nodes + 1 &&
+        readers.size() == gates.size() * 2 &&
+        nets.size() == nodes &&
+        !section<char>(Section::KindNames).empty();
+    if (!sizesMatch)
+    {
+        return false;
+    }
+
+    const auto kindOf = kindTable();
+    if (!kindOf)
+    {
+        return false;
+    }
+
+    // Each check is split across cores, these arrays run to millions of entries for a whole computer
+    constexpr usize kMinChunk = 1u << 16;
+
+    auto allBelow = [](auto span, u64 limit)
+    {
+        return Parallel::allOf(span.size(), kMinChunk, [&](usize i)
+        {
+            return span[i] < limit;
+        });
+    };
+
+    // CSR starts run from 0 up to the size of what they index, never going down
+    auto startsValid = [](std::span<u32 const> starts, u64 size)
+    {
+        return starts.front() == 0 && starts.back() == size && Parallel::allOf(starts.size() - 1, kMinChunk, [&](usize i)
+        {
+            return starts[i] <= starts[i + 1];
+        });
+    };
+
+    // Binary searched when the netlist is patched
+    auto ascending = [](auto span)
+    {
+        return span.size() < 2 || Parallel::allOf(span.size() - 1, kMinChunk, [&](usize i)
+        {
+            return span[i] < span[i + 1];
+        });
+    };
+
+    const bool componentsValid =
+        Parallel::allOf(components, kMinChunk, [&](usize id)
+        {
+            return kinds[id] < kindOf->size() &&
+                   static_cast<u32>(facings[id]) <= static_cast<u32>(Facing::Up) &&
+                   static_cast<u64>(firstNodes[id]) + componentInfo((*kindOf)[kinds[id]]).nodeCount <= nodes;
+        }) &&
+        Parallel::allOf(nodes, kMinChunk, [&](usize node)
+        {
+            const auto id = nodeComponents[node];
+            return id < components && firstNodes[id] <= node && node < firstNodes[id] + componentInfo((*kindOf)[kinds[id]]).nodeCount;
+        });
+    if (!componentsValid)
+    {
+        return false;
+    }
+
+    // The simulation evaluates whatever gates and readers name as NANDs, reading three nodes from each
+    auto isLiveKind = [&](ComponentId id, ComponentKind kind)
+    {
+        return id < components && alive[id] && (*kindOf)[kinds[id]] == kind;
+    };
+
+    const bool netlistValid =
+        Parallel::allOf(wires.size(), kMinChunk, [&](usize i)
+        {
+            return wires[i].from < nodes && wires[i].to < nodes;
+        }) &&
+        startsValid(fanoutStarts, fanout.size()) &&
+        startsValid(readerStarts, readers.size()) &&
+        allBelow(fanout, nodes) &&
+        ascending(gates) &&
+        ascending(clocks) &&
+        Parallel::allOf(gates.size(), kMinChunk, [&](usize i)
+        {
+            return isLiveKind(gates[i], ComponentKind::NAND);
+        }) &&
+        Parallel::allOf(readers.size(), kMinChunk, [&](usize i)
+        {
+            return isLiveKind(readers[i], ComponentKind::NAND);
+        }) &&
+        Parallel::allOf(clocks.size(), kMinChunk, [&](usize i)
+        {
+            return clocks[i] < nodes && isLiveKind(nodeComponents[clocks[i]], ComponentKind::Clock) && firstNodes[nodeComponents[clocks[i]]] == clocks[i];
+        });
+    if (!netlistValid)
+    {
+        return false;
+    }
+
+    // Every node points straight at a root no higher than itself, and wires stay within a net, which
+    // patching relies on when it splits a net up again
+    return Parallel::allOf(nodes, kMinChunk, [&](usize node)
+           {
+               return nets[node] <= node && nets[nets[node]] == nets[node];
+           }) &&
+           Parallel::allOf(nodes, kMinChunk, [&](usize node)
+           {
+               for (u32 j = fanoutStarts[node]; j < fanoutStarts[node + 1]; ++j)
+               {
+                   if (nets[fanout[j]] != nets[node])
+                   {
+                       return false;
+                   }
+               }
+               return true;
+           });
+}
+
+inline auto MappedCircuitFile::kindTable() const -> std::optional<std::vector<ComponentKind>>
+{
+    std::vector<ComponentKind> kindOf;
+    auto                       names = section<char>(CircuitFile::Section::KindNames);
+    for (usize start = 0; start < names.size();)
+    {
+        const auto end  = std::find(names.begin() + start, names.end(), '\0') - names.begin();
+        const auto name = std::string_view(names.data() + start, end - start);
+        const auto kind = findComponentKind(name);
+        if (!kind)
+        {
+            spdlog::error("Unknown component kind '{}' in circuit file", name);
+            return std::nullopt;
+        }
+
+        kindOf.push_back(*kind);
+        start = end + 1;
+    }
+    return kindOf;
+}
+
+inline void MappedCircuitFile::loadInto(Circuit& circuit) const
+{
+    using CircuitFile::Section;
+
+    auto assign = [](auto& vector, auto span)
+    {
+        vector.assign(span.begin(), span.end());
+    };
+
+    // Map the file's kind names onto ours. validate() has already checked they're all known.
+    const auto kindOf     = kindTable().value();
+    bool       kindsMoved = false;
+    for (usize kind = 0; kind < kindOf.size(); ++kind)
+    {
+        kindsMoved |= static_cast<usize>(kindOf[kind]) != kind;
+    }
+
+    auto kinds = section<u8>(Section::Kinds);
+    circuit.kinds.resize(kinds.size());
+    std::transform(kinds.begin(), kinds.end(), circuit.kinds.begin(), [&](u8 kind)
+    {
+        return kindOf[kind];
+    });
+
+    assign(circuit.positions, section<Position>(Section::Positions));
+    assign(circuit.facings, section<Facing>(Section::Facings));
+    assign(circuit.alive, section<u8>(Section::Alive));
+    assign(circuit.firstNodes, section<NodeId>(Section::FirstNodes));
+    assign(circuit.nodeComponents, section<ComponentId>(Section::NodeComponents));
+    assign(circuit.nodeValues, section<u8>(Section::NodeValues));
+    assign(circuit.wires, section<Wire>(Section::Wires));
+
+    // The stored netlist was built for the file's kinds, if they've changed meaning build a fresh one
+    Netlist netlist;
+    if (kindsMoved)
+    {
+        netlist.build(circuit.kinds, circuit.alive, circuit.firstNodes, circuit.nodeComponents, circuit.wires);
+        circuit.adoptNetlist(std::move(netlist));
+        return;
+    }
+
+    assign(netlist.fanoutStarts, section<u32>(Section::FanoutStarts));
+    assign(netlist.fanout, section<NodeId>(Section::Fanout));
+    assign(netlist.readerStarts, section<u32>(Section::ReaderStarts));
+    assign(netlist.readers, section<ComponentId>(Section::Readers));
+    assign(netlist.gates, section<ComponentId>(Section::Gates));
+    assign(netlist.clocks, section<NodeId>(Section::Clocks));
+    assign(netlist.nets, section<NodeId>(Section::Nets));
+    netlist.linkNets();
+    circuit.adoptNetlist(std::move(netlist));
+}
@@ -0,0 +1,503 @@
+#pragma once
+
+#include "parallel.h"
+#include "types.h"
+
+#include "simulation/circuit.h"
+#include "simulation/components/component.h"
+#include "simulation/components/component_registry.h"
+#include "simulation/node.h"
+#include "simulation/wire.h"
+
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+// JSON circuit files, for interchange. The binary format in circuit_file.h is the fast one.
+//
+//  {
+//      "version": 2,
+//      "componentCount": 2, "nodeCount": 4, "wireCount": 1,   // Optional, lets the loader reserve up front
+//      "components": [ { "kind": "NAND", "x": 0, "y": 0, "facing": "Right" }, ... ],
+//      "wires": [ [ 2, 3 ], ... ]                               // Node ids
+//  }
+//
+// Kinds are the registry's names for the primitives (kindName()). Nodes are numbered in component
+// order, each component taking componentInfo(kind).nodeCount of them.
+//
+// Loading goes through nlohmann's SAX interface, so components and wires are appended to the
+// circuit's arrays as they're read and no json document is ever built. Peak memory is the circuit
+// itself, plus vector growth when the counts aren't given.
+namespace CircuitJson
+{
+    constexpr u32 kVersion = 2; // 2 switched kinds to their registry names
+
+    // Called now and then with how far through the file the loader is, from 0 to 1
+    using ProgressFn = std::function<void(f32)>;
+
+    // Only live components are written, renumbered from 0
+    auto save(Circuit const& circuit, std::string const& path) -> bool;
+
+    // Appends the file's contents to circuit, which is normally empty. Logs and returns false on a bad file.
+    auto load(std::string const& path, Circuit& circuit, ProgressFn const& progress = {}) -> bool;
+
+    namespace detail
+    {
+        // nlohmann::json_sax, streaming straight into a Circuit
+        class Reader final
+        {
+        public:
+            Reader(Circuit& circuit, std::FILE* file, long fileSize, ProgressFn const& progress);
+
+            bool null();
+            bool boolean(bool value);
+            bool number_integer(json::number_integer_t value);
+            bool number_unsigned(json::number_unsigned_t value);
+            bool number_float(json::number_float_t value, json::string_t const& text);
+            bool string(json::string_t& value);
+            bool binary(json::binary_t& value);
+            bool start_object(std::size_t elements);
+            bool key(json::string_t& value);
+            bool end_object();
+            bool start_array(std::size_t elements);
+            bool end_array();
+            bool parse_error(std::size_t position, std::string const& lastToken, nlohmann::detail::exception const& ex);
+
+            // Checks what can only be checked once everything has been read
+            auto finish() -> bool;
+
+            auto error() const -> std::string const&;
+
+        private:
+            enum class Where
+            {
+                Root,
+                Components,
+                Component,
+                Wires,
+                Wire,
+                Skip, // Something we don't know about, read and thrown away
+            };
+
+            auto fail(std::string message) -> bool;
+            auto number(f64 value) -> bool;
+
+            // A count hint from the file as something safe to reserve, if it's a whole number no bigger
+            // than limit. Anything else is ignored, the arrays just grow as they're read.
+            static auto hint(f64 value, u64 limit) -> std::optional<usize>;
+            void reportProgress();
+
+            Circuit&          m_Circuit;
+            std::FILE*        m_File;
+            long              m_FileSize;
+            ProgressFn const& m_Progress;
+            u64               m_Elements = 0;
+
+            std::vector<Where> m_Stack;
+            std::string        m_Key;
+            std::string        m_Error;
+
+            // The component or wire being read
+            std::optional<ComponentKind> m_Kind;
+            Position                     m_Position = { 0.0, 0.0 };
+            Facing                       m_Facing   = Facing::Right;
+            u32                          m_WireEnd  = 0;
+            Wire                         m_Wire     = { 0, 0 };
+        };
+    } // namespace detail
+
+    inline auto save(Circuit const& circuit, std::string const& path) -> bool
+    {
+        std::unique_ptr<std::FILE, decltype(&std::fclose)> file(std::fopen(path.c_str(), "wb"), &std::fclose);
+        if (!file)
+        {
+            return false;
+        }
+
+        // Renumber the live components and their nodes
+        std::vector<NodeId> newFirstNode(circuit.kinds.size(), kInvalidNodeId);
+        u64                 liveComponents = 0;
+        NodeId              nodes          = 0;
+        for (ComponentId id = 0; id < circuit.kinds.size(); ++id)
+        {
+            if (circuit.alive[id])
+            {
+                newFirstNode[id] = nodes;
+                nodes += componentInfo(circuit.kinds[id]).nodeCount;
+                ++liveComponents;
+            }
+        }
+
+        auto newNode = [&](NodeId node)
+        {
+            const auto id = circuit.nodeComponents[node];
+            return newFirstNode[id] + (node - circuit.firstNodes[id]);
+        };
+
+        fmt::print(file.get(), "{{\n\"version\": {},\n\"componentCount\": {},\n\"nodeCount\": {},\n\"wireCount\": {},\n\"components\": [", kVersion, liveComponents, nodes, circuit.wires.size());
+
+        bool first = true;
+        for (ComponentId id = 0; id < circuit.kinds.size(); ++id)
+        {
+            if (circuit.alive[id])
+            {
+                fmt::print(file.get(), "{}\n{{\"kind\": \"{}\", \"x\": {}, \"y\": {}, \"facing\": \"{}\"}}", first ? "" : ",", kindName(circuit.kinds[id]), circuit.positions[id].x, circuit.positions[id].y, toString(circuit.facings[id]));
+                first = false;
+            }
+        }
+
+        fmt::print(file.get(), "\n],\n\"wires\": [");
+        first = true;
+        for (auto const& wire : circuit.wires)
+        {
+            fmt::print(file.get(), "{}\n[{}, {}]", first ? "" : ",", newNode(wire.from), newNode(wire.to));
+            first = false;
+        }
+        fmt::print(file.get(), "\n]\n}}\n");
+
+        return std::ferror(file.get()) == 0;
+    }
+
+    inline auto load(std::string const& path, Circuit& circuit, ProgressFn const& progress) -> bool
+    {
+        std::unique_ptr<std::FILE, decltype(&std::fclose)> file(std::fopen(path.c_str(), "rb"), &std::fclose);
+        if (!file)
+        {
+            spdlog::error("Could not open {}", path);
+            return false;
+        }
+
+        std::fseek(file.get(), 0, SEEK_END);
+        const long size = std::ftell(file.get());
+        std::fseek(file.get(), 0, SEEK_SET);
+
+        detail::Reader reader(circuit, file.get(), size, progress);
+        if (!json::sax_parse(file.get(), &reader) || !reader.finish())
+        {
+            spdlog::error("Could not load {}: {}", path, reader.error());
+            return false;
+        }
+
+        if (progress)
+        {
+            progress(1.0f);
+        }
+        return true;
+    }
+
+    namespace detail
+    {
+        inline Reader::Reader(Circuit& circuit, std::FILE* file, long fileSize, ProgressFn const& progress)
+        : m_Circuit(circuit)
+        , m_File(file)
+        , m_FileSize(fileSize)
+        , m_Progress(progress)
+        {
+        }
+
+        inline bool Reader::null()
+        {
+            return (!m_Stack.empty() && (m_Stack.back() == Where::Skip || m_Stack.back() == Where::Root)) || fail("unexpected null");
+        }
+
+        inline bool Reader::boolean(bool)
+        {
+            return (!m_Stack.empty() && (m_Stack.back() == Where::Skip || m_Stack.back() == Where::Root)) || fail("unexpected boolean");
+        }
+
+        inline bool Reader::number_integer(json::number_integer_t value)
+        {
+            return number(static_cast<f64>(value));
+        }
+
+        inline bool Reader::number_unsigned(json::number_unsigned_t value)
+        {
+            return number(static_cast<f64>(value));
+        }
+
+        inline bool Reader::number_float(json::number_float_t value, json::string_t const&)
+        {
+            return number(value);
+        }
+
+        inline bool Reader::string(json::string_t& value)
+        {
+            if (m_Stack.empty())
+            {
+                return fail("unexpected string");
+            }
+
+            if (m_Stack.back() != Where::Component)
+            {
+                return m_Stack.back() == Where::Skip || m_Stack.back() == Where::Root || fail("unexpected string");
+            }
+
+            if (m_Key == "kind")
+            {
+                m_Kind = findComponentKind(value);
+                return m_Kind || fail(fmt::format("unknown component kind '{}'", value));
+            }
+
+            if (m_Key == "facing")
+            {
+                for (auto facing : { Facing::Right, Facing::Down, Facing::Left, Facing::Up })
+                {
+                    if (toString(facing) == value)
+                    {
+                        m_Facing = facing;
+                        return true;
+                    }
+                }
+                return fail(fmt::format("unknown facing '{}'", value));
+            }
+
+            return true;
+        }
+
+        inline bool Reader::binary(json::binary_t&)
+        {
+            return fail("unexpected binary value");
+        }
+
+        inline bool Reader::start_object(std::size_t)
+        {
+            if (m_Stack.empty())
+            {
+                m_Stack.push_back(Where::Root);
+            }
+            else if (m_Stack.back() == Where::Components)
+            {
+                m_Stack.push_back(Where::Component);
+                m_Kind.reset();
+                m_Position = { 0.0, 0.0 };
+                m_Facing   = Facing::Right;
+            }
+            else
+            {
+                m_Stack.push_back(Where::Skip);
+            }
+            return true;
+        }
+
+        inline bool Reader::key(json::string_t& value)
+        {
+            m_Key = value;
+            return true;
+        }
+
+        inline bool Reader::end_object()
+        {
+            const auto where = m_Stack.back();
+            m_Stack.pop_back();
+
+            if (where != Where::Component)
+            {
+                return true;
+            }
+
+            if (!m_Kind)
+            {
+                return fail(fmt::format("component {} has no kind", m_Circuit.kinds.size()));
+            }
+
+            // The same as Circuit::addComponent, without touching the revision for every one
+            const auto id        = static_cast<ComponentId>(m_Circuit.kinds.size());
+            const auto firstNode = static_cast<NodeId>(m_Circuit.nodeComponents.size());
+            const auto nodeCount = componentInfo(*m_Kind).nodeCount;
+
+            m_Circuit.kinds.push_back(*m_Kind);
+            m_Circuit.positions.push_back(m_Position);
+            m_Circuit.facings.push_back(m_Facing);
+            m_Circuit.alive.push_back(true);
+            m_Circuit.firstNodes.push_back(firstNode);
+            m_Circuit.nodeComponents.insert(m_Circuit.nodeComponents.end(), nodeCount, id);
+            m_Circuit.nodeValues.insert(m_Circuit.nodeValues.end(), nodeCount, false);
+
+            reportProgress();
+            return true;
+        }
+
+        inline bool Reader::start_array(std::size_t)
+        {
+            if (m_Stack.empty())
+            {
+                return fail("expected an object at the top level");
+            }
+
+            const auto parent = m_Stack.back();
+            if (parent == Where::Root && m_Key == "components")
+            {
+                m_Stack.push_back(Where::Components);
+            }
+            else if (parent == Where::Root && m_Key == "wires")
+            {
+                m_Stack.push_back(Where::Wires);
+            }
+            else if (parent == Where::Wires)
+            {
+                m_Stack.push_back(Where::Wire);
+                m_WireEnd = 0;
+            }
+            else
+            {
+                m_Stack.push_back(Where::Skip);
+            }
+            return true;
+        }
+
+        inline bool Reader::end_array()
+        {
+            const auto where = m_Stack.back();
+            m_Stack.pop_back();
+
+            if (where != Where::Wire)
+            {
+                return true;
+            }
+
+            if (m_WireEnd != 2)
+            {
+                return fail(fmt::format("wire {} doesn't have two ends", m_Circuit.wires.size()));
+            }
+
+            m_Circuit.wires.push_back(m_Wire);
+            reportProgress();
+            return true;
+        }
+
+        inline bool Reader::parse_error(std::size_t, std::string const&, nlohmann::detail::exception const& ex)
+        {
+            return fail(ex.what());
+        }
+
+        inline auto Reader::finish() -> bool
+        {
+            if (!m_Error.empty())
+            {
+                return false;
+            }
+
+            // Wires may come before the components, so their ends can only be checked now
+            const auto  nodes = m_Circuit.nodeComponents.size();
+            auto const& wires = m_Circuit.wires;
+            auto        valid = Parallel::allOf(wires.size(), 1u << 16, [&](usize i)
+            {
+                return wires[i].from < nodes && wires[i].to < nodes;
+            });
+            return valid || fail("a wire refers to a node that doesn't exist");
+        }
+
+        inline auto Reader::error() const -> std::string const&
+        {
+            return m_Error;
+        }
+
+        inline auto Reader::fail(std::string message) -> bool
+        {
+            if (m_Error.empty())
+            {
+                m_Error = std::move(message);
+            }
+            return false;
+        }
+
+        inline auto Reader::number(f64 value) -> bool
+        {
+            if (m_Stack.empty())
+            {
+                return fail("unexpected number");
+            }
+
+            // Every component and wire takes well over a byte of the file, and no component has more than
+            // three nodes, so the counts can't honestly be more than that
+            const u64 fileSize = static_cast<u64>(std::max(m_FileSize, 0l));
+
+            switch (m_Stack.back())
+            {
+                case Where::Root:
+                    if (m_Key == "version" && !(value <= kVersion))
+                    {
+                        return fail(fmt::format("version {} isn't one this build understands", value));
+                    }
+
+                    // Reserve up front so the arrays don't grow past what they need
+                    if (m_Key == "componentCount")
+                    {
+                        if (const auto count = hint(value, fileSize))
+                        {
+                            m_Circuit.kinds.reserve(*count);
+                            m_Circuit.positions.reserve(*count);
+                            m_Circuit.facings.reserve(*count);
+                            m_Circuit.alive.reserve(*count);
+                            m_Circuit.firstNodes.reserve(*count);
+                        }
+                    }
+                    else if (m_Key == "nodeCount")
+                    {
+                        if (const auto count = hint(value, fileSize * 3))
+                        {
+                            m_Circuit.nodeComponents.reserve(*count);
+                            m_Circuit.nodeValues.reserve(*count);
+                        }
+                    }
+                    else if (m_Key == "wireCount")
+                    {
+                        if (const auto count = hint(value, fileSize))
+                        {
+                            m_Circuit.wires.reserve(*count);
+                        }
+                    }
+                    return true;
+
+                case Where::Component:
+                    if (m_Key == "x")
+                    {
+                        m_Position.x = value;
+                    }
+                    else if (m_Key == "y")
+                    {
+                        m_Position.y = value;
+                    }
+                    return true;
+
+                case Where::Wire:
+                    if (m_WireEnd >= 2 || !(value >= 0 && value < kInvalidNodeId) || value != std::floor(value))
+                    {
+                        return fail(fmt::format("bad wire {}", m_Circuit.wires.size()));
+                    }
+                    (m_WireEnd++ == 0 ? m_Wire.from : m_Wire.to) = static_cast<NodeId>(value);
+                    return true;
+
+                case Where::Skip:
+                    return true;
+
+                default:
+                    return fail("unexpected number");
+            }
+        }
+
+        inline auto Reader::hint(f64 value, u64 limit) -> std::optional<usize>
+        {
+            if (!(value >= 0 && value <= static_cast<f64>(limit)) || value != std::floor(value))
+            {
+                return std::nullopt;
+            }
+
+            return static_cast<usize>(value);
+        }
+
+        inline void Reader::reportProgress()
+        {
+            if (!m_Progress || ++m_Elements % (1u << 16) != 0 || m_FileSize <= 0)
+            {
+                return;
+            }
+
+            m_Progress(static_cast<f32>(std::ftell(m_File)) / m_FileSize);
+        }
+    } // namespace detail
+} // namespace CircuitJson
@@ -1,15 +1,25 @@
 #pragma once
 
+#include "config.h"
+#include "log.h"
+#include "profiler.h"
 #include "types.h"
 
 #include "simulation/circuit.h"
+#include "simulation/circuit_file.h"
+#include "simulation/circuit_json.h"
 #include "simulation/commands/command.h"
+#include "simulation/history.h"
+#include "simulation/sim_metrics.h"
 
 #include <atomic>
 #include <condition_variable>
+#include <functional>
 #include <memory>
 #include <mutex>
 #include <queue>
+#include <span>
+#include <string>
 #include <thread>
 
 class CircuitRunner
@@ -22,22 +32,63 @@ public:
     void stop();
     void step();
 
-    void sendCommand(std::unique_ptr<Command> command);
-    void sendCommands(std::vector<std::unique_ptr<Command>> commands);
+    // Commands name components by id, so each is sent with the generation of the circuit it was
+    // built against, and dropped if a load has replaced that circuit since
+    void sendCommand(std::unique_ptr<Command> command, u64 generation);
+    // Copies the commands onto the queue, so the originals can live in a per-frame arena.
+    // A command that can merge into the one queued before it does, so a burst of edits from
+    // one gesture is applied as a single command.
+    void sendCommands(std::span<Command* const> commands, u64 generation);
     auto circuit() -> Circuit&;
 
+    // Bumped each time a load replaces the circuit
+    auto generation() const -> u64;
+
+    // Caps the memory used by the undo/redo history
+    void setHistoryCapacity(usize capacity);
+
+    // Binary circuit files. Loading replaces the circuit and forgets the undo history.
+    auto saveCircuit(std::string const& path) -> bool;
+    auto loadCircuit(std::string const& path) -> bool;
+    auto saveCircuitJson(std::string const& path) -> bool;
+    // Safe to call off the UI thread. Parses and compiles into a circuit of its own, and only holds the lock to swap it in.
+    auto loadCircuitJson(std::string const& path, CircuitJson::ProgressFn const& progress = {}) -> bool;
+
+    // Holds off the simulation thread while the circuit is read from another thread
+    auto lock() -> std::unique_lock<std::mutex>;
+
+    // Called from the simulation thread whenever a step changed the circuit or any net's value
+    void setOnChanged(std::function<void()> onChanged);
+
+    // Throughput and contention counters, safe to read from any thread
+    auto metrics() const -> SimMetrics const&;
+
 private:
     void run();
 
+    // Drops every queued command and moves on to a new generation, for when the circuit they were built
+    // against is replaced. Called with the lock held.
+    void discardCommands();
+
+    // Takes the lock, adding any time spent waiting for it to the simulation or UI wait counter
+    auto timedLock(bool simulationThread) -> std::unique_lock<std::mutex>;
+
     std::unique_ptr<Circuit>             circuit_;
+    History                              history_;
     std::thread                          thread_;
     std::atomic<bool>                    running_ = false;
     std::queue<std::unique_ptr<Command>> commandQueue_;
+    std::atomic<u64>                     generation_ = 0;
     std::mutex                           mutex_;
+    std::condition_variable              wake_; // Signalled when there's work for an idle simulation thread
+    bool                                 settled_ = false;
+    std::function<void()>                onChanged_;
+    SimMetrics                           metrics_;
 };
 
 inline CircuitRunner::CircuitRunner()
 : circuit_(std::make_unique<Circuit>())
+, history_(Config::kHistoryCapacity)
 {
     start();
 }
@@ -65,7 +116,13 @@ inline void CircuitRunner::stop()
         return;
     }
 
-    running_ = false;
+    {
+        // Under the lock, so an idle simulation thread can't miss it between checking and waiting
+        std::unique_lock<std::mutex> lock(mutex_);
+        running_ = false;
+    }
+    wake_.notify_all();
+
     if (thread_.joinable())
     {
         thread_.join();
@@ -74,36 +131,97 @@ inline void CircuitRunner::stop()
 
 inline void CircuitRunner::step()
 {
-    std::unique_lock<std::mutex> lock(mutex_);
+    PROFILE_SCOPE("CircuitRunner::step");
+
+    auto lock = timedLock(true);
     {
-        while (!commandQueue_.empty())
+        const u64   revision      = circuit_->revision;
+        const u64   valueRevision = circuit_->valueRevision;
+        const usize commands      = commandQueue_.size();
+
+        if (commands > 0)
         {
-            auto commandPtr = std::move(commandQueue_.front());
-            commandQueue_.pop();
-            commandPtr->execute(*circuit_);
+            PROFILE_SCOPE("CircuitRunner::drainCommands");
+            while (!commandQueue_.empty())
+            {
+                auto commandPtr = std::move(commandQueue_.front());
+                commandQueue_.pop();
+
+                PROFILE_SCOPE("Command::apply");
+                commandPtr->apply(*circuit_, history_);
+            }
         }
 
-        circuit_->step();
+        if (commands > 0)
+        {
+            metrics_.addCommands(commands);
+            metrics_.setQueueDepth(0);
+            LOG_DEBUG_EVERY(Config::kLogIntervalMs, "CircuitRunner::step: applied {} commands, revision={}", commands, circuit_->revision.load());
+        }
+
+        {
+            PROFILE_SCOPE("Circuit::step");
+            const auto stats = circuit_->step();
+            metrics_.addStep(stats.events, stats.gateEvaluations, stats.worklist);
+            settled_ = circuit_->isSettled();
+        }
+
+        if ((circuit_->revision != revision || circuit_->valueRevision != valueRevision) && onChanged_)
+        {
+            onChanged_();
+        }
     }
 }
 
-inline void CircuitRunner::sendCommand(std::unique_ptr<Command> command)
+inline void CircuitRunner::sendCommand(std::unique_ptr<Command> command, u64 generation)
 {
     {
-        std::unique_lock<std::mutex> lock(mutex_);
+        auto lock = timedLock(false);
+        if (generation != generation_)
+        {
+            LOG_DEBUG("CircuitRunner::sendCommand: dropped a command for generation {}, the circuit is at {}", generation, generation_.load());
+            return;
+        }
+
         commandQueue_.push(std::move(command));
+        metrics_.setQueueDepth(commandQueue_.size());
     }
+    wake_.notify_one();
 }
 
-inline void CircuitRunner::sendCommands(std::vector<std::unique_ptr<Command>> commands)
+inline void CircuitRunner::sendCommands(std::span<Command* const> commands, u64 generation)
 {
+    if (commands.empty())
     {
-        std::unique_lock<std::mutex> lock(mutex_);
-        for (auto& command : commands)
+        return;
+    }
+
+    {
+        auto lock = timedLock(false);
+        if (generation != generation_)
         {
-            commandQueue_.push(std::move(command));
+            LOG_DEBUG("CircuitRunner::sendCommands: dropped {} commands for generation {}, the circuit is at {}", commands.size(), generation, generation_.load());
+            return;
         }
+
+        for (auto* command : commands)
+        {
+            if (!commandQueue_.empty() && commandQueue_.back()->mergeWith(*command))
+            {
+                continue;
+            }
+
+            commandQueue_.push(command->clone());
+        }
+        metrics_.setQueueDepth(commandQueue_.size());
     }
+    wake_.notify_one();
+}
+
+inline void CircuitRunner::setOnChanged(std::function<void()> onChanged)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    onChanged_ = std::move(onChanged);
 }
 
 inline auto CircuitRunner::circuit() -> Circuit&
@@ -112,10 +230,120 @@ inline auto CircuitRunner::circuit() -> Circuit&
     return *circuit_;
 }
 
+inline auto CircuitRunner::generation() const -> u64
+{
+    return generation_;
+}
+
+inline void CircuitRunner::setHistoryCapacity(usize capacity)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    history_.setCapacity(capacity);
+}
+
+inline auto CircuitRunner::saveCircuit(std::string const& path) -> bool
+{
+    auto lock = timedLock(false);
+    return CircuitFile::save(*circuit_, path);
+}
+
+inline auto CircuitRunner::loadCircuit(std::string const& path) -> bool
+{
+    // Map and validate before taking the lock, the simulation only stops for the copy
+    auto file = MappedCircuitFile::open(path);
+    if (!file)
+    {
+        return false;
+    }
+
+    {
+        auto lock = timedLock(false);
+        file->loadInto(*circuit_);
+        history_.clear();
+        discardCommands();
+    }
+    wake_.notify_one();
+    return true;
+}
+
+inline auto CircuitRunner::saveCircuitJson(std::string const& path) -> bool
+{
+    auto lock = timedLock(false);
+    return CircuitJson::save(*circuit_, path);
+}
+
+inline auto CircuitRunner::loadCircuitJson(std::string const& path, CircuitJson::ProgressFn const& progress) -> bool
+{
+    Circuit loaded;
+    if (!CircuitJson::load(path, loaded, progress))
+    {
+        return false;
+    }
+
+    // Compile here rather than on the simulation thread's next step, where it would hold the lock
+    loaded.netlist();
+
+    {
+        auto lock = timedLock(false);
+        circuit_->replaceWith(std::move(loaded));
+        history_.clear();
+        discardCommands();
+    }
+    wake_.notify_one();
+    return true;
+}
+
+inline auto CircuitRunner::lock() -> std::unique_lock<std::mutex>
+{
+    return timedLock(false);
+}
+
+inline auto CircuitRunner::metrics() const -> SimMetrics const&
+{
+    return metrics_;
+}
+
+inline void CircuitRunner::discardCommands()
+{
+    if (!commandQueue_.empty())
+    {
+        LOG_DEBUG("CircuitRunner::discardCommands: dropped {} queued commands", commandQueue_.size());
+    }
+
+    commandQueue_ = {};
+    metrics_.setQueueDepth(0);
+    ++generation_;
+}
+
+inline auto CircuitRunner::timedLock(bool simulationThread) -> std::unique_lock<std::mutex>
+{
+    // Only read the clock when there's actually a wait
+    std::unique_lock<std::mutex> lock(mutex_, std::try_to_lock);
+    if (!lock.owns_lock())
+    {
+        PROFILE_SCOPE("CircuitRunner::lockWait");
+        const auto waitStart = SimMetrics::Clock::now();
+        lock.lock();
+        const auto wait = SimMetrics::Clock::now() - waitStart;
+        simulationThread ? metrics_.addSimLockWait(wait) : metrics_.addUILockWait(wait);
+    }
+    return lock;
+}
+
 inline void CircuitRunner::run()
 {
+    Profiler::setThreadName("Simulation");
+
     while (running_)
     {
         step();
+
+        // A circuit with no clocks stops changing once it settles, so sleep until something is sent rather than spin
+        if (settled_)
+        {
+            PROFILE_SCOPE("CircuitRunner::idle");
+            std::unique_lock<std::mutex> lock(mutex_);
+            wake_.wait(lock, [this]() { return !running_ || !commandQueue_.empty() || !circuit_->isSettled(); });
+        }
     }
 }
@@ -2,27 +2,39 @@
 
 #include "simulation/circuit.h"
 #include "simulation/commands/command.h"
+#include "simulation/components/component_registry.h"
 
+#include <numeric>
+#include <vector>
+
+// Adds a single component, or a whole library prefab, depending on the type. A library prefab is
+// looked up before the command is queued, so the simulation never builds one while it holds its lock.
 class AddComponentCommand : public Command
 {
 public:
-    AddComponentCommand(f32 x, f32 y, std::string payload);
+    AddComponentCommand(f32 x, f32 y, ComponentType type, Prefab const* prefab = nullptr);
     ~AddComponentCommand();
 
     void execute(Circuit& circuit) override;
-    void undo(Circuit& circuit) override;
-    void redo(Circuit& circuit) override;
+    void record(History& history) const override;
+    auto clone() const -> std::unique_ptr<Command> override;
 
     // Members
-    f32         x;
-    f32         y;
-    std::string payload;
+    f32           x;
+    f32           y;
+    ComponentType type;
+    Prefab const* prefab; // From PrefabLibrary::find(), nullptr for primitives
+
+    // Set by execute()
+    std::vector<ComponentId> created;
+    std::vector<Wire>        createdWires;
 };
 
-inline AddComponentCommand::AddComponentCommand(f32 x, f32 y, std::string payload)
+inline AddComponentCommand::AddComponentCommand(f32 x, f32 y, ComponentType type, Prefab const* prefab)
 : x(x)
 , y(y)
-, payload(std::move(payload))
+, type(type)
+, prefab(prefab)
 {
 }
 
@@ -32,16 +44,30 @@ inline AddComponentCommand::~AddComponentCommand()
 
 inline void AddComponentCommand::execute(Circuit& circuit)
 {
-    if (payload == "NAND")
+    if (auto const& info = componentTypeInfo(type); info.isPrimitive())
     {
-        circuit.addNAND({ x, y });
+        created = { circuit.addComponent(*info.primitive, { x, y }) };
+    }
+    else if (prefab != nullptr)
+    {
+        const auto first = circuit.appendBlock(prefab->block, { x, y });
+
+        created.resize(prefab->block.componentCount());
+        std::iota(created.begin(), created.end(), first);
+        createdWires.assign(circuit.wires.end() - prefab->block.wires.size(), circuit.wires.end());
     }
 }
 
-inline void AddComponentCommand::undo(Circuit& circuit)
+inline void AddComponentCommand::record(History& history) const
 {
+    if (!created.empty())
+    {
+        history.recordAdd(created);
+        history.recordConnect(createdWires);
+    }
 }
 
-inline void AddComponentCommand::redo(Circuit& circuit)
+inline auto AddComponentCommand::clone() const -> std::unique_ptr<Command>
 {
+    return std::make_unique<AddComponentCommand>(*this);
 }
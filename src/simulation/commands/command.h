@@ -1,15 +1,54 @@
 #pragma once
 
 #include "simulation/circuit.h"
-#include "simulation/commands/command.h"
+#include "simulation/history.h"
 
-// A command is an operation on the circuit that can be executed, undone, and redone.
+#include <memory>
+
+// A command is an operation on the circuit. It's undone and redone through the History it records
+// itself into, never by the command.
 class Command
 {
 public:
     virtual ~Command() = default;
 
-    virtual void execute(Circuit& circuit) = 0;
-    virtual void undo(Circuit& circuit)    = 0;
-    virtual void redo(Circuit& circuit)    = 0;
+    // Makes the edit. Does nothing for commands that only override apply().
+    virtual void execute(Circuit& circuit);
+
+    // Runs the command from the simulation's queue: executes it, then records what it did.
+    // Overridden by commands that act on the history itself.
+    virtual void apply(Circuit& circuit, History& history);
+
+    // Appends the delta needed to undo/redo this command, after it has executed
+    virtual void record(History& history) const;
+
+    // Commands are built in the per-frame arena, anything that outlives the frame is copied out with this
+    virtual auto clone() const -> std::unique_ptr<Command> = 0;
+
+    // Folds next into this command if it's the same kind of edit within the same transaction,
+    // e.g. the stream of moves from one drag. Returns false if they have to stay separate.
+    virtual auto mergeWith(Command const& next) -> bool;
+
+    // Commands from one gesture share a transaction, 0 means the command stands alone
+    u64 transaction = 0;
 };
+
+inline void Command::apply(Circuit& circuit, History& history)
+{
+    execute(circuit);
+    history.begin(transaction);
+    record(history);
+}
+
+inline void Command::execute(Circuit&)
+{
+}
+
+inline void Command::record(History&) const
+{
+}
+
+inline auto Command::mergeWith(Command const&) -> bool
+{
+    return false;
+}
@@ -3,24 +3,53 @@
 #include "simulation/circuit.h"
 #include "simulation/commands/command.h"
 
+#include <typeinfo>
+#include <vector>
+
 class ConnectComponentsCommand : public Command
 {
 public:
+    explicit ConnectComponentsCommand(std::vector<Wire> wires);
+
     void execute(Circuit& circuit) override;
-    void undo(Circuit& circuit) override;
-    void redo(Circuit& circuit) override;
+    void record(History& history) const override;
+    auto clone() const -> std::unique_ptr<Command> override;
+    auto mergeWith(Command const& next) -> bool override;
 
     // Members
+    std::vector<Wire> wires;
 };
 
+inline ConnectComponentsCommand::ConnectComponentsCommand(std::vector<Wire> wires)
+: wires(std::move(wires))
+{
+}
+
 inline void ConnectComponentsCommand::execute(Circuit& circuit)
 {
+    circuit.connect(wires);
 }
 
-inline void ConnectComponentsCommand::undo(Circuit& circuit)
+inline void ConnectComponentsCommand::record(History& history) const
 {
+    history.recordConnect(wires);
 }
 
-inline void ConnectComponentsCommand::redo(Circuit& circuit)
+inline auto ConnectComponentsCommand::clone() const -> std::unique_ptr<Command>
 {
+    return std::make_unique<ConnectComponentsCommand>(*this);
+}
+
+// Wires connected within one gesture are applied as one batch
+inline auto ConnectComponentsCommand::mergeWith(Command const& next) -> bool
+{
+    // Exact type, subclasses like MassConnectCommand only know their wires once they've executed
+    auto const* other = typeid(next) == typeid(ConnectComponentsCommand) ? static_cast<ConnectComponentsCommand const*>(&next) : nullptr;
+    if (other == nullptr || transaction == 0 || other->transaction != transaction)
+    {
+        return false;
+    }
+
+    wires.insert(wires.end(), other->wires.begin(), other->wires.end());
+    return true;
 }
@@ -3,24 +3,54 @@
 #include "simulation/circuit.h"
 #include "simulation/commands/command.h"
 
+#include <vector>
+
 class DisconnectComponentCommand : public Command
 {
 public:
+    explicit DisconnectComponentCommand(std::vector<Wire> wires);
+
     void execute(Circuit& circuit) override;
-    void undo(Circuit& circuit) override;
-    void redo(Circuit& circuit) override;
+    void record(History& history) const override;
+    auto clone() const -> std::unique_ptr<Command> override;
+    auto mergeWith(Command const& next) -> bool override;
 
     // Members
+    std::vector<Wire> wires;
+
+    // Set by execute(), the wires that were actually there to remove
+    std::vector<Wire> removedWires;
 };
 
+inline DisconnectComponentCommand::DisconnectComponentCommand(std::vector<Wire> wires)
+: wires(std::move(wires))
+{
+}
+
 inline void DisconnectComponentCommand::execute(Circuit& circuit)
 {
+    removedWires = circuit.disconnect(wires);
 }
 
-inline void DisconnectComponentCommand::undo(Circuit& circuit)
+inline void DisconnectComponentCommand::record(History& history) const
 {
+    history.recordDisconnect(removedWires);
 }
 
-inline void DisconnectComponentCommand::redo(Circuit& circuit)
+inline auto DisconnectComponentCommand::clone() const -> std::unique_ptr<Command>
 {
+    return std::make_unique<DisconnectComponentCommand>(*this);
+}
+
+// Wires disconnected within one gesture are applied as one batch
+inline auto DisconnectComponentCommand::mergeWith(Command const& next) -> bool
+{
+    auto const* other = dynamic_cast<DisconnectComponentCommand const*>(&next);
+    if (other == nullptr || transaction == 0 || other->transaction != transaction)
+    {
+        return false;
+    }
+
+    wires.insert(wires.end(), other->wires.begin(), other->wires.end());
+    return true;
 }
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "simulation/circuit.h"
+#include "simulation/commands/command.h"
+
+#include <numeric>
+#include <vector>
+
+// Copies components, and the wires between them, offset by a translation.
+// The copy is taken as one relocatable block and appended to the circuit in one go.
+class DuplicateComponentsCommand : public Command
+{
+public:
+    DuplicateComponentsCommand(std::vector<ComponentId> ids, Delta offset);
+
+    void execute(Circuit& circuit) override;
+    void record(History& history) const override;
+    auto clone() const -> std::unique_ptr<Command> override;
+
+    // Members
+    std::vector<ComponentId> ids;
+    Delta                    offset;
+
+    // Set by execute()
+    std::vector<ComponentId> created;
+    std::vector<Wire>        createdWires;
+};
+
+inline DuplicateComponentsCommand::DuplicateComponentsCommand(std::vector<ComponentId> ids, Delta offset)
+: ids(std::move(ids))
+, offset(offset)
+{
+}
+
+inline void DuplicateComponentsCommand::execute(Circuit& circuit)
+{
+    const auto block = circuit.extractBlock(ids);
+    if (block.empty())
+    {
+        return;
+    }
+
+    const auto first = circuit.appendBlock(block, { block.origin.x + offset.dx, block.origin.y + offset.dy });
+
+    created.resize(block.componentCount());
+    std::iota(created.begin(), created.end(), first);
+    createdWires.assign(circuit.wires.end() - block.wires.size(), circuit.wires.end());
+}
+
+inline void DuplicateComponentsCommand::record(History& history) const
+{
+    if (!created.empty())
+    {
+        history.recordAdd(created);
+        history.recordConnect(createdWires);
+    }
+}
+
+inline auto DuplicateComponentsCommand::clone() const -> std::unique_ptr<Command>
+{
+    return std::make_unique<DuplicateComponentsCommand>(*this);
+}
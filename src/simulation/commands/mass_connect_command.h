@@ -0,0 +1,118 @@
+#pragma once
+
+#include "simulation/circuit.h"
+#include "simulation/commands/command.h"
+#include "simulation/commands/connect_components_command.h"
+
+#include <algorithm>
+#include <unordered_set>
+#include <vector>
+
+// Wires up a selection of NODEs left-to-right: the selection is split down the middle, each
+// half is ordered top to bottom, and the nth node on the left drives the nth node on the right.
+//
+//  (Left)   (Right)
+//  A0    ->  A1
+//  B0    ->  B1
+//  C0    ->  C1
+//
+// The pairs are worked out when it executes, from the circuit as it is then, and connected as
+// one batch, skipping pairs a wire already joins either way. After that it undoes and redoes like
+// any other connect.
+class MassConnectCommand : public ConnectComponentsCommand
+{
+public:
+    explicit MassConnectCommand(std::vector<ComponentId> ids);
+
+    void execute(Circuit& circuit) override;
+    auto clone() const -> std::unique_ptr<Command> override;
+    auto mergeWith(Command const& next) -> bool override;
+
+    // Members
+    std::vector<ComponentId> ids;
+};
+
+inline MassConnectCommand::MassConnectCommand(std::vector<ComponentId> ids)
+: ConnectComponentsCommand({})
+, ids(std::move(ids))
+{
+}
+
+inline void MassConnectCommand::execute(Circuit& circuit)
+{
+    struct Key final
+    {
+        f64    x;
+        f64    y;
+        NodeId node;
+    };
+
+    std::vector<Key> nodes;
+    nodes.reserve(ids.size());
+    for (auto id : ids)
+    {
+        if (circuit.alive[id] && circuit.kinds[id] == ComponentKind::Node)
+        {
+            nodes.push_back({ circuit.positions[id].x, circuit.positions[id].y, circuit.nodeOf(id, 0) });
+        }
+    }
+
+    // Split on x, then order each half by y (then x, so columns that aren't quite straight still pair up)
+    const auto half = nodes.size() / 2;
+    std::ranges::nth_element(nodes, nodes.begin() + half, {}, &Key::x);
+
+    const auto byRow = [](Key const& a, Key const& b)
+    {
+        return a.y != b.y ? a.y < b.y : a.x < b.x;
+    };
+    std::sort(nodes.begin(), nodes.begin() + half, byRow);
+    std::sort(nodes.end() - half, nodes.end(), byRow);
+
+    // With an odd count, the middle node is left out
+    const auto key = [](NodeId a, NodeId b)
+    {
+        return static_cast<u64>(std::min(a, b)) << 32 | std::max(a, b);
+    };
+
+    std::unordered_set<u64> pairs;
+    pairs.reserve(half);
+    for (usize i = 0; i < half; ++i)
+    {
+        pairs.insert(key(nodes[i].node, nodes[nodes.size() - half + i].node));
+    }
+
+    // Connecting a pair twice would only add a second copy of its wire
+    std::unordered_set<u64> connected;
+    for (auto const& wire : circuit.wires)
+    {
+        if (pairs.contains(key(wire.from, wire.to)))
+        {
+            connected.insert(key(wire.from, wire.to));
+        }
+    }
+
+    wires.clear();
+    wires.reserve(half - connected.size());
+    for (usize i = 0; i < half; ++i)
+    {
+        const auto from = nodes[i].node;
+        const auto to   = nodes[nodes.size() - half + i].node;
+        if (!connected.contains(key(from, to)))
+        {
+            wires.push_back({ from, to });
+        }
+    }
+
+    ConnectComponentsCommand::execute(circuit);
+}
+
+inline auto MassConnectCommand::clone() const -> std::unique_ptr<Command>
+{
+    return std::make_unique<MassConnectCommand>(*this);
+}
+
+// The wires don't exist until it executes, so there's nothing to merge
+inline auto MassConnectCommand::mergeWith(Command const&) -> bool
+{
+    return false;
+}
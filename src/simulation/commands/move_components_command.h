@@ -6,21 +6,49 @@
 class MoveComponentsCommand : public Command
 {
 public:
+    MoveComponentsCommand(ComponentSet ids, Delta delta);
+
     void execute(Circuit& circuit) override;
-    void undo(Circuit& circuit) override;
-    void redo(Circuit& circuit) override;
+    void record(History& history) const override;
+    auto clone() const -> std::unique_ptr<Command> override;
+    auto mergeWith(Command const& next) -> bool override;
 
     // Members
+    ComponentSet ids; // Shared by every move in a drag, so a frame's move doesn't copy them
+    Delta        delta;
 };
 
+inline MoveComponentsCommand::MoveComponentsCommand(ComponentSet ids, Delta delta)
+: ids(std::move(ids))
+, delta(delta)
+{
+}
+
 inline void MoveComponentsCommand::execute(Circuit& circuit)
 {
+    circuit.moveComponents(*ids, delta);
 }
 
-inline void MoveComponentsCommand::undo(Circuit& circuit)
+inline void MoveComponentsCommand::record(History& history) const
 {
+    history.recordMove(*ids, delta);
 }
 
-inline void MoveComponentsCommand::redo(Circuit& circuit)
+inline auto MoveComponentsCommand::clone() const -> std::unique_ptr<Command>
 {
+    return std::make_unique<MoveComponentsCommand>(*this);
+}
+
+// A gesture drags the same components throughout, so its moves are one move by the sum of the deltas
+inline auto MoveComponentsCommand::mergeWith(Command const& next) -> bool
+{
+    auto const* move = dynamic_cast<MoveComponentsCommand const*>(&next);
+    if (move == nullptr || transaction == 0 || move->transaction != transaction)
+    {
+        return false;
+    }
+
+    delta.dx += move->delta.dx;
+    delta.dy += move->delta.dy;
+    return true;
 }
@@ -0,0 +1,23 @@
+#pragma once
+
+#include "simulation/circuit.h"
+#include "simulation/commands/command.h"
+
+// Steps the history forward one entry. It goes through the command queue so it's
+// ordered with the edits sent before it.
+class RedoCommand : public Command
+{
+public:
+    void apply(Circuit& circuit, History& history) override;
+    auto clone() const -> std::unique_ptr<Command> override;
+};
+
+inline void RedoCommand::apply(Circuit& circuit, History& history)
+{
+    history.redo(circuit);
+}
+
+inline auto RedoCommand::clone() const -> std::unique_ptr<Command>
+{
+    return std::make_unique<RedoCommand>(*this);
+}
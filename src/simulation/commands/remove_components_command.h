@@ -3,24 +3,53 @@
 #include "simulation/circuit.h"
 #include "simulation/commands/command.h"
 
+#include <vector>
+
 class RemoveComponentsCommand : public Command
 {
 public:
+    explicit RemoveComponentsCommand(std::vector<ComponentId> ids);
+
     void execute(Circuit& circuit) override;
-    void undo(Circuit& circuit) override;
-    void redo(Circuit& circuit) override;
+    void record(History& history) const override;
+    auto clone() const -> std::unique_ptr<Command> override;
+    auto mergeWith(Command const& next) -> bool override;
 
     // Members
+    std::vector<ComponentId> ids;
+
+    // Set by execute(), the wires that went with the components
+    std::vector<Wire> removedWires;
 };
 
+inline RemoveComponentsCommand::RemoveComponentsCommand(std::vector<ComponentId> ids)
+: ids(std::move(ids))
+{
+}
+
 inline void RemoveComponentsCommand::execute(Circuit& circuit)
 {
+    removedWires = circuit.removeComponents(ids);
 }
 
-inline void RemoveComponentsCommand::undo(Circuit& circuit)
+inline void RemoveComponentsCommand::record(History& history) const
 {
+    history.recordRemove(ids, removedWires);
 }
 
-inline void RemoveComponentsCommand::redo(Circuit& circuit)
+inline auto RemoveComponentsCommand::clone() const -> std::unique_ptr<Command>
 {
+    return std::make_unique<RemoveComponentsCommand>(*this);
+}
+
+inline auto RemoveComponentsCommand::mergeWith(Command const& next) -> bool
+{
+    auto const* other = dynamic_cast<RemoveComponentsCommand const*>(&next);
+    if (other == nullptr || transaction == 0 || other->transaction != transaction)
+    {
+        return false;
+    }
+
+    ids.insert(ids.end(), other->ids.begin(), other->ids.end());
+    return true;
 }
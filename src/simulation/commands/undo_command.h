@@ -0,0 +1,23 @@
+#pragma once
+
+#include "simulation/circuit.h"
+#include "simulation/commands/command.h"
+
+// Steps the history back one entry. It goes through the command queue so it's
+// ordered with the edits sent before it.
+class UndoCommand : public Command
+{
+public:
+    void apply(Circuit& circuit, History& history) override;
+    auto clone() const -> std::unique_ptr<Command> override;
+};
+
+inline void UndoCommand::apply(Circuit& circuit, History& history)
+{
+    history.undo(circuit);
+}
+
+inline auto UndoCommand::clone() const -> std::unique_ptr<Command>
+{
+    return std::make_unique<UndoCommand>(*this);
+}
@@ -1,6 +1,73 @@
 #pragma once
 
-struct Component
+#include "types.h"
+
+#include <algorithm>
+#include <array>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Components are referred to by their index into Circuit's component arrays.
+// Ids are never reused, removed components are left behind as tombstones.
+using ComponentId = u32;
+
+constexpr ComponentId kInvalidComponentId = ~0u;
+
+// A sorted set of components that's shared rather than copied, like the selection handed from the UI to
+// a command every drag frame. It never changes once made, a new selection is a new set.
+using ComponentSet = std::shared_ptr<std::vector<ComponentId> const>;
+
+inline auto makeComponentSet(std::vector<ComponentId> ids) -> ComponentSet
+{
+    std::ranges::sort(ids);
+    return std::make_shared<std::vector<ComponentId> const>(std::move(ids));
+}
+
+enum class ComponentKind : u8
+{
+    NAND,
+    Node,
+    Clock,
+};
+
+inline auto toString(ComponentKind kind) -> std::string
 {
-    virtual ~Component() = default;
+    switch (kind)
+    {
+        case ComponentKind::NAND:
+            return "NAND";
+        case ComponentKind::Node:
+            return "Node";
+        case ComponentKind::Clock:
+            return "Clock";
+    }
+
+    return "Unknown";
+}
+
+// Where a pin sits in its component's unit box, drawn facing right
+struct PinLayout final
+{
+    f32 x;
+    f32 y;
+};
+
+struct ComponentInfo final
+{
+    Size                     size;
+    u32                      nodeCount;
+    std::array<PinLayout, 3> pins;
+};
+
+// NAND pins are: input A, input B, output
+constexpr std::array<ComponentInfo, 3> kComponentInfos = {
+    ComponentInfo{ { 100.0, 100.0 }, 3, { PinLayout{ 0.0f, 0.3f }, PinLayout{ 0.0f, 0.7f }, PinLayout{ 1.0f, 0.5f } } },
+    ComponentInfo{ { 20.0, 20.0 }, 1, { PinLayout{ 0.5f, 0.5f } } },
+    ComponentInfo{ { 50.0, 50.0 }, 1, { PinLayout{ 1.0f, 0.5f } } },
 };
+
+constexpr auto componentInfo(ComponentKind kind) -> ComponentInfo const&
+{
+    return kComponentInfos[static_cast<usize>(kind)];
+}
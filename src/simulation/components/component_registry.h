@@ -0,0 +1,1050 @@
+#pragma once
+
+#include "profiler.h"
+#include "types.h"
+
+#include "simulation/components/component.h"
+#include "simulation/prefab_builder.h"
+#include "simulation/prefab_cache.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <exception>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// Everything that can be placed on the canvas: the primitive components the simulation runs,
+// and the README library components built out of them. The left panel, the command layer and
+// serialization all refer to components by ComponentType, and only ever turn names into types
+// through findComponentType().
+enum class ComponentType : u16
+{
+    // Primitives
+    NAND,
+    Node,
+    Clock,
+
+    // Chapter 1
+    NOT,
+    AND,
+    OR,
+    XOR,
+    MUX,
+    DMUX,
+    NOT16,
+    AND16,
+    OR16,
+    MUX16,
+    OR8WAY,
+    MUX4WAY16,
+    MUX8WAY16,
+    DMUX4WAY,
+    DMUX8WAY,
+
+    // Chapter 2
+    HALFADDER,
+    FULLADDER,
+    ADD16,
+    INC16,
+
+    // Chapter 3
+    DFF,
+    BIT,
+    REGISTER,
+    RAM8,
+    RAM64,
+    RAM512,
+    RAM4K,
+
+    Count,
+};
+
+constexpr usize kComponentTypeCount = static_cast<usize>(ComponentType::Count);
+
+// Library prefabs, built from the registry's factories on first use and kept for the rest of
+// the run. Built prefabs are also kept on disk by PrefabCache, so later runs load them instead.
+// Thread-safe.
+class PrefabLibrary final
+{
+public:
+    static auto get() -> PrefabLibrary&;
+
+    // nullptr for primitives
+    auto find(ComponentType type) -> Prefab const*;
+
+    // Builds a library component from its factory, skipping the disk cache, to check cached copies against
+    auto rebuild(ComponentType type) -> Prefab;
+
+    // Starts loading or building type on a background thread if it isn't ready yet, so the find()
+    // that places it doesn't wait as long. Does nothing while another warm() is still going.
+    void warm(ComponentType type);
+
+private:
+    friend class PrefabParts;
+
+    PrefabLibrary() = default;
+    ~PrefabLibrary();
+
+    // The prefab for type, building it if need be. Needs m_Mutex held.
+    auto require(ComponentType type) -> Prefab const&;
+
+    // From the disk cache if it has it, otherwise from the factory, caching the result
+    auto build(ComponentType type) -> std::unique_ptr<Prefab>;
+
+    // A factory that's running, and whether it has required anything its recipe doesn't list
+    struct Building final
+    {
+        ComponentType type;
+        bool          undeclared = false;
+    };
+
+    std::recursive_mutex                                     m_Mutex;
+    std::array<std::unique_ptr<Prefab>, kComponentTypeCount> m_Prefabs;
+    std::array<std::atomic<bool>, kComponentTypeCount>       m_Ready = {}; // m_Prefabs[type] is set, readable without the lock
+    std::vector<Building>                                    m_Building;   // Innermost last
+
+    std::thread       m_Warmer;
+    std::atomic<bool> m_Warming = false;
+};
+
+// What a factory sees of the library: the prefabs it's made of. Only the library makes one, while it
+// holds its lock, so nothing else can reach require() without it.
+class PrefabParts final
+{
+public:
+    auto require(ComponentType type) -> Prefab const&;
+
+private:
+    friend class PrefabLibrary;
+
+    explicit PrefabParts(PrefabLibrary& library);
+
+    PrefabLibrary& m_Library;
+};
+
+namespace detail
+{
+    // Builds a prefab, with any prefabs it's made of coming from the library
+    using PrefabFactory = auto (*)(PrefabParts& parts) -> Prefab;
+
+    inline auto buildGate(ComponentType type) -> Prefab;
+    inline auto buildBitwise(Prefab const& gate, usize width) -> Prefab;
+    inline auto buildMux16(PrefabParts& parts) -> Prefab;
+    inline auto buildOr8Way(PrefabParts& parts) -> Prefab;
+    inline auto buildMuxWay16(PrefabParts& parts, usize bits) -> Prefab;
+    inline auto buildDMuxWay(PrefabParts& parts, usize bits) -> Prefab;
+    inline auto buildHalfAdder(PrefabParts& parts) -> Prefab;
+    inline auto buildFullAdder(PrefabParts& parts) -> Prefab;
+    inline auto buildAdd16(PrefabParts& parts) -> Prefab;
+    inline auto buildInc16(PrefabParts& parts) -> Prefab;
+    inline auto buildDFF(PrefabParts& parts) -> Prefab;
+    inline auto buildBit(PrefabParts& parts) -> Prefab;
+    inline auto buildRegister(PrefabParts& parts) -> Prefab;
+    inline auto buildRAM(PrefabParts& parts, ComponentType inner, usize innerAddressBits) -> Prefab;
+} // namespace detail
+
+// Where a type's pins sit in its unit box, drawn facing right. Primitives place each pin themselves
+// (ComponentInfo::pins). A library component's pins are its input and output NODEs, which PrefabBuilder
+// stacks down its left and right edges in pin order.
+struct PortLayout final
+{
+    u32                        inputs;
+    u32                        outputs;
+    std::span<PinLayout const> pins = {}; // Primitives only
+
+    constexpr auto pin(u32 index) const -> PinLayout;
+};
+
+constexpr auto PortLayout::pin(u32 index) const -> PinLayout
+{
+    // A NODE's one pin is both its input and its output
+    if (!pins.empty())
+    {
+        return pins[std::min<usize>(index, pins.size() - 1)];
+    }
+
+    return index < inputs ? PinLayout{ 0.0f, (index + 1.0f) / (inputs + 1.0f) } : PinLayout{ 1.0f, (index - inputs + 1.0f) / (outputs + 1.0f) };
+}
+
+struct ComponentTypeInfo final
+{
+    std::string_view             name; // Also the label in the left panel, and the name in saved files
+    std::optional<ComponentKind> primitive;
+    detail::PrefabFactory        factory; // Library components only
+    PortLayout                   ports;
+    Size                         size; // Default footprint, primitives only. A library component is as big as its built prefab.
+
+    constexpr auto isPrimitive() const -> bool
+    {
+        return primitive.has_value();
+    }
+};
+
+namespace detail
+{
+    constexpr auto primitive(std::string_view name, ComponentKind kind, u32 inputs, u32 outputs) -> ComponentTypeInfo
+    {
+        auto const& info = componentInfo(kind);
+        return { name, kind, nullptr, { inputs, outputs, std::span<PinLayout const>(info.pins.data(), info.nodeCount) }, info.size };
+    }
+
+    constexpr auto library(std::string_view name, PrefabFactory factory, u32 inputs, u32 outputs) -> ComponentTypeInfo
+    {
+        return { name, std::nullopt, factory, { inputs, outputs }, { 0.0, 0.0 } };
+    }
+} // namespace detail
+
+constexpr std::array<ComponentTypeInfo, kComponentTypeCount> kComponentTypes = {
+    detail::primitive("NAND", ComponentKind::NAND, 2, 1),
+    detail::primitive("NODE", ComponentKind::Node, 1, 1),
+    detail::primitive("CLK", ComponentKind::Clock, 0, 1),
+
+    detail::library("NOT", [](PrefabParts&) { return detail::buildGate(ComponentType::NOT); }, 1, 1),
+    detail::library("AND", [](PrefabParts&) { return detail::buildGate(ComponentType::AND); }, 2, 1),
+    detail::library("OR", [](PrefabParts&) { return detail::buildGate(ComponentType::OR); }, 2, 1),
+    detail::library("XOR", [](PrefabParts&) { return detail::buildGate(ComponentType::XOR); }, 2, 1),
+    detail::library("MUX", [](PrefabParts&) { return detail::buildGate(ComponentType::MUX); }, 3, 1),
+    detail::library("DMUX", [](PrefabParts&) { return detail::buildGate(ComponentType::DMUX); }, 2, 2),
+    detail::library("NOT16", [](PrefabParts& parts) { return detail::buildBitwise(parts.require(ComponentType::NOT), 16); }, 16, 16),
+    detail::library("AND16", [](PrefabParts& parts) { return detail::buildBitwise(parts.require(ComponentType::AND), 16); }, 32, 16),
+    detail::library("OR16", [](PrefabParts& parts) { return detail::buildBitwise(parts.require(ComponentType::OR), 16); }, 32, 16),
+    detail::library("MUX16", detail::buildMux16, 33, 16),
+    detail::library("OR8WAY", detail::buildOr8Way, 8, 1),
+    detail::library("MUX4WAY16", [](PrefabParts& parts) { return detail::buildMuxWay16(parts, 2); }, 66, 16),
+    detail::library("MUX8WAY16", [](PrefabParts& parts) { return detail::buildMuxWay16(parts, 3); }, 131, 16),
+    detail::library("DMUX4WAY", [](PrefabParts& parts) { return detail::buildDMuxWay(parts, 2); }, 3, 4),
+    detail::library("DMUX8WAY", [](PrefabParts& parts) { return detail::buildDMuxWay(parts, 3); }, 4, 8),
+
+    detail::library("HALFADDER", detail::buildHalfAdder, 2, 2),
+    detail::library("FULLADDER", detail::buildFullAdder, 3, 2),
+    detail::library("ADD16", detail::buildAdd16, 32, 16),
+    detail::library("INC16", detail::buildInc16, 16, 16),
+
+    detail::library("DFF", detail::buildDFF, 2, 1),
+    detail::library("BIT", detail::buildBit, 3, 1),
+    detail::library("REGISTER", detail::buildRegister, 18, 16),
+    detail::library("RAM8", [](PrefabParts& parts) { return detail::buildRAM(parts, ComponentType::REGISTER, 0); }, 21, 16),
+    detail::library("RAM64", [](PrefabParts& parts) { return detail::buildRAM(parts, ComponentType::RAM8, 3); }, 24, 16),
+    detail::library("RAM512", [](PrefabParts& parts) { return detail::buildRAM(parts, ComponentType::RAM64, 6); }, 27, 16),
+    detail::library("RAM4K", [](PrefabParts& parts) { return detail::buildRAM(parts, ComponentType::RAM512, 9); }, 30, 16),
+};
+
+constexpr auto componentTypeInfo(ComponentType type) -> ComponentTypeInfo const&
+{
+    return kComponentTypes[static_cast<usize>(type)];
+}
+
+// What a library component's factory places, for the prefab cache's keys. Bump a component's revision
+// whenever its factory changes; everything built from it then gets a new key as well. The key can't see
+// the factory's code, so a missed bump keeps loading the old copy; prefab_cache_test catches that.
+struct PrefabRecipe final
+{
+    constexpr PrefabRecipe(u32 revision, std::initializer_list<ComponentType> uses);
+
+    constexpr auto usesType(ComponentType type) const -> bool;
+
+    // private:
+    u32                          revision;
+    std::array<ComponentType, 3> uses     = {};
+    u32                          useCount = 0;
+};
+
+constexpr PrefabRecipe::PrefabRecipe(u32 revision, std::initializer_list<ComponentType> uses)
+: revision(revision)
+{
+    for (auto type : uses)
+    {
+        this->uses[useCount++] = type;
+    }
+}
+
+constexpr auto PrefabRecipe::usesType(ComponentType type) const -> bool
+{
+    return std::find(uses.begin(), uses.begin() + useCount, type) != uses.begin() + useCount;
+}
+
+constexpr auto prefabRecipe(ComponentType type) -> PrefabRecipe
+{
+    switch (type)
+    {
+        case ComponentType::NOT16:
+            return { 1, { ComponentType::NOT } };
+        case ComponentType::AND16:
+            return { 1, { ComponentType::AND } };
+        case ComponentType::OR16:
+        case ComponentType::OR8WAY:
+            return { 1, { ComponentType::OR } };
+        case ComponentType::MUX16:
+            return { 1, { ComponentType::MUX } };
+        case ComponentType::MUX4WAY16:
+        case ComponentType::MUX8WAY16:
+            return { 1, { ComponentType::MUX16 } };
+        case ComponentType::DMUX4WAY:
+        case ComponentType::DMUX8WAY:
+            return { 1, { ComponentType::DMUX } };
+        case ComponentType::HALFADDER:
+            return { 1, { ComponentType::XOR, ComponentType::AND } };
+        case ComponentType::FULLADDER:
+            return { 1, { ComponentType::HALFADDER, ComponentType::OR } };
+        case ComponentType::ADD16:
+            return { 1, { ComponentType::HALFADDER, ComponentType::FULLADDER } };
+        case ComponentType::INC16:
+            return { 1, { ComponentType::NOT, ComponentType::HALFADDER } };
+        case ComponentType::BIT:
+            return { 1, { ComponentType::MUX, ComponentType::DFF } };
+        case ComponentType::REGISTER:
+            return { 1, { ComponentType::BIT } };
+        case ComponentType::RAM8:
+            return { 1, { ComponentType::DMUX8WAY, ComponentType::REGISTER, ComponentType::MUX8WAY16 } };
+        case ComponentType::RAM64:
+            return { 1, { ComponentType::DMUX8WAY, ComponentType::RAM8, ComponentType::MUX8WAY16 } };
+        case ComponentType::RAM512:
+            return { 1, { ComponentType::DMUX8WAY, ComponentType::RAM64, ComponentType::MUX8WAY16 } };
+        case ComponentType::RAM4K:
+            return { 1, { ComponentType::DMUX8WAY, ComponentType::RAM512, ComponentType::MUX8WAY16 } };
+        default:
+            return { 1, {} };
+    }
+}
+
+// The prefab cache's key for a library component: a hash of its name, pins and recipe, and of the keys of
+// everything in the recipe, so a change anywhere below a component changes its key too. Cached blocks
+// are read back raw, so the block layout and the numbering of the primitive kinds are hashed in as well.
+constexpr auto prefabKey(ComponentType type) -> u64
+{
+    // FNV-1a over each value's bytes
+    u64  hash = 14695981039346656037ull;
+    auto mix  = [&](u64 value, usize bytes)
+    {
+        for (usize i = 0; i < bytes; ++i)
+        {
+            hash = (hash ^ ((value >> (i * 8)) & 0xff)) * 1099511628211ull;
+        }
+    };
+
+    auto const& info   = componentTypeInfo(type);
+    const auto  recipe = prefabRecipe(type);
+
+    mix(PrefabBuilder::kRevision, 4);
+    mix(CircuitBlock::kLayoutVersion, 4);
+    for (auto const& entry : kComponentTypes)
+    {
+        if (entry.primitive)
+        {
+            mix(static_cast<u8>(*entry.primitive), 1);
+            for (char c : entry.name)
+            {
+                mix(static_cast<u8>(c), 1);
+            }
+        }
+    }
+
+    for (char c : info.name)
+    {
+        mix(static_cast<u8>(c), 1);
+    }
+    mix(info.ports.inputs, 4);
+    mix(info.ports.outputs, 4);
+    mix(recipe.revision, 4);
+    for (u32 i = 0; i < recipe.useCount; ++i)
+    {
+        mix(prefabKey(recipe.uses[i]), 8);
+    }
+
+    return hash;
+}
+
+static_assert(prefabKey(ComponentType::RAM8) != prefabKey(ComponentType::RAM64));
+
+namespace detail
+{
+    constexpr auto hashName(std::string_view name, u32 seed) -> u32
+    {
+        // FNV-1a, then a final mix so the seed reaches the low bits used to pick a slot
+        u32 hash = 2166136261u ^ seed;
+        for (char c : name)
+        {
+            hash = (hash ^ static_cast<u8>(c)) * 16777619u;
+        }
+
+        hash ^= hash >> 16;
+        hash *= 0x7feb352du;
+        hash ^= hash >> 15;
+
+        return hash;
+    }
+
+    constexpr usize kNameTableSize = std::bit_ceil(kComponentTypeCount * 4);
+
+    struct NameTable final
+    {
+        u32                             seed  = 0;
+        std::array<u16, kNameTableSize> slots = {};
+    };
+
+    // Searches for a seed that puts every name in its own slot
+    constexpr auto buildNameTable() -> NameTable
+    {
+        for (u32 seed = 0;; ++seed)
+        {
+            NameTable table{ seed, {} };
+            table.slots.fill(static_cast<u16>(ComponentType::Count));
+
+            bool collided = false;
+            for (usize type = 0; type < kComponentTypeCount && !collided; ++type)
+            {
+                auto& slot = table.slots[hashName(kComponentTypes[type].name, seed) & (kNameTableSize - 1)];
+                collided   = slot != static_cast<u16>(ComponentType::Count);
+                slot       = static_cast<u16>(type);
+            }
+
+            if (!collided)
+            {
+                return table;
+            }
+        }
+    }
+
+    constexpr NameTable kNameTable = buildNameTable();
+} // namespace detail
+
+// Perfect hash from name to type. The one compare at the end only rejects names that aren't in the registry.
+constexpr auto findComponentType(std::string_view name) -> std::optional<ComponentType>
+{
+    const auto slot = detail::kNameTable.slots[detail::hashName(name, detail::kNameTable.seed) & (detail::kNameTableSize - 1)];
+    if (slot == static_cast<u16>(ComponentType::Count) || kComponentTypes[slot].name != name)
+    {
+        return std::nullopt;
+    }
+
+    return static_cast<ComponentType>(slot);
+}
+
+static_assert(findComponentType("RAM64") == ComponentType::RAM64);
+static_assert(findComponentType("NODE") == ComponentType::Node);
+static_assert(!findComponentType("RAM16K"));
+
+inline auto toString(ComponentType type) -> std::string
+{
+    return std::string(componentTypeInfo(type).name);
+}
+
+// The registry entry for a primitive kind
+constexpr auto componentType(ComponentKind kind) -> ComponentType
+{
+    for (usize type = 0; type < kComponentTypeCount; ++type)
+    {
+        if (kComponentTypes[type].primitive == kind)
+        {
+            return static_cast<ComponentType>(type);
+        }
+    }
+
+    return ComponentType::Count;
+}
+
+// The name a primitive kind is saved under, its registry name
+constexpr auto kindName(ComponentKind kind) -> std::string_view
+{
+    return componentTypeInfo(componentType(kind)).name;
+}
+
+// The primitive kind with a registry name, if there is one
+constexpr auto findComponentKind(std::string_view name) -> std::optional<ComponentKind>
+{
+    const auto type = findComponentType(name);
+    return type ? componentTypeInfo(*type).primitive : std::nullopt;
+}
+
+static_assert(kindName(ComponentKind::Clock) == "CLK");
+static_assert(findComponentKind("NODE") == ComponentKind::Node);
+static_assert(!findComponentKind("RAM8"));
+
+inline auto PrefabLibrary::get() -> PrefabLibrary&
+{
+    static PrefabLibrary library;
+    return library;
+}
+
+inline PrefabLibrary::~PrefabLibrary()
+{
+    if (m_Warmer.joinable())
+    {
+        m_Warmer.join();
+    }
+}
+
+inline auto PrefabLibrary::find(ComponentType type) -> Prefab const*
+{
+    if (componentTypeInfo(type).isPrimitive())
+    {
+        return nullptr;
+    }
+
+    std::lock_guard<std::recursive_mutex> lock(m_Mutex);
+    return &require(type);
+}
+
+inline auto PrefabLibrary::require(ComponentType type) -> Prefab const&
+{
+    if (!m_Building.empty() && !prefabRecipe(m_Building.back().type).usesType(type))
+    {
+        m_Building.back().undeclared = true;
+    }
+
+    auto& prefab = m_Prefabs[static_cast<usize>(type)];
+    if (!prefab)
+    {
+        prefab = build(type);
+        m_Ready[static_cast<usize>(type)] = true;
+    }
+
+    return *prefab;
+}
+
+inline auto PrefabLibrary::rebuild(ComponentType type) -> Prefab
+{
+    std::lock_guard<std::recursive_mutex> lock(m_Mutex);
+    PrefabParts                           parts(*this);
+    return componentTypeInfo(type).factory(parts);
+}
+
+inline PrefabParts::PrefabParts(PrefabLibrary& library)
+: m_Library(library)
+{
+}
+
+inline auto PrefabParts::require(ComponentType type) -> Prefab const&
+{
+    return m_Library.require(type);
+}
+
+inline void PrefabLibrary::warm(ComponentType type)
+{
+    if (componentTypeInfo(type).isPrimitive() || m_Ready[static_cast<usize>(type)] || m_Warming.exchange(true))
+    {
+        return;
+    }
+
+    // The last one has finished, it cleared m_Warming on its way out
+    if (m_Warmer.joinable())
+    {
+        m_Warmer.join();
+    }
+
+    m_Warmer = std::thread([this, type]()
+    {
+        Profiler::setThreadName("Prefab warmer");
+
+        // Nothing may escape the thread. If it fails here, the find() that places it will try again.
+        try
+        {
+            find(type);
+        }
+        catch (std::exception const& e)
+        {
+            spdlog::error("Could not warm prefab {}: {}", componentTypeInfo(type).name, e.what());
+        }
+        m_Warming = false;
+    });
+}
+
+inline auto PrefabLibrary::build(ComponentType type) -> std::unique_ptr<Prefab>
+{
+    const auto name = componentTypeInfo(type).name;
+    const auto key  = prefabKey(type);
+    if (auto cached = PrefabCache::load(key))
+    {
+        spdlog::debug("Loaded prefab {} from the cache", name);
+        return std::make_unique<Prefab>(std::move(*cached));
+    }
+
+    m_Building.push_back({ type });
+    PrefabParts parts(*this);
+    auto        prefab     = std::make_unique<Prefab>(componentTypeInfo(type).factory(parts));
+    const bool  undeclared = m_Building.back().undeclared;
+    m_Building.pop_back();
+
+    // The key wouldn't change along with whatever's missing from the recipe, so a cached copy could go stale
+    if (undeclared)
+    {
+        spdlog::warn("Prefab {} uses components its recipe doesn't list, not caching it", name);
+    }
+    else if (!PrefabCache::store(key, *prefab))
+    {
+        spdlog::warn("Could not write prefab {} to the cache", name);
+    }
+
+    return prefab;
+}
+
+namespace detail
+{
+    // Pins are, in order: NOT in, AND/OR/XOR a, b, MUX a, b, sel, DMUX in, sel
+    inline auto buildGate(ComponentType type) -> Prefab
+    {
+        PrefabBuilder builder;
+
+        switch (type)
+        {
+            case ComponentType::NOT:
+            {
+                const auto in = builder.input();
+                builder.column();
+                const auto out = builder.nand(in, in);
+                builder.column();
+                builder.output(out);
+                break;
+            }
+            case ComponentType::AND:
+            {
+                const auto a = builder.input();
+                const auto b = builder.input();
+                builder.column();
+                const auto n = builder.nand(a, b);
+                builder.column();
+                const auto out = builder.nand(n, n);
+                builder.column();
+                builder.output(out);
+                break;
+            }
+            case ComponentType::OR:
+            {
+                const auto a = builder.input();
+                const auto b = builder.input();
+                builder.column();
+                const auto notA = builder.nand(a, a);
+                const auto notB = builder.nand(b, b);
+                builder.column();
+                const auto out = builder.nand(notA, notB);
+                builder.column();
+                builder.output(out);
+                break;
+            }
+            case ComponentType::XOR:
+            {
+                const auto a = builder.input();
+                const auto b = builder.input();
+                builder.column();
+                const auto n = builder.nand(a, b);
+                builder.column();
+                const auto x = builder.nand(a, n);
+                const auto y = builder.nand(b, n);
+                builder.column();
+                const auto out = builder.nand(x, y);
+                builder.column();
+                builder.output(out);
+                break;
+            }
+            case ComponentType::MUX:
+            {
+                const auto a   = builder.input();
+                const auto b   = builder.input();
+                const auto sel = builder.input();
+                builder.column();
+                const auto notSel = builder.nand(sel, sel);
+                builder.column();
+                const auto x = builder.nand(a, notSel);
+                const auto y = builder.nand(b, sel);
+                builder.column();
+                const auto out = builder.nand(x, y);
+                builder.column();
+                builder.output(out);
+                break;
+            }
+            case ComponentType::DMUX:
+            {
+                const auto in  = builder.input();
+                const auto sel = builder.input();
+                builder.column();
+                const auto notSel = builder.nand(sel, sel);
+                builder.column();
+                const auto x = builder.nand(in, notSel);
+                const auto y = builder.nand(in, sel);
+                builder.column();
+                const auto a = builder.nand(x, x);
+                const auto b = builder.nand(y, y);
+                builder.column();
+                builder.output(a);
+                builder.output(b);
+                break;
+            }
+            default:
+                break;
+        }
+
+        return builder.build();
+    }
+
+    // width copies of gate, with input pin p of copy i wired from input p * width + i
+    inline auto buildBitwise(Prefab const& gate, usize width) -> Prefab
+    {
+        PrefabBuilder builder;
+
+        std::vector<std::vector<NodeId>> inputs(gate.inputs.size());
+        for (auto& pin : inputs)
+        {
+            for (usize bit = 0; bit < width; ++bit)
+            {
+                pin.push_back(builder.input());
+            }
+            builder.column();
+        }
+
+        std::vector<NodeId> outputs;
+        for (usize bit = 0; bit < width; ++bit)
+        {
+            std::vector<NodeId> gateInputs;
+            for (auto const& pin : inputs)
+            {
+                gateInputs.push_back(pin[bit]);
+            }
+            outputs.push_back(builder.place(gate, gateInputs)[0]);
+        }
+
+        builder.column();
+        for (auto node : outputs)
+        {
+            builder.output(node);
+        }
+
+        return builder.build();
+    }
+
+    // a[16], b[16], sel
+    inline auto buildMux16(PrefabParts& parts) -> Prefab
+    {
+        PrefabBuilder builder;
+
+        std::array<NodeId, 16> a;
+        std::array<NodeId, 16> b;
+        std::ranges::generate(a, [&] { return builder.input(); });
+        builder.column();
+        std::ranges::generate(b, [&] { return builder.input(); });
+        builder.column();
+        const auto sel = builder.input();
+        builder.column();
+
+        std::array<NodeId, 16> out;
+        for (usize bit = 0; bit < 16; ++bit)
+        {
+            out[bit] = builder.place(parts.require(ComponentType::MUX), { a[bit], b[bit], sel })[0];
+        }
+
+        builder.column();
+        std::ranges::for_each(out, [&](NodeId node) { builder.output(node); });
+
+        return builder.build();
+    }
+
+    inline auto buildOr8Way(PrefabParts& parts) -> Prefab
+    {
+        PrefabBuilder builder;
+
+        std::vector<NodeId> level(8);
+        std::ranges::generate(level, [&] { return builder.input(); });
+
+        while (level.size() > 1)
+        {
+            builder.column();
+            std::vector<NodeId> next;
+            for (usize i = 0; i < level.size(); i += 2)
+            {
+                next.push_back(builder.place(parts.require(ComponentType::OR), { level[i], level[i + 1] })[0]);
+            }
+            level = std::move(next);
+        }
+
+        builder.column();
+        builder.output(level[0]);
+
+        return builder.build();
+    }
+
+    // 2^bits x in[16], then sel[bits], least significant bit first
+    inline auto buildMuxWay16(PrefabParts& parts, usize bits) -> Prefab
+    {
+        PrefabBuilder builder;
+
+        std::vector<std::vector<NodeId>> level(usize(1) << bits, std::vector<NodeId>(16));
+        for (auto& in : level)
+        {
+            std::ranges::generate(in, [&] { return builder.input(); });
+            builder.column();
+        }
+
+        std::vector<NodeId> sel(bits);
+        std::ranges::generate(sel, [&] { return builder.input(); });
+
+        for (usize bit = 0; bit < bits; ++bit)
+        {
+            builder.column();
+            std::vector<std::vector<NodeId>> next;
+            for (usize i = 0; i < level.size(); i += 2)
+            {
+                std::vector<NodeId> inputs = level[i];
+                inputs.insert(inputs.end(), level[i + 1].begin(), level[i + 1].end());
+                inputs.push_back(sel[bit]);
+                next.push_back(builder.place(parts.require(ComponentType::MUX16), inputs));
+            }
+            level = std::move(next);
+        }
+
+        builder.column();
+        std::ranges::for_each(level[0], [&](NodeId node) { builder.output(node); });
+
+        return builder.build();
+    }
+
+    // in, then sel[bits], least significant bit first
+    inline auto buildDMuxWay(PrefabParts& parts, usize bits) -> Prefab
+    {
+        PrefabBuilder builder;
+
+        std::vector<NodeId> level = { builder.input() };
+        std::vector<NodeId> sel(bits);
+        std::ranges::generate(sel, [&] { return builder.input(); });
+
+        for (usize bit = bits; bit-- > 0;)
+        {
+            builder.column();
+            std::vector<NodeId> next;
+            for (auto in : level)
+            {
+                const auto outs = builder.place(parts.require(ComponentType::DMUX), { in, sel[bit] });
+                next.insert(next.end(), outs.begin(), outs.end());
+            }
+            level = std::move(next);
+        }
+
+        builder.column();
+        std::ranges::for_each(level, [&](NodeId node) { builder.output(node); });
+
+        return builder.build();
+    }
+
+    // a, b -> sum, carry
+    inline auto buildHalfAdder(PrefabParts& parts) -> Prefab
+    {
+        PrefabBuilder builder;
+
+        const auto a = builder.input();
+        const auto b = builder.input();
+        builder.column();
+        const auto sum   = builder.place(parts.require(ComponentType::XOR), { a, b })[0];
+        const auto carry = builder.place(parts.require(ComponentType::AND), { a, b })[0];
+        builder.column();
+        builder.output(sum);
+        builder.output(carry);
+
+        return builder.build();
+    }
+
+    // a, b, c -> sum, carry
+    inline auto buildFullAdder(PrefabParts& parts) -> Prefab
+    {
+        PrefabBuilder builder;
+
+        const auto a = builder.input();
+        const auto b = builder.input();
+        const auto c = builder.input();
+        builder.column();
+        const auto first = builder.place(parts.require(ComponentType::HALFADDER), { a, b });
+        builder.column();
+        const auto second = builder.place(parts.require(ComponentType::HALFADDER), { first[0], c });
+        builder.column();
+        const auto carry = builder.place(parts.require(ComponentType::OR), { first[1], second[1] })[0];
+        builder.column();
+        builder.output(second[0]);
+        builder.output(carry);
+
+        return builder.build();
+    }
+
+    // a[16], b[16], least significant bit first
+    inline auto buildAdd16(PrefabParts& parts) -> Prefab
+    {
+        PrefabBuilder builder;
+
+        std::array<NodeId, 16> a;
+        std::array<NodeId, 16> b;
+        std::ranges::generate(a, [&] { return builder.input(); });
+        builder.column();
+        std::ranges::generate(b, [&] { return builder.input(); });
+        builder.column();
+
+        std::array<NodeId, 16> out;
+        const auto bit0  = builder.place(parts.require(ComponentType::HALFADDER), { a[0], b[0] });
+        out[0]           = bit0[0];
+        auto       carry = bit0[1];
+        for (usize bit = 1; bit < 16; ++bit)
+        {
+            const auto sum = builder.place(parts.require(ComponentType::FULLADDER), { a[bit], b[bit], carry });
+            out[bit]       = sum[0];
+            carry          = sum[1];
+        }
+
+        builder.column();
+        std::ranges::for_each(out, [&](NodeId node) { builder.output(node); });
+
+        return builder.build();
+    }
+
+    inline auto buildInc16(PrefabParts& parts) -> Prefab
+    {
+        PrefabBuilder builder;
+
+        std::array<NodeId, 16> in;
+        std::ranges::generate(in, [&] { return builder.input(); });
+        builder.column();
+
+        // Adding 1 flips bit 0 and carries it up through half adders
+        std::array<NodeId, 16> out;
+        out[0]     = builder.place(parts.require(ComponentType::NOT), { in[0] })[0];
+        auto carry = in[0];
+        for (usize bit = 1; bit < 16; ++bit)
+        {
+            const auto sum = builder.place(parts.require(ComponentType::HALFADDER), { in[bit], carry });
+            out[bit]       = sum[0];
+            carry          = sum[1];
+        }
+
+        builder.column();
+        std::ranges::for_each(out, [&](NodeId node) { builder.output(node); });
+
+        return builder.build();
+    }
+
+    // in, clk. A master-slave pair of gated D latches: the master follows in while clk is low,
+    // the slave copies the master while clk is high, so out changes on the rising edge.
+    inline auto buildDFF(PrefabParts&) -> Prefab
+    {
+        PrefabBuilder builder;
+
+        const auto in  = builder.input();
+        const auto clk = builder.input();
+        builder.column();
+
+        const auto latch = [&](NodeId d, NodeId enable) -> NodeId
+        {
+            const auto notD = builder.nand(d, d);
+            const auto set  = builder.nand(d, enable);
+            const auto rst  = builder.nand(notD, enable);
+            const auto q    = builder.nand(set, kInvalidNodeId);
+            const auto notQ = builder.nand(rst, q);
+            builder.wire(notQ, builder.nandInput(q, 1));
+            return q;
+        };
+
+        const auto notClk = builder.nand(clk, clk);
+        builder.column();
+        const auto master = latch(in, notClk);
+        builder.column();
+        const auto slave = latch(master, clk);
+        builder.column();
+        builder.output(slave);
+
+        return builder.build();
+    }
+
+    // in, load, clk
+    inline auto buildBit(PrefabParts& parts) -> Prefab
+    {
+        PrefabBuilder builder;
+
+        const auto in   = builder.input();
+        const auto load = builder.input();
+        const auto clk  = builder.input();
+        builder.column();
+
+        // The mux's first input is fed back from the flip-flop once it exists.
+        // Placed nodes keep their offsets, so it's found relative to the mux's output.
+        auto const& muxPrefab = parts.require(ComponentType::MUX);
+        const auto  mux       = builder.place(muxPrefab, { kInvalidNodeId, in, load });
+        const auto  feedback  = mux[0] - muxPrefab.outputs[0] + muxPrefab.inputs[0];
+        builder.column();
+        const auto out = builder.place(parts.require(ComponentType::DFF), { mux[0], clk })[0];
+        builder.wire(out, feedback);
+        builder.column();
+        builder.output(out);
+
+        return builder.build();
+    }
+
+    // in[16], load, clk
+    inline auto buildRegister(PrefabParts& parts) -> Prefab
+    {
+        PrefabBuilder builder;
+
+        std::array<NodeId, 16> in;
+        std::ranges::generate(in, [&] { return builder.input(); });
+        builder.column();
+        const auto load = builder.input();
+        const auto clk  = builder.input();
+        builder.column();
+
+        std::array<NodeId, 16> out;
+        for (usize bit = 0; bit < 16; ++bit)
+        {
+            out[bit] = builder.place(parts.require(ComponentType::BIT), { in[bit], load, clk })[0];
+        }
+
+        builder.column();
+        std::ranges::for_each(out, [&](NodeId node) { builder.output(node); });
+
+        return builder.build();
+    }
+
+    // Eight of inner, selected by the top three address bits.
+    // Pins are in[16], load, address[innerAddressBits + 3] least significant bit first, clk.
+    inline auto buildRAM(PrefabParts& parts, ComponentType inner, usize innerAddressBits) -> Prefab
+    {
+        PrefabBuilder builder;
+
+        std::vector<NodeId> in(16);
+        std::ranges::generate(in, [&] { return builder.input(); });
+        builder.column();
+
+        const auto          load = builder.input();
+        std::vector<NodeId> address(innerAddressBits + 3);
+        std::ranges::generate(address, [&] { return builder.input(); });
+        const auto clk = builder.input();
+        builder.column();
+
+        const auto select = std::span(address).subspan(innerAddressBits);
+
+        std::vector<NodeId> loadInputs = { load };
+        loadInputs.insert(loadInputs.end(), select.begin(), select.end());
+        const auto loads = builder.place(parts.require(ComponentType::DMUX8WAY), loadInputs);
+        builder.column();
+
+        std::vector<NodeId> muxInputs;
+        for (auto bankLoad : loads)
+        {
+            std::vector<NodeId> bankInputs = in;
+            bankInputs.push_back(bankLoad);
+            bankInputs.insert(bankInputs.end(), address.begin(), address.begin() + innerAddressBits);
+            bankInputs.push_back(clk);
+
+            const auto out = builder.place(parts.require(inner), bankInputs);
+            muxInputs.insert(muxInputs.end(), out.begin(), out.end());
+        }
+        builder.column();
+
+        muxInputs.insert(muxInputs.end(), select.begin(), select.end());
+        const auto out = builder.place(parts.require(ComponentType::MUX8WAY16), muxInputs);
+        builder.column();
+        std::ranges::for_each(out, [&](NodeId node) { builder.output(node); });
+
+        return builder.build();
+    }
+} // namespace detail
@@ -1,8 +0,0 @@
-#pragma once
-
-#include "simulation/components/component.h"
-
-struct CompositeComponent : public Component
-{
-    virtual ~CompositeComponent() = default;
-};
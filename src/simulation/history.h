@@ -0,0 +1,357 @@
+#pragma once
+
+#include "types.h"
+
+#include "simulation/circuit.h"
+
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <ranges>
+#include <span>
+#include <vector>
+
+// Undo/redo history, stored as compact deltas packed back to back in one byte buffer.
+//
+// Each entry is one undoable step (e.g. a whole drag) made of one or more records. A record is
+// a fixed header followed by its component ids and wires, so undoing a 100k component edit is
+// a single pass over a contiguous array rather than 100k separate objects.
+//
+// Once the buffer grows past its capacity, the oldest entries are dropped.
+class History final
+{
+public:
+    enum class EditKind : u8
+    {
+        Add,
+        Remove,
+        Move,
+        Connect,
+        Disconnect,
+    };
+
+    explicit History(usize capacity);
+
+    // Starts a new entry, unless transaction is non-zero and matches the entry being recorded
+    void begin(u64 transaction);
+
+    void recordAdd(std::span<ComponentId const> ids);
+    void recordRemove(std::span<ComponentId const> ids, std::span<Wire const> wires);
+    void recordMove(std::span<ComponentId const> ids, Delta delta);
+    void recordConnect(std::span<Wire const> wires);
+    void recordDisconnect(std::span<Wire const> wires);
+
+    // Return false if there was nothing to undo/redo
+    auto undo(Circuit& circuit) -> bool;
+    auto redo(Circuit& circuit) -> bool;
+
+    void clear();
+    void setCapacity(usize capacity);
+
+    auto bytes() const -> usize;
+    auto capacity() const -> usize;
+    auto undoCount() const -> usize;
+    auto redoCount() const -> usize;
+
+private:
+    struct Header final
+    {
+        EditKind kind;
+        u32      idCount;
+        u32      wireCount;
+        u32      size; // Of the whole record, including this header and padding
+        Delta    delta;
+    };
+
+    struct Entry final
+    {
+        usize offset; // Into m_Buffer
+        usize size;
+        u64   transaction;
+    };
+
+    struct Record final
+    {
+        Header                       header;
+        std::span<ComponentId const> ids;
+        std::span<Wire const>        wires;
+    };
+
+    void openEntry();
+    void record(EditKind kind, std::span<ComponentId const> ids, std::span<Wire const> wires, Delta delta);
+    auto readRecord(usize offset) const -> Record;
+    void evict();
+
+    static constexpr usize kAlignment = alignof(Header);
+
+    std::vector<std::byte> m_Buffer;
+    usize                  m_Start    = 0; // Bytes before this belong to evicted entries
+    usize                  m_Capacity = 0;
+
+    std::deque<Entry> m_Entries;
+    usize             m_Cursor      = 0; // Entries before this are applied, the rest can be redone
+    bool              m_EntryOpen   = false;
+    u64               m_Transaction = 0; // Of the next entry to open
+    usize             m_LastRecord  = 0; // Offset of the newest record in the open entry
+};
+
+inline History::History(usize capacity)
+: m_Capacity(capacity)
+{
+}
+
+inline void History::begin(u64 transaction)
+{
+    if (m_EntryOpen && transaction != 0 && m_Cursor == m_Entries.size() && m_Entries.back().transaction == transaction)
+    {
+        return;
+    }
+
+    // The entry itself is only created by the first record, so edits that record nothing don't leave empty steps
+    m_EntryOpen   = false;
+    m_Transaction = transaction;
+}
+
+inline void History::recordAdd(std::span<ComponentId const> ids)
+{
+    record(EditKind::Add, ids, {}, {});
+}
+
+inline void History::recordRemove(std::span<ComponentId const> ids, std::span<Wire const> wires)
+{
+    record(EditKind::Remove, ids, wires, {});
+}
+
+inline void History::recordMove(std::span<ComponentId const> ids, Delta delta)
+{
+    // A drag arrives as a stream of small moves of the same components, fold them into one
+    if (m_EntryOpen && m_Entries.back().size > 0)
+    {
+        auto last = readRecord(m_LastRecord);
+        if (last.header.kind == EditKind::Move && std::ranges::equal(last.ids, ids))
+        {
+            last.header.delta.dx += delta.dx;
+            last.header.delta.dy += delta.dy;
+            std::memcpy(m_Buffer.data() + m_LastRecord, &last.header, sizeof(Header));
+            return;
+        }
+    }
+
+    record(EditKind::Move, ids, {}, delta);
+}
+
+inline void History::recordConnect(std::span<Wire const> wires)
+{
+    if (wires.empty())
+    {
+        return;
+    }
+
+    record(EditKind::Connect, {}, wires, {});
+}
+
+inline void History::recordDisconnect(std::span<Wire const> wires)
+{
+    if (wires.empty())
+    {
+        return;
+    }
+
+    record(EditKind::Disconnect, {}, wires, {});
+}
+
+inline auto History::undo(Circuit& circuit) -> bool
+{
+    if (m_Cursor == 0)
+    {
+        return false;
+    }
+
+    m_EntryOpen       = false;
+    auto const& entry = m_Entries[--m_Cursor];
+
+    // Records can only be walked forwards, so find them all first and undo them newest first
+    std::vector<usize> offsets;
+    for (usize offset = entry.offset; offset < entry.offset + entry.size; offset += readRecord(offset).header.size)
+    {
+        offsets.push_back(offset);
+    }
+
+    for (auto offset : offsets | std::views::reverse)
+    {
+        const auto record = readRecord(offset);
+        switch (record.header.kind)
+        {
+            case EditKind::Add:
+                circuit.removeComponents(record.ids);
+                break;
+            case EditKind::Remove:
+                circuit.restoreComponents(record.ids);
+                circuit.connect(record.wires);
+                break;
+            case EditKind::Move:
+                circuit.moveComponents(record.ids, { -record.header.delta.dx, -record.header.delta.dy });
+                break;
+            case EditKind::Connect:
+                circuit.disconnect(record.wires);
+                break;
+            case EditKind::Disconnect:
+                circuit.connect(record.wires);
+                break;
+        }
+    }
+
+    return true;
+}
+
+inline auto History::redo(Circuit& circuit) -> bool
+{
+    if (m_Cursor == m_Entries.size())
+    {
+        return false;
+    }
+
+    m_EntryOpen       = false;
+    auto const& entry = m_Entries[m_Cursor++];
+
+    for (usize offset = entry.offset; offset < entry.offset + entry.size;)
+    {
+        const auto record = readRecord(offset);
+        switch (record.header.kind)
+        {
+            case EditKind::Add:
+                circuit.restoreComponents(record.ids);
+                break;
+            case EditKind::Remove:
+                circuit.removeComponents(record.ids);
+                break;
+            case EditKind::Move:
+                circuit.moveComponents(record.ids, record.header.delta);
+                break;
+            case EditKind::Connect:
+                circuit.connect(record.wires);
+                break;
+            case EditKind::Disconnect:
+                circuit.disconnect(record.wires);
+                break;
+        }
+
+        offset += record.header.size;
+    }
+
+    return true;
+}
+
+inline void History::clear()
+{
+    m_Buffer.clear();
+    m_Entries.clear();
+    m_Start     = 0;
+    m_Cursor    = 0;
+    m_EntryOpen = false;
+}
+
+inline void History::setCapacity(usize capacity)
+{
+    m_Capacity = capacity;
+    evict();
+}
+
+inline auto History::bytes() const -> usize
+{
+    return m_Buffer.size() - m_Start;
+}
+
+inline auto History::capacity() const -> usize
+{
+    return m_Capacity;
+}
+
+inline auto History::undoCount() const -> usize
+{
+    return m_Cursor;
+}
+
+inline auto History::redoCount() const -> usize
+{
+    return m_Entries.size() - m_Cursor;
+}
+
+inline void History::openEntry()
+{
+    // A new edit makes anything undone unreachable
+    if (m_Cursor < m_Entries.size())
+    {
+        m_Buffer.resize(m_Entries[m_Cursor].offset);
+        m_Entries.erase(m_Entries.begin() + m_Cursor, m_Entries.end());
+    }
+
+    m_Entries.push_back({ m_Buffer.size(), 0, m_Transaction });
+    m_Cursor    = m_Entries.size();
+    m_EntryOpen = true;
+}
+
+inline void History::record(EditKind kind, std::span<ComponentId const> ids, std::span<Wire const> wires, Delta delta)
+{
+    if (!m_EntryOpen)
+    {
+        openEntry();
+    }
+
+    const usize payload = ids.size_bytes() + wires.size_bytes();
+    const usize size    = (sizeof(Header) + payload + kAlignment - 1) / kAlignment * kAlignment;
+
+    const Header header = { kind, static_cast<u32>(ids.size()), static_cast<u32>(wires.size()), static_cast<u32>(size), delta };
+
+    const usize offset = m_Buffer.size();
+    m_Buffer.resize(offset + size);
+
+    auto* out = m_Buffer.data() + offset;
+    std::memcpy(out, &header, sizeof(Header));
+    std::memcpy(out + sizeof(Header), ids.data(), ids.size_bytes());
+    std::memcpy(out + sizeof(Header) + ids.size_bytes(), wires.data(), wires.size_bytes());
+
+    m_Entries.back().size += size;
+    m_LastRecord = offset;
+
+    evict();
+}
+
+inline auto History::readRecord(usize offset) const -> Record
+{
+    Record record;
+    std::memcpy(&record.header, m_Buffer.data() + offset, sizeof(Header));
+
+    // Records are padded to kAlignment, which is enough for the ids and wires after the header
+    auto const* ids   = reinterpret_cast<ComponentId const*>(m_Buffer.data() + offset + sizeof(Header));
+    auto const* wires = reinterpret_cast<Wire const*>(ids + record.header.idCount);
+    record.ids        = { ids, record.header.idCount };
+    record.wires      = { wires, record.header.wireCount };
+
+    return record;
+}
+
+// Drops the oldest entries until we're back under capacity. The newest entry is always kept,
+// even if it's bigger than the whole budget on its own, and entries waiting to be redone are
+// never dropped from under the cursor.
+inline void History::evict()
+{
+    while (bytes() > m_Capacity && m_Entries.size() > 1 && m_Cursor > 0)
+    {
+        m_Start += m_Entries.front().size;
+        m_Entries.pop_front();
+        --m_Cursor;
+    }
+
+    // Reclaim the dead space at the front once it's most of the buffer
+    if (m_Start > 0 && m_Start >= m_Buffer.size() / 2)
+    {
+        m_Buffer.erase(m_Buffer.begin(), m_Buffer.begin() + m_Start);
+        for (auto& entry : m_Entries)
+        {
+            entry.offset -= m_Start;
+        }
+        m_LastRecord -= std::min(m_LastRecord, m_Start);
+        m_Start = 0;
+    }
+}
@@ -0,0 +1,729 @@
+#pragma once
+
+#include "parallel.h"
+#include "profiler.h"
+#include "types.h"
+
+#include "simulation/components/component.h"
+#include "simulation/node.h"
+#include "simulation/wire.h"
+
+#include <algorithm>
+#include <atomic>
+#include <numeric>
+#include <span>
+#include <vector>
+
+// Topology changes since a netlist was last brought up to date, recorded by Circuit's edits so the
+// netlist can be patched instead of rebuilt. Components appended since then aren't listed, they're
+// everything from the id the netlist was last built or patched up to.
+struct NetlistEdits final
+{
+    std::vector<Wire>        addedWires; // In the order they were appended to the circuit's wires
+    std::vector<Wire>        removedWires;
+    std::vector<ComponentId> touched; // Components that were removed or restored
+
+    auto size() const -> usize;
+    void clear();
+};
+
+inline auto NetlistEdits::size() const -> usize
+{
+    return addedWires.size() + removedWires.size() + touched.size();
+}
+
+inline void NetlistEdits::clear()
+{
+    addedWires.clear();
+    removedWires.clear();
+    touched.clear();
+}
+
+// The circuit's connectivity flattened into the lookup tables the simulation needs each step.
+// Everything is CSR-style: xStarts[node]..xStarts[node + 1] indexes x.
+//
+// Nodes joined by wires are one net and always carry the same value, so the simulation keeps one value
+// per net, at its root: the net's lowest node. A chain of wired-up nodes costs no more to simulate than
+// one node. Nets are found with union-find, and readers are listed under the root of the net they read.
+//
+// build() makes one from scratch, split across cores for big circuits. patch() brings one up to date
+// after a few edits, only rewriting the tables from the first node an edit touches and only redoing the
+// nets an edit touches. It gives the same tables build() would, bar the order of netNext's rings and of
+// each node's fanout: a wire removed and added back keeps its old place, where build() would list it last.
+struct Netlist final
+{
+    std::vector<u32>    fanoutStarts;
+    std::vector<NodeId> fanout; // Nodes each node is wired to, which is what nets are made from
+
+    std::vector<u32>         readerStarts;
+    std::vector<ComponentId> readers; // NAND gates reading each net, under its root
+
+    std::vector<ComponentId> gates;  // Every live NAND gate
+    std::vector<NodeId>      clocks; // Every live clock's output node
+
+    std::vector<NodeId> nets;    // Each node's net, by its root
+    std::vector<NodeId> netNext; // A ring through each net's nodes, so a net can be walked when it splits
+
+    void build(std::span<ComponentKind const> kinds,
+               std::span<u8 const>            alive,
+               std::span<NodeId const>        firstNodes,
+               std::span<ComponentId const>   nodeComponents,
+               std::span<Wire const>          wires);
+
+    // Applies edits made since this was built for components [0, firstNewComponent). Edits that cancel
+    // out, a wire added then removed, are dropped from edits.addedWires, leaving the wires that are new.
+    //
+    // values holds each net's value at its root and is kept that way: nets that merge take the value of
+    // the side driving the wire that joined them, and nets that split keep theirs. The roots of nets an
+    // edit touched are appended to changedNets, as their readers may now see a different value.
+    void patch(std::span<ComponentKind const> kinds,
+               std::span<u8 const>            alive,
+               std::span<NodeId const>        firstNodes,
+               std::span<ComponentId const>   nodeComponents,
+               NetlistEdits&                  edits,
+               ComponentId                    firstNewComponent,
+               std::span<u8>                  values,
+               std::vector<NodeId>&           changedNets);
+
+    // Rebuilds netNext from nets
+    void linkNets();
+
+private:
+    // A value to add to or remove from one node's entries in a table
+    struct Entry final
+    {
+        u32 key;
+        u32 value;
+    };
+
+    // Removes then inserts entries in one CSR table, rewriting it from the first key touched. Inserts go
+    // after a key's existing entries, or in value order if sorted is set. Both lists are sorted by key here.
+    void patchTable(std::vector<u32>& starts, std::vector<u32>& values, std::vector<Entry>& removes, std::vector<Entry>& inserts, bool sorted);
+
+    // Removes and inserts ids in a sorted list
+    static void patchSorted(std::vector<u32>& values, std::vector<u32>& removes, std::vector<u32> const& inserts);
+
+    // Union-find with parents as node ids. A set's root is its lowest node, so the nets that come out
+    // don't depend on the order wires were added in, and every parent is below its children.
+    static auto findRoot(std::span<NodeId> parents, NodeId node) -> NodeId;
+    static void unite(std::span<NodeId> parents, NodeId a, NodeId b);
+
+    // The same, safe to call from several threads at once on the same parents. A root is only ever
+    // pointed at a lower one, by compare-and-swap, so the sets and their roots come out as they would
+    // serially whatever order the threads get to the wires in.
+    static auto findRootShared(std::span<NodeId> parents, NodeId node) -> NodeId;
+    static void uniteShared(std::span<NodeId> parents, NodeId a, NodeId b);
+
+    // Adds node to its root's ring, for nodes visited in ascending order
+    void linkNet(NodeId node);
+
+    // Below this, a pass isn't worth splitting across threads
+    static constexpr usize kMinChunk = 1u << 16;
+
+    // A shared unite costs over three times a serial one, so nets are only split with at least this many chunks
+    static constexpr usize kMinUniteChunks = 4;
+
+    // Buckets indices [0, count) by keyOf(index): starts[key]..starts[key + 1] indexes order, which
+    // holds the indices ascending within each key. starts must be zeroed and order sized to count.
+    template <typename KeyOf>
+    static void countingSort(usize count, std::vector<u32>& starts, std::vector<u32>& order, KeyOf&& keyOf);
+
+    // Kept between patches so they don't allocate each time
+    std::vector<u32> patchTail_;
+    std::vector<u32> patchSegment_;
+};
+
+inline void Netlist::build(std::span<ComponentKind const> kinds,
+                           std::span<u8 const>            alive,
+                           std::span<NodeId const>        firstNodes,
+                           std::span<ComponentId const>   nodeComponents,
+                           std::span<Wire const>          wires)
+{
+    PROFILE_SCOPE("Netlist::build");
+
+    const usize nodeCount = nodeComponents.size();
+
+    // Live gates and clocks, counted per chunk first so each chunk knows where its share goes
+    const usize      componentChunks = Parallel::chunkCount(kinds.size(), kMinChunk);
+    std::vector<u32> gateOffsets(componentChunks + 1, 0);
+    std::vector<u32> clockOffsets(componentChunks + 1, 0);
+    Parallel::forChunks(kinds.size(), kMinChunk, [&](usize chunk, usize begin, usize end)
+    {
+        u32 chunkGates  = 0;
+        u32 chunkClocks = 0;
+        for (ComponentId id = begin; id < end; ++id)
+        {
+            chunkGates += alive[id] && kinds[id] == ComponentKind::NAND;
+            chunkClocks += alive[id] && kinds[id] == ComponentKind::Clock;
+        }
+        gateOffsets[chunk + 1]  = chunkGates;
+        clockOffsets[chunk + 1] = chunkClocks;
+    });
+    std::partial_sum(gateOffsets.begin(), gateOffsets.end(), gateOffsets.begin());
+    std::partial_sum(clockOffsets.begin(), clockOffsets.end(), clockOffsets.begin());
+
+    gates.resize(gateOffsets.back());
+    clocks.resize(clockOffsets.back());
+    Parallel::forChunks(kinds.size(), kMinChunk, [&](usize chunk, usize begin, usize end)
+    {
+        u32 gate  = gateOffsets[chunk];
+        u32 clock = clockOffsets[chunk];
+        for (ComponentId id = begin; id < end; ++id)
+        {
+            if (!alive[id])
+            {
+                continue;
+            }
+
+            if (kinds[id] == ComponentKind::NAND)
+            {
+                gates[gate++] = id;
+            }
+            else if (kinds[id] == ComponentKind::Clock)
+            {
+                clocks[clock++] = firstNodes[id];
+            }
+        }
+    });
+
+    // Counting sort of the wires by the node driving them
+    fanoutStarts.assign(nodeCount + 1, 0);
+    fanout.resize(wires.size());
+    countingSort(wires.size(), fanoutStarts, fanout, [&](u32 i)
+    {
+        return wires[i].from;
+    });
+
+    // fanout holds wire indices so far, in wire order within each node
+    Parallel::forChunks(fanout.size(), kMinChunk, [&](usize, usize begin, usize end)
+    {
+        for (usize i = begin; i < end; ++i)
+        {
+            fanout[i] = wires[fanout[i]].to;
+        }
+    });
+
+    // Nets, with each chunk of wires united concurrently, then every node pointed straight at its root
+    nets.resize(nodeCount);
+    std::iota(nets.begin(), nets.end(), NodeId{ 0 });
+    if (Parallel::chunkCount(wires.size(), kMinChunk) >= kMinUniteChunks)
+    {
+        Parallel::forChunks(wires.size(), kMinChunk, [&](usize, usize begin, usize end)
+        {
+            for (usize i = begin; i < end; ++i)
+            {
+                uniteShared(nets, wires[i].from, wires[i].to);
+            }
+        });
+
+        Parallel::forChunks(nodeCount, kMinChunk, [&](usize, usize begin, usize end)
+        {
+            for (NodeId node = begin; node < end; ++node)
+            {
+                std::atomic_ref(nets[node]).store(findRootShared(nets, node), std::memory_order_relaxed);
+            }
+        });
+    }
+    else
+    {
+        for (auto const& wire : wires)
+        {
+            unite(nets, wire.from, wire.to);
+        }
+
+        // Parents are never above their children, so one pass up from node 0 does it
+        for (NodeId node = 0; node < nodeCount; ++node)
+        {
+            nets[node] = nets[nets[node]];
+        }
+    }
+    linkNets();
+
+    // Each NAND reads the nets of its first two nodes. Slot 2 * i + pin stands for pin of gates[i].
+    readerStarts.assign(nodeCount + 1, 0);
+    readers.resize(gates.size() * 2);
+    countingSort(gates.size() * 2, readerStarts, readers, [&](u32 slot)
+    {
+        return nets[firstNodes[gates[slot / 2]] + slot % 2];
+    });
+
+    Parallel::forChunks(readers.size(), kMinChunk, [&](usize, usize begin, usize end)
+    {
+        for (usize i = begin; i < end; ++i)
+        {
+            readers[i] = gates[readers[i] / 2];
+        }
+    });
+}
+
+inline void Netlist::patch(std::span<ComponentKind const> kinds,
+                           std::span<u8 const>            alive,
+                           std::span<NodeId const>        firstNodes,
+                           std::span<ComponentId const>   nodeComponents,
+                           NetlistEdits&                  edits,
+                           ComponentId                    firstNewComponent,
+                           std::span<u8>                  values,
+                           std::vector<NodeId>&           changedNets)
+{
+    PROFILE_SCOPE("Netlist::patch");
+
+    // Which gates and clocks came or went. Ids only grow, so new ones sort after everything already listed.
+    std::ranges::sort(edits.touched);
+    const auto [touchedEnd, end] = std::ranges::unique(edits.touched);
+    edits.touched.erase(touchedEnd, end);
+
+    std::vector<u32> addedGates;
+    std::vector<u32> removedGates;
+    std::vector<u32> addedClocks;
+    std::vector<u32> removedClocks;
+    auto             classify = [&](ComponentId id, bool listed)
+    {
+        if (kinds[id] == ComponentKind::NAND && alive[id] != listed)
+        {
+            (alive[id] ? addedGates : removedGates).push_back(id);
+        }
+        else if (kinds[id] == ComponentKind::Clock && alive[id] != listed)
+        {
+            (alive[id] ? addedClocks : removedClocks).push_back(firstNodes[id]);
+        }
+    };
+
+    for (auto id : edits.touched)
+    {
+        const bool listed = kinds[id] == ComponentKind::NAND  ? std::ranges::binary_search(gates, id) :
+                            kinds[id] == ComponentKind::Clock ? std::ranges::binary_search(clocks, firstNodes[id]) :
+                                                                false;
+        classify(id, listed);
+    }
+
+    for (ComponentId id = firstNewComponent; id < kinds.size(); ++id)
+    {
+        classify(id, false);
+    }
+
+    patchSorted(gates, removedGates, addedGates);
+    patchSorted(clocks, removedClocks, addedClocks);
+
+    // A wire added and removed again never reached the tables
+    std::vector<Entry> removedFanout;
+    removedFanout.reserve(edits.removedWires.size());
+    for (auto const& wire : edits.removedWires)
+    {
+        removedFanout.push_back({ wire.from, wire.to });
+    }
+
+    auto byWire = [](Entry const& a, Entry const& b)
+    {
+        return a.key != b.key ? a.key < b.key : a.value < b.value;
+    };
+    std::ranges::sort(removedFanout, byWire);
+
+    std::vector<u8> cancelled(removedFanout.size(), false);
+    std::erase_if(edits.addedWires, [&](Wire const& wire)
+    {
+        const Entry entry = { wire.from, wire.to };
+        auto        found = std::lower_bound(removedFanout.begin(), removedFanout.end(), entry, byWire);
+        while (found != removedFanout.end() && found->key == wire.from && found->value == wire.to && cancelled[found - removedFanout.begin()])
+        {
+            ++found;
+        }
+
+        if (found == removedFanout.end() || found->key != wire.from || found->value != wire.to)
+        {
+            return false;
+        }
+
+        cancelled[found - removedFanout.begin()] = true;
+        return true;
+    });
+
+    usize kept = 0;
+    for (usize i = 0; i < removedFanout.size(); ++i)
+    {
+        if (!cancelled[i])
+        {
+            removedFanout[kept++] = removedFanout[i];
+        }
+    }
+    removedFanout.resize(kept);
+
+    std::vector<Entry> addedFanout;
+    addedFanout.reserve(edits.addedWires.size());
+    for (auto const& wire : edits.addedWires)
+    {
+        addedFanout.push_back({ wire.from, wire.to });
+    }
+
+    // New nodes start out with nothing, each on its own net
+    const usize nodeCount    = nodeComponents.size();
+    const usize oldNodeCount = nets.size();
+    fanoutStarts.resize(nodeCount + 1, fanoutStarts.empty() ? 0 : fanoutStarts.back());
+    readerStarts.resize(nodeCount + 1, readerStarts.empty() ? 0 : readerStarts.back());
+    nets.resize(nodeCount);
+    netNext.resize(nodeCount);
+    for (NodeId node = oldNodeCount; node < nodeCount; ++node)
+    {
+        nets[node]    = node;
+        netNext[node] = node;
+    }
+
+    // Removed gates come out from under the nets they read before any net changes
+    std::vector<Entry> removedReaders;
+    std::vector<Entry> addedReaders;
+    for (auto gate : removedGates)
+    {
+        removedReaders.push_back({ nets[firstNodes[gate]], gate });
+        removedReaders.push_back({ nets[firstNodes[gate] + 1], gate });
+    }
+
+    // The readers of every net a wire edit touches are listed again from scratch below
+    std::vector<NodeId> endpoints;
+    for (auto const& entry : removedFanout)
+    {
+        endpoints.push_back(entry.key);
+        endpoints.push_back(entry.value);
+    }
+    for (auto const& entry : addedFanout)
+    {
+        endpoints.push_back(entry.key);
+        endpoints.push_back(entry.value);
+    }
+
+    std::vector<NodeId> oldNets;
+    oldNets.reserve(endpoints.size());
+    for (auto node : endpoints)
+    {
+        oldNets.push_back(nets[node]);
+    }
+    std::ranges::sort(oldNets);
+    oldNets.erase(std::ranges::unique(oldNets).begin(), oldNets.end());
+
+    for (auto net : oldNets)
+    {
+        for (u32 j = readerStarts[net]; j < readerStarts[net + 1]; ++j)
+        {
+            removedReaders.push_back({ net, readers[j] });
+        }
+    }
+
+    patchTable(fanoutStarts, fanout, removedFanout, addedFanout, false);
+
+    // Added wires merge nets: the higher root's ring is relabelled and spliced into the lower one's
+    for (auto const& wire : edits.addedWires)
+    {
+        const NodeId from = nets[wire.from];
+        const NodeId to   = nets[wire.to];
+        if (from == to)
+        {
+            continue;
+        }
+
+        const NodeId root  = std::min(from, to);
+        const NodeId other = std::max(from, to);
+        values[root]       = values[from];
+
+        NodeId node = other;
+        do
+        {
+            nets[node] = root;
+            node       = netNext[node];
+        } while (node != other);
+        std::swap(netNext[root], netNext[other]);
+    }
+
+    // Removed wires may split nets, which are worked out again from the wires left among their nodes
+    std::vector<NodeId> splitting;
+    for (auto const& entry : removedFanout)
+    {
+        splitting.push_back(nets[entry.key]);
+    }
+    std::ranges::sort(splitting);
+    splitting.erase(std::ranges::unique(splitting).begin(), splitting.end());
+
+    std::vector<NodeId> members;
+    for (auto net : splitting)
+    {
+        const u8 value = values[net];
+
+        members.clear();
+        NodeId node = net;
+        do
+        {
+            members.push_back(node);
+            node = netNext[node];
+        } while (node != net);
+        std::ranges::sort(members);
+
+        for (auto member : members)
+        {
+            nets[member] = member;
+        }
+        for (auto member : members)
+        {
+            for (u32 j = fanoutStarts[member]; j < fanoutStarts[member + 1]; ++j)
+            {
+                unite(nets, member, fanout[j]);
+            }
+        }
+        for (auto member : members)
+        {
+            nets[member] = nets[nets[member]];
+            linkNet(member);
+            if (nets[member] == member)
+            {
+                values[member] = value;
+            }
+        }
+    }
+
+    // Every node of the nets the wire edits left behind, and the gates among them reading one
+    std::vector<NodeId> newNets;
+    newNets.reserve(endpoints.size());
+    for (auto node : endpoints)
+    {
+        newNets.push_back(nets[node]);
+    }
+    std::ranges::sort(newNets);
+    newNets.erase(std::ranges::unique(newNets).begin(), newNets.end());
+
+    members.clear();
+    for (auto net : newNets)
+    {
+        NodeId node = net;
+        do
+        {
+            members.push_back(node);
+            node = netNext[node];
+        } while (node != net);
+    }
+    std::ranges::sort(members);
+
+    for (auto member : members)
+    {
+        const auto gate = nodeComponents[member];
+        if (alive[gate] && kinds[gate] == ComponentKind::NAND && member - firstNodes[gate] < 2)
+        {
+            addedReaders.push_back({ nets[member], gate });
+        }
+    }
+
+    // Other gates that came just need their own entries
+    for (auto gate : addedGates)
+    {
+        for (u32 pin = 0; pin < 2; ++pin)
+        {
+            const NodeId node = firstNodes[gate] + pin;
+            if (!std::ranges::binary_search(members, node))
+            {
+                addedReaders.push_back({ nets[node], gate });
+            }
+        }
+    }
+
+    patchTable(readerStarts, readers, removedReaders, addedReaders, true);
+    changedNets.insert(changedNets.end(), newNets.begin(), newNets.end());
+}
+
+inline void Netlist::linkNets()
+{
+    netNext.resize(nets.size());
+    for (NodeId node = 0; node < nets.size(); ++node)
+    {
+        linkNet(node);
+    }
+}
+
+inline void Netlist::linkNet(NodeId node)
+{
+    const NodeId root = nets[node];
+    netNext[node]     = root == node ? node : netNext[root];
+    netNext[root]     = node;
+}
+
+inline auto Netlist::findRoot(std::span<NodeId> parents, NodeId node) -> NodeId
+{
+    // Path halving: every other node on the way up is pointed at its grandparent
+    while (parents[node] != node)
+    {
+        parents[node] = parents[parents[node]];
+        node          = parents[node];
+    }
+    return node;
+}
+
+inline void Netlist::unite(std::span<NodeId> parents, NodeId a, NodeId b)
+{
+    const NodeId rootA = findRoot(parents, a);
+    const NodeId rootB = findRoot(parents, b);
+    if (rootA != rootB)
+    {
+        parents[std::max(rootA, rootB)] = std::min(rootA, rootB);
+    }
+}
+
+inline auto Netlist::findRootShared(std::span<NodeId> parents, NodeId node) -> NodeId
+{
+    // Only ids are published, so relaxed is enough. A node that isn't a root never becomes one again and
+    // its ancestors only get added to, so halving can't point it anywhere but further up its own set.
+    NodeId parent = std::atomic_ref(parents[node]).load(std::memory_order_relaxed);
+    while (parent != node)
+    {
+        const NodeId grandparent = std::atomic_ref(parents[parent]).load(std::memory_order_relaxed);
+        if (grandparent == parent)
+        {
+            return parent;
+        }
+        std::atomic_ref(parents[node]).store(grandparent, std::memory_order_relaxed);
+        node   = grandparent;
+        parent = std::atomic_ref(parents[node]).load(std::memory_order_relaxed);
+    }
+    return node;
+}
+
+inline void Netlist::uniteShared(std::span<NodeId> parents, NodeId a, NodeId b)
+{
+    while (true)
+    {
+        const NodeId rootA = findRootShared(parents, a);
+        const NodeId rootB = findRootShared(parents, b);
+        if (rootA == rootB)
+        {
+            return;
+        }
+
+        // Fails if another thread got there first, the higher root isn't one any more, so go round again
+        NodeId expected = std::max(rootA, rootB);
+        if (std::atomic_ref(parents[expected]).compare_exchange_weak(expected, std::min(rootA, rootB), std::memory_order_relaxed))
+        {
+            return;
+        }
+        a = rootA;
+        b = rootB;
+    }
+}
+
+inline void Netlist::patchTable(std::vector<u32>& starts, std::vector<u32>& values, std::vector<Entry>& removes, std::vector<Entry>& inserts, bool sorted)
+{
+    auto byKey = [](Entry const& a, Entry const& b)
+    {
+        return a.key < b.key;
+    };
+    std::ranges::stable_sort(removes, byKey);
+    std::ranges::stable_sort(inserts, byKey);
+
+    if (removes.empty() && inserts.empty())
+    {
+        return;
+    }
+
+    const u32 firstKey = std::min(removes.empty() ? ~0u : removes.front().key, inserts.empty() ? ~0u : inserts.front().key);
+
+    // Everything from the first touched key on is copied out, then written back with the edits applied
+    const u32 base = starts[firstKey];
+    patchTail_.assign(values.begin() + base, values.end());
+    values.resize(base);
+
+    usize remove  = 0;
+    usize insert  = 0;
+    s64   delta   = 0;
+    u32   nextKey = firstKey;
+    u32   copied  = base; // Old index the tail has been copied up to
+    while (remove < removes.size() || insert < inserts.size())
+    {
+        const u32 key = std::min(remove < removes.size() ? removes[remove].key : ~0u, insert < inserts.size() ? inserts[insert].key : ~0u);
+
+        // Untouched keys in between just move
+        for (u32 k = nextKey + 1; k <= key; ++k)
+        {
+            starts[k] += delta;
+        }
+        const u32 oldStart = starts[key] - delta;
+        const u32 oldEnd   = starts[key + 1];
+        values.insert(values.end(), patchTail_.begin() + (copied - base), patchTail_.begin() + (oldStart - base));
+
+        patchSegment_.assign(patchTail_.begin() + (oldStart - base), patchTail_.begin() + (oldEnd - base));
+        for (; remove < removes.size() && removes[remove].key == key; ++remove)
+        {
+            auto found = std::ranges::find(patchSegment_, removes[remove].value);
+            if (found != patchSegment_.end())
+            {
+                patchSegment_.erase(found);
+            }
+        }
+        for (; insert < inserts.size() && inserts[insert].key == key; ++insert)
+        {
+            const auto at = sorted ? std::ranges::upper_bound(patchSegment_, inserts[insert].value) : patchSegment_.end();
+            patchSegment_.insert(at, inserts[insert].value);
+        }
+
+        values.insert(values.end(), patchSegment_.begin(), patchSegment_.end());
+        delta += static_cast<s64>(patchSegment_.size()) - static_cast<s64>(oldEnd - oldStart);
+        copied  = oldEnd;
+        nextKey = key;
+    }
+
+    for (usize k = nextKey + 1; k < starts.size(); ++k)
+    {
+        starts[k] += delta;
+    }
+    values.insert(values.end(), patchTail_.begin() + (copied - base), patchTail_.end());
+}
+
+inline void Netlist::patchSorted(std::vector<u32>& values, std::vector<u32>& removes, std::vector<u32> const& inserts)
+{
+    if (!removes.empty())
+    {
+        std::ranges::sort(removes);
+        std::erase_if(values, [&](u32 value)
+        {
+            return std::ranges::binary_search(removes, value);
+        });
+    }
+
+    const auto middle = values.size();
+    values.insert(values.end(), inserts.begin(), inserts.end());
+    if (middle > 0 && !inserts.empty() && inserts.front() < values[middle - 1])
+    {
+        std::inplace_merge(values.begin(), values.begin() + middle, values.end());
+    }
+}
+
+template <typename KeyOf>
+inline void Netlist::countingSort(usize count, std::vector<u32>& starts, std::vector<u32>& order, KeyOf&& keyOf)
+{
+    // One thread can use plain increments, the atomics aren't free
+    const bool shared = Parallel::chunkCount(count, kMinChunk) > 1;
+
+    Parallel::forChunks(count, kMinChunk, [&](usize, usize begin, usize end)
+    {
+        for (usize i = begin; i < end; ++i)
+        {
+            u32& start = starts[keyOf(static_cast<u32>(i)) + 1];
+            shared ? std::atomic_ref<u32>(start).fetch_add(1, std::memory_order_relaxed) : start++;
+        }
+    });
+
+    Parallel::inclusiveScan(starts, kMinChunk);
+
+    std::vector<u32> cursors(starts.begin(), starts.end() - 1);
+    Parallel::forChunks(count, kMinChunk, [&](usize, usize begin, usize end)
+    {
+        for (usize i = begin; i < end; ++i)
+        {
+            u32& cursor = cursors[keyOf(static_cast<u32>(i))];
+            order[shared ? std::atomic_ref<u32>(cursor).fetch_add(1, std::memory_order_relaxed) : cursor++] = static_cast<u32>(i);
+        }
+    });
+
+    // Threads race for slots within a key, put them back in index order so the result never changes
+    if (shared)
+    {
+        Parallel::forChunks(starts.size() - 1, kMinChunk, [&](usize, usize begin, usize end)
+        {
+            for (usize key = begin; key < end; ++key)
+            {
+                std::sort(order.begin() + starts[key], order.begin() + starts[key + 1]);
+            }
+        });
+    }
+}
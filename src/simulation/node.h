@@ -0,0 +1,10 @@
+#pragma once
+
+#include "types.h"
+
+// A node is a single pin on a component, which carries a logic value.
+// Nodes are referred to by their index into Circuit's node arrays, and a component's
+// nodes are allocated contiguously starting at its first node.
+using NodeId = u32;
+
+constexpr NodeId kInvalidNodeId = ~0u;
@@ -0,0 +1,198 @@
+#pragma once
+
+#include "types.h"
+
+#include "simulation/circuit_block.h"
+#include "simulation/components/component.h"
+
+#include <algorithm>
+#include <initializer_list>
+#include <span>
+#include <vector>
+
+// A library component from the README (NOT, MUX16, RAM64, ...), precompiled into a relocatable
+// CircuitBlock of NANDs and NODEs. Dropping one onto the canvas is a single Circuit::appendBlock().
+// The library itself is in component_registry.h.
+//
+// A prefab's inputs and outputs are NODEs inside the block, listed here in pin order.
+struct Prefab final
+{
+    CircuitBlock        block;
+    std::vector<NodeId> inputs;
+    std::vector<NodeId> outputs;
+    Size                size;
+};
+
+// Builds a prefab from NANDs and other prefabs. Everything is laid out in columns, left to right:
+// each add goes below the last one in the current column, column() starts the next one.
+class PrefabBuilder final
+{
+public:
+    auto input() -> NodeId;
+    auto output(NodeId from) -> NodeId;
+
+    // Returns the output node. An input of kInvalidNodeId is left for wire() to hook up later,
+    // e.g. for feedback, through nandInput().
+    auto nand(NodeId a, NodeId b) -> NodeId;
+
+    // Input pin 0 or 1 of the NAND whose output nand() returned
+    auto nandInput(NodeId output, u32 pin) const -> NodeId;
+
+    // Copies in another prefab, wiring inputs to its inputs, and returns its outputs.
+    // Inputs of kInvalidNodeId are left unconnected, as with nand().
+    auto place(Prefab const& prefab, std::span<NodeId const> inputs) -> std::vector<NodeId>;
+    auto place(Prefab const& prefab, std::initializer_list<NodeId> inputs) -> std::vector<NodeId>;
+
+    void wire(NodeId from, NodeId to);
+    void column();
+
+    auto build() -> Prefab;
+
+    // Bump when the layout or the block's contents change, so cached prefabs get rebuilt
+    static constexpr u32 kRevision = 1;
+
+private:
+    auto add(ComponentKind kind) -> NodeId;
+    auto next(Size const& size) -> Position;
+
+    static constexpr f64 kGap = 20.0;
+
+    CircuitBlock        m_Block;
+    std::vector<NodeId> m_Inputs;
+    std::vector<NodeId> m_Outputs;
+
+    Position m_Cursor      = { 0.0, 0.0 };
+    f64      m_ColumnWidth = 0.0;
+    Size     m_Size        = { 0.0, 0.0 };
+};
+
+inline auto PrefabBuilder::input() -> NodeId
+{
+    const auto node = add(ComponentKind::Node);
+    m_Inputs.push_back(node);
+    return node;
+}
+
+inline auto PrefabBuilder::output(NodeId from) -> NodeId
+{
+    const auto node = add(ComponentKind::Node);
+    wire(from, node);
+    m_Outputs.push_back(node);
+    return node;
+}
+
+inline auto PrefabBuilder::nand(NodeId a, NodeId b) -> NodeId
+{
+    const auto first = add(ComponentKind::NAND);
+    if (a != kInvalidNodeId)
+    {
+        wire(a, first);
+    }
+
+    if (b != kInvalidNodeId)
+    {
+        wire(b, first + 1);
+    }
+
+    return first + 2;
+}
+
+inline auto PrefabBuilder::nandInput(NodeId output, u32 pin) const -> NodeId
+{
+    return m_Block.firstNodes[m_Block.nodeComponents[output]] + pin;
+}
+
+inline auto PrefabBuilder::place(Prefab const& prefab, std::span<NodeId const> inputs) -> std::vector<NodeId>
+{
+    const auto  origin     = next(prefab.size);
+    const auto  firstNode  = static_cast<NodeId>(m_Block.nodeCount());
+    const auto  firstIndex = static_cast<u32>(m_Block.componentCount());
+    auto const& block      = prefab.block;
+
+    m_Block.kinds.insert(m_Block.kinds.end(), block.kinds.begin(), block.kinds.end());
+    m_Block.facings.insert(m_Block.facings.end(), block.facings.begin(), block.facings.end());
+    for (auto const& position : block.positions)
+    {
+        m_Block.positions.push_back({ origin.x + position.x, origin.y + position.y });
+    }
+
+    for (auto node : block.firstNodes)
+    {
+        m_Block.firstNodes.push_back(firstNode + node);
+    }
+
+    for (auto component : block.nodeComponents)
+    {
+        m_Block.nodeComponents.push_back(firstIndex + component);
+    }
+
+    for (auto const& wire : block.wires)
+    {
+        m_Block.wires.push_back({ firstNode + wire.from, firstNode + wire.to });
+    }
+
+    for (usize i = 0; i < std::min(inputs.size(), prefab.inputs.size()); ++i)
+    {
+        if (inputs[i] != kInvalidNodeId)
+        {
+            wire(inputs[i], firstNode + prefab.inputs[i]);
+        }
+    }
+
+    std::vector<NodeId> outputs;
+    outputs.reserve(prefab.outputs.size());
+    for (auto node : prefab.outputs)
+    {
+        outputs.push_back(firstNode + node);
+    }
+
+    return outputs;
+}
+
+inline auto PrefabBuilder::place(Prefab const& prefab, std::initializer_list<NodeId> inputs) -> std::vector<NodeId>
+{
+    return place(prefab, std::span<NodeId const>(inputs.begin(), inputs.size()));
+}
+
+inline void PrefabBuilder::wire(NodeId from, NodeId to)
+{
+    m_Block.wires.push_back({ from, to });
+}
+
+inline void PrefabBuilder::column()
+{
+    m_Cursor      = { m_Cursor.x + m_ColumnWidth + kGap * 2.0, 0.0 };
+    m_ColumnWidth = 0.0;
+}
+
+inline auto PrefabBuilder::build() -> Prefab
+{
+    return { std::move(m_Block), std::move(m_Inputs), std::move(m_Outputs), m_Size };
+}
+
+// Returns the component's first node
+inline auto PrefabBuilder::add(ComponentKind kind) -> NodeId
+{
+    auto const& info      = componentInfo(kind);
+    const auto  index     = static_cast<u32>(m_Block.componentCount());
+    const auto  firstNode = static_cast<NodeId>(m_Block.nodeCount());
+
+    m_Block.kinds.push_back(kind);
+    m_Block.positions.push_back(next(info.size));
+    m_Block.facings.push_back(Facing::Right);
+    m_Block.firstNodes.push_back(firstNode);
+    m_Block.nodeComponents.insert(m_Block.nodeComponents.end(), info.nodeCount, index);
+
+    return firstNode;
+}
+
+inline auto PrefabBuilder::next(Size const& size) -> Position
+{
+    const auto position = m_Cursor;
+
+    m_Cursor.y += size.height + kGap;
+    m_ColumnWidth = std::max(m_ColumnWidth, size.width);
+    m_Size        = { std::max(m_Size.width, position.x + size.width), std::max(m_Size.height, position.y + size.height) };
+
+    return position;
+}
@@ -0,0 +1,234 @@
+#pragma once
+
+#include "config.h"
+#include "types.h"
+
+#include "simulation/prefab_builder.h"
+
+#include <algorithm>
+#include <array>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <optional>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+// Built prefabs on disk, so the big library components don't have to be rebuilt from their parts every run.
+//
+// Each file is named after the key of the definition it was built from (see prefabKey() in
+// component_registry.h). The key covers the definition's name, pins and recipe revision and, through
+// their own keys, everything it's made of. It doesn't cover the factory's code, so a factory change
+// needs its recipe's revision bumped or the old file keeps being loaded; prefab_cache_test rebuilds
+// every prefab and compares it with its cached copy to catch a missed bump. A changed definition gets
+// a new key and so a new file, and definitions that didn't change keep hitting their old ones.
+// Nothing is ever invalidated in place, stale files are just never looked up again.
+//
+// A file is a header then the prefab's arrays back to back, raw and native-endian, like circuit_file.h.
+// Anything that doesn't read back cleanly is treated as a miss.
+namespace PrefabCache
+{
+    constexpr std::array<char, 8> kMagic     = { 'N', 'A', 'N', 'D', 'Y', 'P', 'F', 'B' };
+    constexpr u32                 kVersion   = 1;
+    constexpr u32                 kByteOrder = 0x01020304;
+
+    struct Header final
+    {
+        std::array<char, 8> magic;
+        u32                 version;
+        u32                 byteOrder;
+        u64                 key;
+        u64                 componentCount;
+        u64                 nodeCount;
+        u64                 wireCount;
+        u64                 inputCount;
+        u64                 outputCount;
+        Size                size;
+    };
+
+    auto path(u64 key) -> std::filesystem::path;
+
+    auto load(u64 key) -> std::optional<Prefab>;
+
+    // Writes to a temporary file and renames it into place, so a reader never sees half a prefab
+    auto store(u64 key, Prefab const& prefab) -> bool;
+
+    inline auto path(u64 key) -> std::filesystem::path
+    {
+        return std::filesystem::path(Config::kPrefabCacheDir) / fmt::format("{:016x}.prefab", key);
+    }
+
+    inline auto load(u64 key) -> std::optional<Prefab>
+    {
+        std::ifstream file(path(key), std::ios::binary);
+        if (!file)
+        {
+            return std::nullopt;
+        }
+
+        Header header;
+        if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+            header.magic != kMagic || header.version != kVersion || header.byteOrder != kByteOrder || header.key != key)
+        {
+            return std::nullopt;
+        }
+
+        // Check the counts against the file's size before allocating anything for them
+        const u64 counts[]     = { header.componentCount, header.nodeCount, header.wireCount, header.inputCount, header.outputCount };
+        const u64 perComponent = sizeof(ComponentKind) + sizeof(Position) + sizeof(Facing) + sizeof(NodeId);
+
+        std::error_code error;
+        const u64       fileSize = std::filesystem::file_size(path(key), error);
+        if (error || std::ranges::any_of(counts, [&](u64 count) { return count > fileSize; }))
+        {
+            return std::nullopt;
+        }
+
+        const u64 expectedSize = sizeof(Header) +
+                                 header.componentCount * perComponent +
+                                 header.nodeCount * sizeof(ComponentId) +
+                                 header.wireCount * sizeof(Wire) +
+                                 (header.inputCount + header.outputCount) * sizeof(NodeId);
+        if (expectedSize != fileSize)
+        {
+            return std::nullopt;
+        }
+
+        Prefab prefab;
+        prefab.size = header.size;
+
+        auto read = [&](auto& vector, u64 count)
+        {
+            vector.resize(count);
+            file.read(reinterpret_cast<char*>(vector.data()), count * sizeof(vector[0]));
+        };
+
+        auto& block = prefab.block;
+        read(block.kinds, header.componentCount);
+        read(block.positions, header.componentCount);
+        read(block.facings, header.componentCount);
+        read(block.firstNodes, header.componentCount);
+        read(block.nodeComponents, header.nodeCount);
+        read(block.wires, header.wireCount);
+        read(prefab.inputs, header.inputCount);
+        read(prefab.outputs, header.outputCount);
+        if (!file)
+        {
+            return std::nullopt;
+        }
+
+        // A bad id here would end up in the circuit, so check them all. Each component's nodes must
+        // point back at it, and between them the components must own every node exactly once.
+        const u64 nodes      = header.nodeCount;
+        u64       ownedNodes = 0;
+        for (u64 i = 0; i < header.componentCount; ++i)
+        {
+            if (static_cast<usize>(block.kinds[i]) >= kComponentInfos.size() ||
+                static_cast<u32>(block.facings[i]) > static_cast<u32>(Facing::Up) ||
+                static_cast<u64>(block.firstNodes[i]) + componentInfo(block.kinds[i]).nodeCount > nodes)
+            {
+                return std::nullopt;
+            }
+
+            for (u32 pin = 0; pin < componentInfo(block.kinds[i]).nodeCount; ++pin)
+            {
+                if (block.nodeComponents[block.firstNodes[i] + pin] != i)
+                {
+                    return std::nullopt;
+                }
+            }
+            ownedNodes += componentInfo(block.kinds[i]).nodeCount;
+        }
+
+        if (ownedNodes != nodes)
+        {
+            return std::nullopt;
+        }
+
+        auto allBelow = [](auto const& vector, u64 limit)
+        {
+            return std::all_of(vector.begin(), vector.end(), [&](auto value)
+            {
+                return value < limit;
+            });
+        };
+
+        const bool valid = allBelow(block.nodeComponents, header.componentCount) &&
+                           allBelow(prefab.inputs, nodes) &&
+                           allBelow(prefab.outputs, nodes) &&
+                           std::all_of(block.wires.begin(), block.wires.end(), [&](Wire const& wire)
+                           {
+                               return wire.from < nodes && wire.to < nodes;
+                           });
+        if (!valid)
+        {
+            return std::nullopt;
+        }
+
+        return prefab;
+    }
+
+    inline auto store(u64 key, Prefab const& prefab) -> bool
+    {
+        std::error_code error;
+        std::filesystem::create_directories(Config::kPrefabCacheDir, error);
+        if (error)
+        {
+            return false;
+        }
+
+        const auto finalPath = path(key);
+        auto       tempPath  = finalPath;
+        tempPath += fmt::format(".{}.tmp", std::hash<std::thread::id>()(std::this_thread::get_id()));
+
+        {
+            std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+
+            auto const& block = prefab.block;
+
+            Header header;
+            header.magic          = kMagic;
+            header.version        = kVersion;
+            header.byteOrder      = kByteOrder;
+            header.key            = key;
+            header.componentCount = block.componentCount();
+            header.nodeCount      = block.nodeCount();
+            header.wireCount      = block.wires.size();
+            header.inputCount     = prefab.inputs.size();
+            header.outputCount    = prefab.outputs.size();
+            header.size           = prefab.size;
+            file.write(reinterpret_cast<char const*>(&header), sizeof(header));
+
+            auto write = [&](auto const& vector)
+            {
+                file.write(reinterpret_cast<char const*>(vector.data()), vector.size() * sizeof(vector[0]));
+            };
+
+            write(block.kinds);
+            write(block.positions);
+            write(block.facings);
+            write(block.firstNodes);
+            write(block.nodeComponents);
+            write(block.wires);
+            write(prefab.inputs);
+            write(prefab.outputs);
+
+            if (!file.flush())
+            {
+                file.close();
+                std::filesystem::remove(tempPath, error);
+                return false;
+            }
+        }
+
+        std::filesystem::rename(tempPath, finalPath, error);
+        if (error)
+        {
+            std::filesystem::remove(tempPath, error);
+            return false;
+        }
+        return true;
+    }
+} // namespace PrefabCache
@@ -0,0 +1,188 @@
+#pragma once
+
+#include "types.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <string>
+
+// Running totals kept by CircuitRunner, cheap enough to leave on.
+//
+// Apart from the queue depth, counters only go up. Each is a relaxed atomic written from one
+// place, so keeping them costs a few uncontended adds per step. Readers take a snapshot() and
+// work out rates from the difference between two snapshots.
+struct SimMetrics final
+{
+    using Clock = std::chrono::steady_clock;
+
+    struct Snapshot final
+    {
+        f64 seconds = 0.0; // Since the runner started
+
+        u64 steps             = 0;
+        u64 gateEvaluations   = 0;
+        u64 events            = 0;
+        u64 commandsApplied   = 0;
+        u64 worklistHighWater = 0;
+        u64 queueDepth        = 0;
+        u64 queueHighWater    = 0;
+        u64 simLockWaitNs     = 0; // Simulation thread waiting for the UI to let go of the circuit
+        u64 uiLockWaitNs      = 0; // UI thread waiting for a step to finish
+    };
+
+    // Per-second figures between two snapshots
+    struct Rates final
+    {
+        f64 stepsPerSecond           = 0.0;
+        f64 gateEvaluationsPerSecond = 0.0;
+        f64 eventsPerStep            = 0.0;
+        f64 simLockWaitMsPerSecond   = 0.0;
+        f64 uiLockWaitMsPerSecond    = 0.0;
+    };
+
+    SimMetrics();
+
+    auto snapshot() const -> Snapshot;
+
+    static auto rates(Snapshot const& from, Snapshot const& to) -> Rates;
+    static auto toJson(Snapshot const& snapshot) -> json;
+
+    // Writes the current totals, with averages over the whole run. Returns false if the file couldn't be written.
+    auto dump(std::string const& path) const -> bool;
+
+    // Simulation thread
+    void addStep(u32 stepEvents, u32 stepGateEvaluations, u32 worklist);
+    void addCommands(u64 count);
+    void addSimLockWait(Clock::duration wait);
+
+    // Any thread holding the runner's lock
+    void setQueueDepth(u64 depth);
+
+    // UI thread
+    void addUILockWait(Clock::duration wait);
+
+    // private:
+    static void raise(std::atomic<u64>& value, u64 candidate);
+
+    const Clock::time_point start;
+
+    std::atomic<u64> steps             = 0;
+    std::atomic<u64> gateEvaluations   = 0;
+    std::atomic<u64> events            = 0;
+    std::atomic<u64> commandsApplied   = 0;
+    std::atomic<u64> worklistHighWater = 0;
+    std::atomic<u64> queueDepth        = 0;
+    std::atomic<u64> queueHighWater    = 0;
+    std::atomic<u64> simLockWaitNs     = 0;
+    std::atomic<u64> uiLockWaitNs      = 0;
+};
+
+inline SimMetrics::SimMetrics()
+: start(Clock::now())
+{
+}
+
+inline auto SimMetrics::snapshot() const -> Snapshot
+{
+    constexpr auto relaxed = std::memory_order_relaxed;
+
+    Snapshot snapshot;
+    snapshot.seconds           = std::chrono::duration<f64>(Clock::now() - start).count();
+    snapshot.steps             = steps.load(relaxed);
+    snapshot.gateEvaluations   = gateEvaluations.load(relaxed);
+    snapshot.events            = events.load(relaxed);
+    snapshot.commandsApplied   = commandsApplied.load(relaxed);
+    snapshot.worklistHighWater = worklistHighWater.load(relaxed);
+    snapshot.queueDepth        = queueDepth.load(relaxed);
+    snapshot.queueHighWater    = queueHighWater.load(relaxed);
+    snapshot.simLockWaitNs     = simLockWaitNs.load(relaxed);
+    snapshot.uiLockWaitNs      = uiLockWaitNs.load(relaxed);
+    return snapshot;
+}
+
+inline auto SimMetrics::rates(Snapshot const& from, Snapshot const& to) -> Rates
+{
+    Rates rates;
+
+    const f64 seconds = to.seconds - from.seconds;
+    if (seconds <= 0.0)
+    {
+        return rates;
+    }
+
+    const u64 steps = to.steps - from.steps;
+
+    rates.stepsPerSecond           = steps / seconds;
+    rates.gateEvaluationsPerSecond = (to.gateEvaluations - from.gateEvaluations) / seconds;
+    rates.eventsPerStep            = steps > 0 ? static_cast<f64>(to.events - from.events) / steps : 0.0;
+    rates.simLockWaitMsPerSecond   = (to.simLockWaitNs - from.simLockWaitNs) / 1e6 / seconds;
+    rates.uiLockWaitMsPerSecond    = (to.uiLockWaitNs - from.uiLockWaitNs) / 1e6 / seconds;
+    return rates;
+}
+
+inline auto SimMetrics::toJson(Snapshot const& snapshot) -> json
+{
+    const auto average = rates({}, snapshot);
+
+    return {
+        { "seconds", snapshot.seconds },
+        { "steps", snapshot.steps },
+        { "gate_evaluations", snapshot.gateEvaluations },
+        { "events", snapshot.events },
+        { "commands_applied", snapshot.commandsApplied },
+        { "worklist_high_water", snapshot.worklistHighWater },
+        { "command_queue_depth", snapshot.queueDepth },
+        { "command_queue_high_water", snapshot.queueHighWater },
+        { "sim_lock_wait_ms", snapshot.simLockWaitNs / 1e6 },
+        { "ui_lock_wait_ms", snapshot.uiLockWaitNs / 1e6 },
+        { "steps_per_second", average.stepsPerSecond },
+        { "gate_evaluations_per_second", average.gateEvaluationsPerSecond },
+        { "events_per_step", average.eventsPerStep },
+    };
+}
+
+inline auto SimMetrics::dump(std::string const& path) const -> bool
+{
+    std::ofstream file(path);
+    file << toJson(snapshot()).dump(4) << '\n';
+    return static_cast<bool>(file);
+}
+
+inline void SimMetrics::addStep(u32 stepEvents, u32 stepGateEvaluations, u32 worklist)
+{
+    steps.fetch_add(1, std::memory_order_relaxed);
+    gateEvaluations.fetch_add(stepGateEvaluations, std::memory_order_relaxed);
+    events.fetch_add(stepEvents, std::memory_order_relaxed);
+    raise(worklistHighWater, worklist);
+}
+
+inline void SimMetrics::addCommands(u64 count)
+{
+    commandsApplied.fetch_add(count, std::memory_order_relaxed);
+}
+
+inline void SimMetrics::addSimLockWait(Clock::duration wait)
+{
+    simLockWaitNs.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(wait).count(), std::memory_order_relaxed);
+}
+
+inline void SimMetrics::setQueueDepth(u64 depth)
+{
+    queueDepth.store(depth, std::memory_order_relaxed);
+    raise(queueHighWater, depth);
+}
+
+inline void SimMetrics::addUILockWait(Clock::duration wait)
+{
+    uiLockWaitNs.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(wait).count(), std::memory_order_relaxed);
+}
+
+inline void SimMetrics::raise(std::atomic<u64>& value, u64 candidate)
+{
+    u64 current = value.load(std::memory_order_relaxed);
+    while (candidate > current && !value.compare_exchange_weak(current, candidate, std::memory_order_relaxed))
+    {
+    }
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include "simulation/node.h"
+
+#include <fmt/format.h>
+#include <string>
+
+// A wire carries the value of one node to another
+struct Wire final
+{
+    NodeId from;
+    NodeId to;
+
+    auto operator==(Wire const&) const -> bool = default;
+};
+
+inline auto toString(Wire const& wire) -> std::string
+{
+    return fmt::format("Wire: from={}, to={}", wire.from, wire.to);
+}
@@ -2,6 +2,7 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <utility>
 
 // SDL Forward declarations
 struct SDL_Window;
@@ -128,6 +129,24 @@ inline auto toString(Facing facing) -> std::string
     return "Unknown";
 }
 
+// Maps a point in a component's unit box, drawn facing right, to where it ends up for the given facing
+constexpr auto facingTransform(Facing facing, f32 x, f32 y) -> std::pair<f32, f32>
+{
+    switch (facing)
+    {
+        case Facing::Right:
+            return { x, y };
+        case Facing::Down:
+            return { y, x };
+        case Facing::Left:
+            return { 1.0f - x, y };
+        case Facing::Up:
+            return { y, 1.0f - x };
+    }
+
+    return { x, y };
+}
+
 enum class SimControl
 {
     Step,
@@ -153,6 +172,32 @@ inline std::string toString(SimControl control)
     }
 }
 
+enum class CircuitFormat
+{
+    Binary,
+    Json,
+};
+
+inline auto toString(CircuitFormat format) -> std::string
+{
+    switch (format)
+    {
+        case CircuitFormat::Binary:
+            return "Binary";
+        case CircuitFormat::Json:
+            return "Json";
+    }
+
+    return "Unknown";
+}
+
+// Builds a visitor for std::visit out of a set of lambdas
+template <typename... Ts>
+struct overloaded : Ts...
+{
+    using Ts::operator()...;
+};
+
 #include <nlohmann/json.hpp>
 using json = nlohmann::json;
 using namespace nlohmann::literals;
@@ -1,14 +1,43 @@
 #pragma once
 
+#include "ui/actions/ui_canvas_hovered_action.h"
+#include "ui/actions/ui_close_requested_action.h"
+#include "ui/actions/ui_drag_drop_action.h"
+#include "ui/actions/ui_dump_metrics_action.h"
+#include "ui/actions/ui_keypress_action.h"
+#include "ui/actions/ui_load_circuit_action.h"
+#include "ui/actions/ui_mouse_down_action.h"
+#include "ui/actions/ui_mouse_moved_action.h"
+#include "ui/actions/ui_mouse_up_action.h"
+#include "ui/actions/ui_mouse_wheel_action.h"
+#include "ui/actions/ui_save_circuit_action.h"
+#include "ui/actions/ui_sim_control_action.h"
+
 #include <string>
+#include <variant>
 
 // An action is a low level message that is sent from Dear ImGui and the renderer to
 // allow us to build up more complex stateful behaviours.
 // User inputs (mouse clicks, key presses) are captured as actions.
-struct Action
-{
-    virtual ~Action() = default;
+// Actions are a closed set, stored by value and dispatched with std::visit.
+using Action = std::variant<
+    UICanvasHoveredAction,
+    UICloseRequestedAction,
+    UIDragDropAction,
+    UIDumpMetricsAction,
+    UIKeypressAction,
+    UILoadCircuitAction,
+    UIMouseDownAction,
+    UIMouseMovedAction,
+    UIMouseUpAction,
+    UIMouseWheelAction,
+    UISaveCircuitAction,
+    UISimControlAction>;
 
-    virtual auto getName() const -> std::string = 0;
-    virtual auto toString() const -> std::string = 0;
-};
+inline auto toString(Action const& action) -> std::string
+{
+    return std::visit([](auto const& alternative)
+    {
+        return alternative.toString();
+    }, action);
+}
@@ -1,19 +1,14 @@
 #pragma once
 
 #include "types.h"
-#include "ui/actions/action.h"
 
-struct UICanvasHoveredAction final : public Action
+#include <string>
+
+struct UICanvasHoveredAction final
 {
     UICanvasHoveredAction();
-    ~UICanvasHoveredAction();
-
-    auto getName() const -> std::string override
-    {
-        return "UICanvasHoveredAction";
-    }
 
-    auto toString() const -> std::string override
+    auto toString() const -> std::string
     {
         return "UICanvasHoveredAction";
     }
@@ -22,7 +17,3 @@ struct UICanvasHoveredAction final : public Action
 inline UICanvasHoveredAction::UICanvasHoveredAction()
 {
 }
-
-inline UICanvasHoveredAction::~UICanvasHoveredAction()
-{
-}
@@ -1,19 +1,14 @@
 #pragma once
 
 #include "types.h"
-#include "ui/actions/action.h"
 
-struct UICloseRequestedAction final : public Action
+#include <string>
+
+struct UICloseRequestedAction final
 {
     UICloseRequestedAction();
-    ~UICloseRequestedAction();
-
-    auto getName() const -> std::string override
-    {
-        return "UICloseRequestedAction";
-    }
 
-    auto toString() const -> std::string override
+    auto toString() const -> std::string
     {
         return "UICloseRequestedAction";
     }
@@ -22,7 +17,3 @@ struct UICloseRequestedAction final : public Action
 inline UICloseRequestedAction::UICloseRequestedAction()
 {
 }
-
-inline UICloseRequestedAction::~UICloseRequestedAction()
-{
-}
@@ -1,39 +1,29 @@
 #pragma once
 
+#include "simulation/components/component_registry.h"
 #include "types.h"
-#include "ui/actions/action.h"
 
 #include <fmt/format.h>
 #include <string>
 
-struct UIDragDropAction final : public Action
+struct UIDragDropAction final
 {
-    UIDragDropAction(f32 x, f32 y, std::string payload);
-    ~UIDragDropAction();
+    UIDragDropAction(f32 x, f32 y, ComponentType type);
 
-    auto getName() const -> std::string override
+    auto toString() const -> std::string
     {
-        return "UIDragDropAction";
-    }
-
-    auto toString() const -> std::string override
-    {
-        return fmt::format("UIDragDropAction: x={}, y={}, payload={}", x, y, payload);
+        return fmt::format("UIDragDropAction: x={}, y={}, type={}", x, y, ::toString(type));
     }
 
     // private:
-    f32         x;
-    f32         y;
-    std::string payload;
+    f32           x;
+    f32           y;
+    ComponentType type;
 };
 
-inline UIDragDropAction::UIDragDropAction(f32 x, f32 y, std::string payload)
+inline UIDragDropAction::UIDragDropAction(f32 x, f32 y, ComponentType type)
 : x(x)
 , y(y)
-, payload(std::move(payload))
-{
-}
-
-inline UIDragDropAction::~UIDragDropAction()
+, type(type)
 {
 }
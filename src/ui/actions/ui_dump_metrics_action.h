@@ -0,0 +1,19 @@
+#pragma once
+
+#include "types.h"
+
+#include <string>
+
+struct UIDumpMetricsAction final
+{
+    UIDumpMetricsAction();
+
+    auto toString() const -> std::string
+    {
+        return "UIDumpMetricsAction";
+    }
+};
+
+inline UIDumpMetricsAction::UIDumpMetricsAction()
+{
+}
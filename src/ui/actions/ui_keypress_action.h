@@ -1,34 +1,26 @@
 #pragma once
 
 #include "types.h"
-#include "ui/actions/action.h"
 
 #include <fmt/format.h>
+#include <string>
 
-struct UIKeypressAction final : public Action
+struct UIKeypressAction final
 {
-    UIKeypressAction(u32 val);
-    ~UIKeypressAction();
+    UIKeypressAction(u32 val, bool ctrl = false);
 
-    auto getName() const -> std::string override
+    auto toString() const -> std::string
     {
-        return "UIKeypressAction";
+        return fmt::format("UIKeypressAction: val={}, ctrl={}", val, ctrl);
     }
 
-    auto toString() const -> std::string override
-    {
-        return fmt::format("UIKeypressAction: val={}", val);
-    }
-
-private:
-    u32 val;
+    // private:
+    u32  val;
+    bool ctrl;
 };
 
-inline UIKeypressAction::UIKeypressAction(u32 val)
+inline UIKeypressAction::UIKeypressAction(u32 val, bool ctrl)
 : val(val)
-{
-}
-
-inline UIKeypressAction::~UIKeypressAction()
+, ctrl(ctrl)
 {
 }
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "types.h"
+
+#include <fmt/format.h>
+#include <string>
+
+struct UILoadCircuitAction final
+{
+    UILoadCircuitAction(CircuitFormat format);
+
+    auto toString() const -> std::string
+    {
+        return fmt::format("UILoadCircuitAction: format={}", ::toString(format));
+    }
+
+    // private:
+    CircuitFormat format;
+};
+
+inline UILoadCircuitAction::UILoadCircuitAction(CircuitFormat format)
+: format(format)
+{
+}
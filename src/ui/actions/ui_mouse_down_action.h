@@ -1,28 +1,24 @@
 #pragma once
 
 #include "types.h"
-#include "ui/actions/action.h"
 
-struct UIMouseDownAction final : public Action
+#include <fmt/format.h>
+#include <string>
+
+struct UIMouseDownAction final
 {
-    UIMouseDownAction();
-    ~UIMouseDownAction();
+    explicit UIMouseDownAction(bool shift = false);
 
-    auto getName() const -> std::string override
+    auto toString() const -> std::string
     {
-        return "UIMouseDownAction";
+        return fmt::format("UIMouseDownAction: shift={}", shift);
     }
 
-    auto toString() const -> std::string override
-    {
-        return fmt::format("UIMouseDownAction");
-    }
+    // private:
+    bool shift;
 };
 
-inline UIMouseDownAction::UIMouseDownAction()
-{
-}
-
-inline UIMouseDownAction::~UIMouseDownAction()
+inline UIMouseDownAction::UIMouseDownAction(bool shift)
+: shift(shift)
 {
 }
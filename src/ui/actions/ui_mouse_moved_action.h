@@ -1,21 +1,15 @@
 #pragma once
 
 #include "types.h"
-#include "ui/actions/action.h"
 
 #include <fmt/format.h>
+#include <string>
 
-struct UIMouseMovedAction final : public Action
+struct UIMouseMovedAction final
 {
     UIMouseMovedAction(f32 x, f32 y, f32 dx, f32 dy);
-    ~UIMouseMovedAction();
 
-    auto getName() const -> std::string override
-    {
-        return "UIMouseMovedAction";
-    }
-
-    auto toString() const -> std::string override
+    auto toString() const -> std::string
     {
         return fmt::format("UIMouseMovedAction: x={}, y={}, dx={}, dy={}", x, y, dx, dy);
     }
@@ -34,7 +28,3 @@ inline UIMouseMovedAction::UIMouseMovedAction(f32 x, f32 y, f32 dx, f32 dy)
 , dy(dy)
 {
 }
-
-inline UIMouseMovedAction::~UIMouseMovedAction()
-{
-}
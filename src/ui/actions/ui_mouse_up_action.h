@@ -1,19 +1,15 @@
 #pragma once
 
 #include "types.h"
-#include "ui/actions/action.h"
 
-struct UIMouseUpAction final : public Action
+#include <fmt/format.h>
+#include <string>
+
+struct UIMouseUpAction final
 {
     UIMouseUpAction();
-    ~UIMouseUpAction();
-
-    auto getName() const -> std::string override
-    {
-        return "UIMouseUpAction";
-    }
 
-    auto toString() const -> std::string override
+    auto toString() const -> std::string
     {
         return fmt::format("UIMouseUpAction");
     }
@@ -22,7 +18,3 @@ struct UIMouseUpAction final : public Action
 inline UIMouseUpAction::UIMouseUpAction()
 {
 }
-
-inline UIMouseUpAction::~UIMouseUpAction()
-{
-}
@@ -1,21 +1,15 @@
 #pragma once
 
 #include "types.h"
-#include "ui/actions/action.h"
 
 #include <fmt/format.h>
+#include <string>
 
-struct UIMouseWheelAction final : public Action
+struct UIMouseWheelAction final
 {
     UIMouseWheelAction(f32 val);
-    ~UIMouseWheelAction();
 
-    auto getName() const -> std::string override
-    {
-        return "UIMouseWheelAction";
-    }
-
-    auto toString() const -> std::string override
+    auto toString() const -> std::string
     {
         return fmt::format("UIMouseWheelAction: val={}", val);
     }
@@ -28,7 +22,3 @@ inline UIMouseWheelAction::UIMouseWheelAction(f32 val)
 : val(val)
 {
 }
-
-inline UIMouseWheelAction::~UIMouseWheelAction()
-{
-}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "types.h"
+
+#include <fmt/format.h>
+#include <string>
+
+struct UISaveCircuitAction final
+{
+    UISaveCircuitAction(CircuitFormat format);
+
+    auto toString() const -> std::string
+    {
+        return fmt::format("UISaveCircuitAction: format={}", ::toString(format));
+    }
+
+    // private:
+    CircuitFormat format;
+};
+
+inline UISaveCircuitAction::UISaveCircuitAction(CircuitFormat format)
+: format(format)
+{
+}
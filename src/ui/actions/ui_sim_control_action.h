@@ -1,26 +1,20 @@
 #pragma once
 
 #include "types.h"
-#include "ui/actions/action.h"
 
 #include <fmt/format.h>
+#include <string>
 
-struct UISimControlAction final : public Action
+struct UISimControlAction final
 {
     UISimControlAction(SimControl control);
-    ~UISimControlAction();
 
-    auto getName() const -> std::string override
-    {
-        return "UISimControlAction";
-    }
-
-    auto toString() const -> std::string override
+    auto toString() const -> std::string
     {
         return fmt::format("UISimControlAction: val={}", ::toString(control));
     }
 
-private:
+    // private:
     SimControl control;
 };
 
@@ -28,7 +22,3 @@ inline UISimControlAction::UISimControlAction(SimControl control)
 : control(control)
 {
 }
-
-inline UISimControlAction::~UISimControlAction()
-{
-}
@@ -1,13 +1,22 @@
 #pragma once
 
+#include "config.h"
+#include "frame_arena.h"
+#include "log.h"
 #include "ui/events/event.h"
 
 #include "simulation/commands/add_component_command.h"
 #include "simulation/commands/command.h"
+#include "simulation/commands/duplicate_components_command.h"
+#include "simulation/commands/mass_connect_command.h"
+#include "simulation/commands/move_components_command.h"
+#include "simulation/commands/redo_command.h"
+#include "simulation/commands/undo_command.h"
 
-#include "ui/events/ui_drag_drop_event.h"
-
+#include <algorithm>
 #include <memory>
+#include <memory_resource>
+#include <vector>
 
 class CanvasController final
 {
@@ -15,7 +24,26 @@ public:
     CanvasController();
     ~CanvasController();
 
-    auto handleCanvasEvent(std::unique_ptr<Event> event) -> std::vector<std::unique_ptr<Command>>;
+    // Appends the commands built from event to commands, they're allocated in arena and live until it's reset
+    void handleCanvasEvent(Event const& event, FrameArena& arena, std::pmr::vector<Command*>& commands);
+
+    // Forgets the selection and ends any drag, for when a load replaces the circuit their ids point into
+    void reset();
+
+private:
+    // Every command from one gesture is stamped with the same transaction, so they can be merged
+    // on the way to the simulation and undone as one
+    auto beginTransaction() -> u64;
+    void endTransaction();
+
+    // Merges into the last command where possible
+    void push(Command* command, std::pmr::vector<Command*>& commands);
+
+    u64 m_NextTransaction = 1;
+    u64 m_Transaction     = 0;
+
+    ComponentSet m_DragComponents;
+    ComponentSet m_Selection = makeComponentSet({});
 };
 
 inline CanvasController::CanvasController()
@@ -26,17 +54,105 @@ inline CanvasController::~CanvasController()
 {
 }
 
-inline auto CanvasController::handleCanvasEvent(std::unique_ptr<Event> event) -> std::vector<std::unique_ptr<Command>>
+inline void CanvasController::handleCanvasEvent(Event const& event, FrameArena& arena, std::pmr::vector<Command*>& commands)
+{
+    LOG_DEBUG_EVERY(Config::kLogIntervalMs, "CanvasController::handleCanvasEvent: event={}", toString(event));
+
+    std::visit(overloaded{
+        [&](UIDragDropEvent const& dragDropEvent)
+        {
+            // Off the simulation's lock, and usually already warmed while it was being dragged
+            const auto* prefab = PrefabLibrary::get().find(dragDropEvent.type);
+            push(arena.make<AddComponentCommand>(dragDropEvent.x, dragDropEvent.y, dragDropEvent.type, prefab), commands);
+        },
+        [&](UIDragStartedEvent const& dragStartedEvent)
+        {
+            if (dragStartedEvent.component == kInvalidComponentId)
+            {
+                return;
+            }
+
+            // Dragging any part of the selection drags all of it
+            beginTransaction();
+            if (std::ranges::binary_search(*m_Selection, dragStartedEvent.component))
+            {
+                m_DragComponents = m_Selection;
+            }
+            else
+            {
+                m_DragComponents = makeComponentSet({ dragStartedEvent.component });
+            }
+        },
+        [&](UIDragUpdateEvent const& dragUpdateEvent)
+        {
+            if (m_DragComponents)
+            {
+                push(arena.make<MoveComponentsCommand>(m_DragComponents, dragUpdateEvent.delta), commands);
+            }
+        },
+        [&](UIDragEndedEvent const&)
+        {
+            endTransaction();
+        },
+        [&](UIMouseClickEvent const&)
+        {
+            endTransaction();
+        },
+        [&](UISelectionChangedEvent const& selectionChangedEvent)
+        {
+            m_Selection = selectionChangedEvent.components;
+        },
+        [&](UIKeypressEvent const& keypressEvent)
+        {
+            if (!keypressEvent.ctrl && keypressEvent.val == 'C' && !m_Selection->empty())
+            {
+                endTransaction();
+                push(arena.make<MassConnectCommand>(*m_Selection), commands);
+            }
+            else if (keypressEvent.ctrl && keypressEvent.val == 'D' && !m_Selection->empty())
+            {
+                endTransaction();
+                push(arena.make<DuplicateComponentsCommand>(*m_Selection, Delta(Config::kDuplicateOffset, Config::kDuplicateOffset)), commands);
+            }
+            else if (keypressEvent.ctrl && keypressEvent.val == 'Z')
+            {
+                endTransaction();
+                push(arena.make<UndoCommand>(), commands);
+            }
+            else if (keypressEvent.ctrl && keypressEvent.val == 'Y')
+            {
+                endTransaction();
+                push(arena.make<RedoCommand>(), commands);
+            }
+        },
+    }, event);
+}
+
+inline void CanvasController::reset()
 {
-    spdlog::info("CanvasController::handleCanvasEvent: event={}", event->toString());
+    endTransaction();
+    m_Selection = makeComponentSet({});
+}
 
-    std::vector<std::unique_ptr<Command>> commands;
+inline auto CanvasController::beginTransaction() -> u64
+{
+    m_Transaction = m_NextTransaction++;
+    return m_Transaction;
+}
 
-    if (event->getName() == "UIDragDropEvent")
+inline void CanvasController::endTransaction()
+{
+    m_Transaction = 0;
+    m_DragComponents.reset();
+}
+
+inline void CanvasController::push(Command* command, std::pmr::vector<Command*>& commands)
+{
+    command->transaction = m_Transaction;
+    if (!commands.empty() && commands.back()->mergeWith(*command))
     {
-        auto* dragDropEvent = static_cast<UIDragDropEvent*>(event.get());
-        commands.push_back(std::make_unique<AddComponentCommand>(dragDropEvent->x, dragDropEvent->y, dragDropEvent->payload));
+        return;
     }
 
-    return commands;
+    commands.push_back(command);
 }
@@ -1,9 +1,32 @@
 #pragma once
 
+#include "config.h"
+#include "profiler.h"
 #include "simulation/circuit.h"
 #include "ui/renderers/window_renderer.h"
+#include "ui/spatial_index.h"
 
+#include <algorithm>
+#include <cmath>
 #include <memory>
+#include <optional>
+#include <utility>
+#include <vector>
+
+constexpr auto glyphFor(ComponentKind kind) -> Glyph
+{
+    switch (kind)
+    {
+        case ComponentKind::NAND:
+            return Glyph::NAND;
+        case ComponentKind::Node:
+            return Glyph::Node;
+        case ComponentKind::Clock:
+            return Glyph::Clock;
+    }
+
+    return Glyph::Box;
+}
 
 class CanvasViewModel final
 {
@@ -13,40 +36,58 @@ public:
     void draw(WindowRenderer* renderer);
     void update();
 
-    struct NANDViewModel final
+    // Flags a world-space area as needing a redraw, e.g. when a component moves or its net changes state
+    void markDirty(Position const& topLeft, Size const& size);
+
+    auto toScreen(Position const& world) const -> Position;
+    auto toWorld(Position const& screen) const -> Position;
+    auto visibleWorldRect() const -> std::pair<Position, Position>;
+
+    // The topmost component under a world-space point, or kInvalidComponentId
+    auto componentAt(Position const& world) const -> ComponentId;
+
+    // selection must be sorted
+    void setSelection(std::vector<ComponentId> const& selection);
+
+    // The rubber band shown while drag-selecting, between two world-space corners
+    void setSelectionBox(Position const& a, Position const& b);
+    void clearSelectionBox();
+
+    struct ComponentViewModel final
     {
-        u64      id;
-        Position position;
-        Size     size;
-        Facing   facing;
+        ComponentId   id;
+        ComponentKind kind;
+        Position      position;
+        Size          size;
+        Facing        facing;
 
         // TODO: Input/output states
-        // TODO: Connections: maybe do through wires?
 
         auto toString() const -> std::string
         {
-            return fmt::format("NANDViewModel: id={}, position={}, size={}, facing={}", id, ::toString(position), ::toString(size), ::toString(facing));
+            return fmt::format("ComponentViewModel: id={}, kind={}, position={}, size={}, facing={}", id, ::toString(kind), ::toString(position), ::toString(size), ::toString(facing));
         }
     };
 
-    struct NodeViewModel final
-    {
-        u64      id;
-        Position position;
-        Size     size;
-    };
-
+    // Coloured by the state of its net, which it's mapped back to through the node driving it
     struct WireViewModel final
     {
-        u64      id;
         Position start;
         Position end;
+        NodeId   from;
+        bool     high;
     };
 
-    // Base Components
-    std::vector<NANDViewModel> m_NANDs;
-    std::vector<NodeViewModel> m_Nodes;
-    std::vector<WireViewModel> m_Wires;
+    std::vector<ComponentViewModel> m_Components;
+    std::vector<WireViewModel>      m_Wires;
+
+    std::vector<ComponentId>                     m_Selection; // Sorted
+    std::optional<std::pair<Position, Position>> m_SelectionBox;
+
+    // Index m_Components and m_Wires by their bounding boxes. Rebuilt when components or wires come
+    // or go, and only updated for the ones that moved otherwise.
+    SpatialIndex m_SpatialIndex{ Config::kSpatialCellSize };
+    SpatialIndex m_WireIndex{ Config::kSpatialCellSize };
 
     Delta m_Offset = { 0.0f, 0.0f };
     f32   m_Zoom   = 1.0f;
@@ -55,6 +96,43 @@ public:
 
 private:
     CanvasViewModel(Circuit& circuit);
+
+    void drawRegion(WindowRenderer* renderer, Position const& visibleMin, Position const& visibleMax);
+    void drawDensityTiles(WindowRenderer* renderer, Position const& visibleMin, Position const& visibleMax);
+
+    auto pinPosition(NodeId node) const -> Position;
+
+    // Rebuilds every view model and both indexes, after components or wires came or went
+    void rebuild();
+
+    // Refreshes only the given components and the wires on their pins, after a move
+    void updateMoved(std::vector<ComponentId>& ids);
+
+    void buildComponentIndex();
+    void buildWireIndex();
+
+    // Picks up net state changes for the wires on screen, which happen without the revision changing
+    void updateWireStates();
+
+    void markWireDirty(WireViewModel const& wire);
+
+    static auto wireBox(WireViewModel const& wire) -> std::pair<Position, Size>;
+
+    // Past this many separate dirty areas it's cheaper to redraw everything
+    static constexpr usize kMaxDirtyRects = 256;
+
+    // Change tracking, so the renderer only redraws what changed since the last draw()
+    u64                                    m_CircuitRevision   = 0;
+    u64                                    m_StructureRevision = ~0ull; // So the first update rebuilds
+    Delta                                  m_DrawnOffset       = { 0.0f, 0.0f };
+    f32                                    m_DrawnZoom         = 1.0f;
+    bool                                   m_FullyDirty        = true;
+    std::vector<std::pair<Position, Size>> m_DirtyRects;
+
+    // The indices of the wires on each node, CSR-style, for finding the wires that follow a moved component
+    std::vector<u32> m_NodeWireStarts;
+    std::vector<u32> m_NodeWires;
+    std::vector<u32> m_MovedWires; // Kept between updates so a drag doesn't allocate each frame
 };
 
 inline std::unique_ptr<CanvasViewModel> CanvasViewModel::create(Circuit& circuit)
@@ -65,33 +143,147 @@ inline std::unique_ptr<CanvasViewModel> CanvasViewModel::create(Circuit& circuit
 // TODO: Drawing and creation should be seperate?
 inline void CanvasViewModel::draw(WindowRenderer* renderer)
 {
-    // TODO: Does it hide intent if I clear the canvas in here instead of outside?
+    PROFILE_SCOPE("CanvasViewModel::draw");
 
-    for (auto& nand : m_NANDs)
+    // Panning or zooming moves everything
+    if (m_Offset.dx != m_DrawnOffset.dx || m_Offset.dy != m_DrawnOffset.dy || m_Zoom != m_DrawnZoom)
     {
-        renderer->setColour(Colour::White);
-        renderer->drawNAND({ m_Offset.dx + nand.position.x * m_Zoom, m_Offset.dy + nand.position.y * m_Zoom }, { nand.size.width * m_Zoom, nand.size.height * m_Zoom }, nand.facing);
+        m_FullyDirty  = true;
+        m_DrawnOffset = m_Offset;
+        m_DrawnZoom   = m_Zoom;
     }
 
-    for (auto& node : m_Nodes)
+    if (m_FullyDirty)
     {
-        // renderer->setColour(Colour::White);
-        // renderer->drawRectangle({ node.position.x * m_Zoom, node.position.y * m_Zoom }, { node.size.width * m_Zoom, node.size.height * m_Zoom });
+        renderer->markCanvasDirty();
     }
+    else
+    {
+        for (auto const& [topLeft, size] : m_DirtyRects)
+        {
+            renderer->markCanvasDirty(toScreen(topLeft), { size.width * m_Zoom, size.height * m_Zoom });
+        }
+    }
+
+    m_FullyDirty = false;
+    m_DirtyRects.clear();
 
-    for (auto& wire : m_Wires)
+    renderer->redrawDirtyCanvas([&](Position const& topLeft, Size const& size)
     {
+        drawRegion(renderer, toWorld(topLeft), toWorld({ topLeft.x + size.width, topLeft.y + size.height }));
+    });
+}
+
+inline void CanvasViewModel::markDirty(Position const& topLeft, Size const& size)
+{
+    if (m_FullyDirty)
+    {
+        return;
+    }
+
+    if (m_DirtyRects.size() >= kMaxDirtyRects)
+    {
+        m_FullyDirty = true;
+        m_DirtyRects.clear();
+        return;
+    }
+
+    m_DirtyRects.emplace_back(topLeft, size);
+}
+
+// Draws everything overlapping the world-space rectangle [visibleMin, visibleMax]
+inline void CanvasViewModel::drawRegion(WindowRenderer* renderer, Position const& visibleMin, Position const& visibleMax)
+{
+
+    // Pick the level of detail from how big the components end up on screen
+    const auto componentScreenSize = m_SpatialIndex.maxItemSize().width * m_Zoom;
+    if (componentScreenSize < Config::kLodBoxMinSize)
+    {
+        drawDensityTiles(renderer, visibleMin, visibleMax);
+    }
+    else
+    {
+        const bool fullDetail = componentScreenSize >= Config::kLodFullDetailMinSize;
+
         renderer->setColour(Colour::White);
-        renderer->drawLine(wire.start, wire.end);
+        m_SpatialIndex.query(visibleMin, visibleMax, [&](u32 index)
+        {
+            auto const& component = m_Components[index];
+            const Size  size      = { component.size.width * m_Zoom, component.size.height * m_Zoom };
+            renderer->drawGlyph(fullDetail ? glyphFor(component.kind) : Glyph::Box, toScreen(component.position), size, component.facing);
+        });
+
+        if (!m_Selection.empty())
+        {
+            renderer->setColour(Colour::Yellow);
+            m_SpatialIndex.query(visibleMin, visibleMax, [&](u32 index)
+            {
+                auto const& component = m_Components[index];
+                if (std::ranges::binary_search(m_Selection, component.id))
+                {
+                    renderer->drawRectangle(toScreen(component.position), { component.size.width * m_Zoom, component.size.height * m_Zoom });
+                }
+            });
+        }
     }
 
-    // TODO: Selection box
-    // renderer->setColour(Colour::White);
-    // renderer->drawRectangle(node.position, node.size);
+    bool high = false;
+    renderer->setColour(Colour::White);
+    m_WireIndex.query(visibleMin, visibleMax, [&](u32 index)
+    {
+        auto const& wire = m_Wires[index];
+        if (wire.high != high)
+        {
+            high = wire.high;
+            renderer->setColour(high ? Colour::Green : Colour::White);
+        }
+        renderer->drawLine(toScreen(wire.start), toScreen(wire.end));
+    });
+
+    if (m_SelectionBox)
+    {
+        auto const& [min, max] = *m_SelectionBox;
+        renderer->setColour(Colour::Yellow);
+        renderer->drawRectangle(toScreen(min), { (max.x - min.x) * m_Zoom, (max.y - min.y) * m_Zoom });
+    }
 
     // TODO: Labels/Notes
 }
 
+// When zoomed far out, individual components are smaller than a pixel. Instead draw blocks
+// of spatial index cells, shaded by how densely packed they are.
+// TODO: Draw composite components as single boxes here once they exist
+inline void CanvasViewModel::drawDensityTiles(WindowRenderer* renderer, Position const& visibleMin, Position const& visibleMax)
+{
+    const auto cellScreenSize = m_SpatialIndex.cellSize() * m_Zoom;
+    const auto stride         = static_cast<usize>(std::ceil(Config::kLodDensityTileSize / cellScreenSize));
+    const auto itemSize       = m_SpatialIndex.maxItemSize();
+    const auto itemArea       = std::max(itemSize.width * itemSize.height, 1.0);
+
+    m_SpatialIndex.forEachDensityTile(visibleMin, visibleMax, stride, [&](Position const& tileMin, Size const& tileSize, usize count)
+    {
+        const auto coverage = static_cast<f64>(count) * itemArea / (tileSize.width * tileSize.height);
+        if (coverage < 0.05)
+        {
+            renderer->setColour(Colour::DarkGrey);
+        }
+        else if (coverage < 0.2)
+        {
+            renderer->setColour(Colour::Grey);
+        }
+        else if (coverage < 0.5)
+        {
+            renderer->setColour(Colour::LightGrey);
+        }
+        else
+        {
+            renderer->setColour(Colour::White);
+        }
+
+        renderer->fillRectangle(toScreen(tileMin), { tileSize.width * m_Zoom, tileSize.height * m_Zoom });
+    });
+}
+
 // TODO: Drawing and creation should be seperate?
 inline CanvasViewModel::CanvasViewModel(Circuit& circuit)
 : m_Circuit(circuit)
@@ -100,12 +292,300 @@ inline CanvasViewModel::CanvasViewModel(Circuit& circuit)
 
 inline void CanvasViewModel::update()
 {
-    u64 ids = 0;
-    for (auto& component : m_Circuit.components)
+    PROFILE_SCOPE("CanvasViewModel::update");
+
+    const u64 revision = m_Circuit.revision;
+    if (revision != m_CircuitRevision)
+    {
+        m_CircuitRevision = revision;
+
+        // A drag only moves things, which doesn't need everything looking at again
+        const u64 structureRevision = m_Circuit.structureRevision;
+        if (structureRevision != m_StructureRevision)
+        {
+            m_StructureRevision = structureRevision;
+            rebuild();
+        }
+        else
+        {
+            updateMoved(m_Circuit.movedComponents);
+        }
+        m_Circuit.movedComponents.clear();
+    }
+
+    updateWireStates();
+}
+
+inline void CanvasViewModel::rebuild()
+{
+    PROFILE_SCOPE("CanvasViewModel::rebuild");
+
+    // TODO: Have the circuit report what came and went rather than rebuilding and diffing
+    auto previous = std::move(m_Components);
+    m_Components.clear();
+    m_Components.reserve(m_Circuit.componentCount());
+
+    for (ComponentId id = 0; id < m_Circuit.componentCount(); ++id)
+    {
+        if (m_Circuit.alive[id])
+        {
+            const auto kind = m_Circuit.kinds[id];
+            m_Components.push_back({ id, kind, m_Circuit.positions[id], componentInfo(kind).size, m_Circuit.facings[id] });
+        }
+    }
+
+    // Anything that appeared, disappeared, or moved needs redrawing where it was and where it is
+    for (usize i = 0; i < std::max(previous.size(), m_Components.size()); ++i)
+    {
+        const bool hadOld = i < previous.size();
+        const bool hasNew = i < m_Components.size();
+        if (hadOld && hasNew && previous[i].id == m_Components[i].id &&
+            previous[i].position.x == m_Components[i].position.x && previous[i].position.y == m_Components[i].position.y &&
+            previous[i].facing == m_Components[i].facing)
+        {
+            continue;
+        }
+
+        if (hadOld)
+        {
+            markDirty(previous[i].position, previous[i].size);
+        }
+
+        if (hasNew)
+        {
+            markDirty(m_Components[i].position, m_Components[i].size);
+        }
+    }
+
+    auto previousWires = std::move(m_Wires);
+    m_Wires.clear();
+    m_Wires.reserve(m_Circuit.wires.size());
+    for (auto const& wire : m_Circuit.wires)
+    {
+        m_Wires.push_back({ pinPosition(wire.from), pinPosition(wire.to), wire.from, m_Circuit.nodeValue(wire.from) != 0 });
+    }
+
+    for (usize i = 0; i < std::max(previousWires.size(), m_Wires.size()); ++i)
+    {
+        const bool hadOld = i < previousWires.size();
+        const bool hasNew = i < m_Wires.size();
+        if (hadOld && hasNew &&
+            previousWires[i].start.x == m_Wires[i].start.x && previousWires[i].start.y == m_Wires[i].start.y &&
+            previousWires[i].end.x == m_Wires[i].end.x && previousWires[i].end.y == m_Wires[i].end.y &&
+            previousWires[i].high == m_Wires[i].high)
+        {
+            continue;
+        }
+
+        if (hadOld)
+        {
+            markWireDirty(previousWires[i]);
+        }
+
+        if (hasNew)
+        {
+            markWireDirty(m_Wires[i]);
+        }
+    }
+
+    // Counting sort of the wires by both of their ends
+    m_NodeWireStarts.assign(m_Circuit.nodeComponents.size() + 1, 0);
+    m_NodeWires.resize(m_Circuit.wires.size() * 2);
+    for (auto const& wire : m_Circuit.wires)
+    {
+        ++m_NodeWireStarts[wire.from + 1];
+        ++m_NodeWireStarts[wire.to + 1];
+    }
+
+    for (usize node = 1; node < m_NodeWireStarts.size(); ++node)
+    {
+        m_NodeWireStarts[node] += m_NodeWireStarts[node - 1];
+    }
+
+    std::vector<u32> cursors(m_NodeWireStarts.begin(), m_NodeWireStarts.end() - 1);
+    for (u32 i = 0; i < m_Circuit.wires.size(); ++i)
+    {
+        m_NodeWires[cursors[m_Circuit.wires[i].from]++] = i;
+        m_NodeWires[cursors[m_Circuit.wires[i].to]++]   = i;
+    }
+
+    buildComponentIndex();
+    buildWireIndex();
+}
+
+inline void CanvasViewModel::updateMoved(std::vector<ComponentId>& ids)
+{
+    PROFILE_SCOPE("CanvasViewModel::updateMoved");
+
+    // A drag moves the same components every frame, and each only needs refreshing once
+    std::ranges::sort(ids);
+    ids.erase(std::ranges::unique(ids).begin(), ids.end());
+
+    m_MovedWires.clear();
+    for (auto id : ids)
+    {
+        // m_Components is in id order. Components that aren't alive aren't shown.
+        const auto it = std::ranges::lower_bound(m_Components, id, {}, &ComponentViewModel::id);
+        if (it == m_Components.end() || it->id != id)
+        {
+            continue;
+        }
+
+        markDirty(it->position, it->size);
+        it->position = m_Circuit.positions[id];
+        markDirty(it->position, it->size);
+        m_SpatialIndex.update(static_cast<u32>(it - m_Components.begin()), it->position, it->size);
+
+        const auto firstNode = m_Circuit.firstNodes[id];
+        for (NodeId node = firstNode; node < firstNode + componentInfo(it->kind).nodeCount; ++node)
+        {
+            m_MovedWires.insert(m_MovedWires.end(), m_NodeWires.begin() + m_NodeWireStarts[node], m_NodeWires.begin() + m_NodeWireStarts[node + 1]);
+        }
+    }
+
+    // A wire between two moved components is listed under both
+    std::ranges::sort(m_MovedWires);
+    m_MovedWires.erase(std::ranges::unique(m_MovedWires).begin(), m_MovedWires.end());
+
+    for (auto index : m_MovedWires)
+    {
+        auto& wire = m_Wires[index];
+        markWireDirty(wire);
+        wire.start = pinPosition(m_Circuit.wires[index].from);
+        wire.end   = pinPosition(m_Circuit.wires[index].to);
+        markWireDirty(wire);
+
+        const auto [topLeft, size] = wireBox(wire);
+        m_WireIndex.update(index, topLeft, size);
+    }
+
+    if (m_SpatialIndex.needsRebuild())
+    {
+        buildComponentIndex();
+    }
+
+    if (m_WireIndex.needsRebuild())
+    {
+        buildWireIndex();
+    }
+}
+
+inline void CanvasViewModel::buildComponentIndex()
+{
+    m_SpatialIndex.build(m_Components.size(), [&](usize index)
+    {
+        return std::pair{ m_Components[index].position, m_Components[index].size };
+    });
+}
+
+inline void CanvasViewModel::buildWireIndex()
+{
+    m_WireIndex.build(m_Wires.size(), [&](usize index)
+    {
+        return wireBox(m_Wires[index]);
+    });
+}
+
+inline void CanvasViewModel::updateWireStates()
+{
+    const auto [visibleMin, visibleMax] = visibleWorldRect();
+    m_WireIndex.query(visibleMin, visibleMax, [&](u32 index)
+    {
+        auto&      wire = m_Wires[index];
+        const bool high = m_Circuit.nodeValue(wire.from) != 0;
+        if (high != wire.high)
+        {
+            wire.high = high;
+            markWireDirty(wire);
+        }
+    });
+}
+
+inline void CanvasViewModel::markWireDirty(WireViewModel const& wire)
+{
+    const auto [topLeft, size] = wireBox(wire);
+    markDirty(topLeft, { size.width + 1.0, size.height + 1.0 });
+}
+
+inline auto CanvasViewModel::wireBox(WireViewModel const& wire) -> std::pair<Position, Size>
+{
+    const Position topLeft = { std::min(wire.start.x, wire.end.x), std::min(wire.start.y, wire.end.y) };
+    return { topLeft, { std::abs(wire.end.x - wire.start.x), std::abs(wire.end.y - wire.start.y) } };
+}
+
+inline auto CanvasViewModel::componentAt(Position const& world) const -> ComponentId
+{
+    ComponentId hit = kInvalidComponentId;
+    m_SpatialIndex.query(world, world, [&](u32 index)
     {
-        if (auto* nandGate = dynamic_cast<NandGate*>(component))
+        // Later components are drawn on top
+        if (hit == kInvalidComponentId || m_Components[index].id > hit)
         {
-            m_NANDs.push_back({ ids++, nandGate->position, { 100, 100 }, Facing::Right });
+            hit = m_Components[index].id;
+        }
+    });
+
+    return hit;
+}
+
+inline void CanvasViewModel::setSelection(std::vector<ComponentId> const& selection)
+{
+    // Redraw around everything whose highlight is appearing or disappearing
+    for (auto const& component : m_Components)
+    {
+        if (std::ranges::binary_search(m_Selection, component.id) != std::ranges::binary_search(selection, component.id))
+        {
+            markDirty(component.position, component.size);
         }
     }
+
+    m_Selection = selection;
+}
+
+inline void CanvasViewModel::setSelectionBox(Position const& a, Position const& b)
+{
+    clearSelectionBox();
+
+    const Position min = { std::min(a.x, b.x), std::min(a.y, b.y) };
+    const Position max = { std::max(a.x, b.x), std::max(a.y, b.y) };
+    m_SelectionBox     = { min, max };
+    markDirty(min, { max.x - min.x + 1.0, max.y - min.y + 1.0 });
+}
+
+inline void CanvasViewModel::clearSelectionBox()
+{
+    if (m_SelectionBox)
+    {
+        auto const& [min, max] = *m_SelectionBox;
+        markDirty(min, { max.x - min.x + 1.0, max.y - min.y + 1.0 });
+        m_SelectionBox.reset();
+    }
+}
+
+// Where a pin sits in world space, following its component's facing
+inline auto CanvasViewModel::pinPosition(NodeId node) const -> Position
+{
+    const auto id       = m_Circuit.nodeComponents[node];
+    const auto kind     = m_Circuit.kinds[id];
+    const auto position = m_Circuit.positions[id];
+    const auto size     = componentInfo(kind).size;
+    const auto pin      = componentInfo(kind).pins[node - m_Circuit.firstNodes[id]];
+    const auto [x, y]   = facingTransform(m_Circuit.facings[id], pin.x, pin.y);
+
+    return { position.x + size.width * x, position.y + size.height * y };
+}
+
+inline auto CanvasViewModel::toScreen(Position const& world) const -> Position
+{
+    return { m_Offset.dx + world.x * m_Zoom, m_Offset.dy + world.y * m_Zoom };
+}
+
+inline auto CanvasViewModel::toWorld(Position const& screen) const -> Position
+{
+    return { (screen.x - m_Offset.dx) / m_Zoom, (screen.y - m_Offset.dy) / m_Zoom };
+}
+
+inline auto CanvasViewModel::visibleWorldRect() const -> std::pair<Position, Position>
+{
+    return { toWorld({ 0.0, 0.0 }), toWorld({ Config::kCanvasWidth, Config::kCanvasHeight }) };
 }
@@ -1,14 +1,33 @@
 #pragma once
 
+#include "ui/events/ui_drag_drop_event.h"
+#include "ui/events/ui_drag_ended_event.h"
+#include "ui/events/ui_drag_started_event.h"
+#include "ui/events/ui_drag_update_event.h"
+#include "ui/events/ui_keypress_event.h"
+#include "ui/events/ui_mouse_click_event.h"
+#include "ui/events/ui_selection_changed_event.h"
+
 #include <string>
+#include <variant>
 
 // An event is a higher-level message made up of and triggered by actions and combined state to capture
 // more complex user interactions.
 // Actions are processed to generate events that represent higher-level interactions.
-struct Event
-{
-    virtual ~Event() = default;
+// Events are a closed set, stored by value and dispatched with std::visit.
+using Event = std::variant<
+    UIDragDropEvent,
+    UIDragEndedEvent,
+    UIDragStartedEvent,
+    UIDragUpdateEvent,
+    UIKeypressEvent,
+    UIMouseClickEvent,
+    UISelectionChangedEvent>;
 
-    virtual auto getName() const -> std::string = 0;
-    virtual auto toString() const -> std::string = 0;
-};
+inline auto toString(Event const& event) -> std::string
+{
+    return std::visit([](auto const& alternative)
+    {
+        return alternative.toString();
+    }, event);
+}
@@ -1,38 +1,29 @@
 #pragma once
 
+#include "simulation/components/component_registry.h"
 #include "types.h"
-#include "ui/events/event.h"
 
 #include <fmt/format.h>
+#include <string>
 
-struct UIDragDropEvent final : public Event
+struct UIDragDropEvent final
 {
-    UIDragDropEvent(f32 x, f32 y, std::string payload);
-    ~UIDragDropEvent();
+    UIDragDropEvent(f32 x, f32 y, ComponentType type);
 
-    auto getName() const -> std::string override
+    auto toString() const -> std::string
     {
-        return "UIDragDropEvent";
-    }
-
-    auto toString() const -> std::string override
-    {
-        return fmt::format("UIDragDropEvent: x={}, y={}, payload={}", x, y, payload);
+        return fmt::format("UIDragDropEvent: x={}, y={}, type={}", x, y, ::toString(type));
     }
 
     // private:
-    f32         x;
-    f32         y;
-    std::string payload;
+    f32           x;
+    f32           y;
+    ComponentType type;
 };
 
-inline UIDragDropEvent::UIDragDropEvent(f32 x, f32 y, std::string payload)
+inline UIDragDropEvent::UIDragDropEvent(f32 x, f32 y, ComponentType type)
 : x(x)
 , y(y)
-, payload(std::move(payload))
-{
-}
-
-inline UIDragDropEvent::~UIDragDropEvent()
+, type(type)
 {
 }
@@ -1,32 +1,20 @@
 #pragma once
 
 #include "types.h"
-#include "ui/events/event.h"
 
 #include <fmt/format.h>
+#include <string>
 
-struct UIDragEndedEvent final : public Event
+struct UIDragEndedEvent final
 {
     UIDragEndedEvent();
-    ~UIDragEndedEvent();
 
-    auto getName() const -> std::string override
-    {
-        return "UIDragEndedEvent";
-    }
-
-    auto toString() const -> std::string override
+    auto toString() const -> std::string
     {
         return fmt::format("UIDragEndedEvent");
     }
-
-private:
 };
 
 inline UIDragEndedEvent::UIDragEndedEvent()
 {
 }
-
-inline UIDragEndedEvent::~UIDragEndedEvent()
-{
-}
@@ -1,32 +1,27 @@
 #pragma once
 
+#include "simulation/components/component.h"
 #include "types.h"
-#include "ui/events/event.h"
 
 #include <fmt/format.h>
+#include <string>
 
-struct UIDragStartedEvent final : public Event
+struct UIDragStartedEvent final
 {
-    UIDragStartedEvent();
-    ~UIDragStartedEvent();
+    UIDragStartedEvent(Position position, ComponentId component);
 
-    auto getName() const -> std::string override
+    auto toString() const -> std::string
     {
-        return "UIDragStartedEvent";
+        return fmt::format("UIDragStartedEvent: position={}, component={}", ::toString(position), component);
     }
 
-    auto toString() const -> std::string override
-    {
-        return fmt::format("UIDragStartedEvent");
-    }
-
-private:
+    // private:
+    Position    position;  // World space
+    ComponentId component; // Under the cursor when the drag started, or kInvalidComponentId
 };
 
-inline UIDragStartedEvent::UIDragStartedEvent()
-{
-}
-
-inline UIDragStartedEvent::~UIDragStartedEvent()
+inline UIDragStartedEvent::UIDragStartedEvent(Position position, ComponentId component)
+: position(position)
+, component(component)
 {
 }
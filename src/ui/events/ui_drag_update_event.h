@@ -1,32 +1,24 @@
 #pragma once
 
 #include "types.h"
-#include "ui/events/event.h"
 
 #include <fmt/format.h>
+#include <string>
 
-struct UIDragUpdateEvent final : public Event
+struct UIDragUpdateEvent final
 {
-    UIDragUpdateEvent();
-    ~UIDragUpdateEvent();
+    explicit UIDragUpdateEvent(Delta delta);
 
-    auto getName() const -> std::string override
+    auto toString() const -> std::string
     {
-        return "UIDragUpdateEvent";
+        return fmt::format("UIDragUpdateEvent: delta={}", ::toString(delta));
     }
 
-    auto toString() const -> std::string override
-    {
-        return fmt::format("UIDragUpdateEvent");
-    }
-
-private:
+    // private:
+    Delta delta; // World space, since the last update
 };
 
-inline UIDragUpdateEvent::UIDragUpdateEvent()
-{
-}
-
-inline UIDragUpdateEvent::~UIDragUpdateEvent()
+inline UIDragUpdateEvent::UIDragUpdateEvent(Delta delta)
+: delta(delta)
 {
 }
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "types.h"
+
+#include <fmt/format.h>
+#include <string>
+
+struct UIKeypressEvent final
+{
+    UIKeypressEvent(u32 val, bool ctrl);
+
+    auto toString() const -> std::string
+    {
+        return fmt::format("UIKeypressEvent: val={}, ctrl={}", val, ctrl);
+    }
+
+    // private:
+    u32  val;
+    bool ctrl;
+};
+
+inline UIKeypressEvent::UIKeypressEvent(u32 val, bool ctrl)
+: val(val)
+, ctrl(ctrl)
+{
+}
@@ -1,32 +1,20 @@
 #pragma once
 
 #include "types.h"
-#include "ui/events/event.h"
 
 #include <fmt/format.h>
+#include <string>
 
-struct UIMouseClickEvent final : public Event
+struct UIMouseClickEvent final
 {
     UIMouseClickEvent();
-    ~UIMouseClickEvent();
 
-    auto getName() const -> std::string override
-    {
-        return "UIMouseClickEvent";
-    }
-
-    auto toString() const -> std::string override
+    auto toString() const -> std::string
     {
         return fmt::format("UIMouseClickEvent");
     }
-
-private:
 };
 
 inline UIMouseClickEvent::UIMouseClickEvent()
 {
 }
-
-inline UIMouseClickEvent::~UIMouseClickEvent()
-{
-}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "simulation/components/component.h"
+#include "types.h"
+
+#include <fmt/format.h>
+#include <string>
+
+struct UISelectionChangedEvent final
+{
+    explicit UISelectionChangedEvent(ComponentSet components);
+
+    auto toString() const -> std::string
+    {
+        return fmt::format("UISelectionChangedEvent: count={}", components->size());
+    }
+
+    // private:
+    ComponentSet components;
+};
+
+inline UISelectionChangedEvent::UISelectionChangedEvent(ComponentSet components)
+: components(std::move(components))
+{
+}
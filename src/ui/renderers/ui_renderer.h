@@ -7,18 +7,16 @@
 #include "window_renderer.h"
 
 #include "applog_sink.h"
+#include "frame_arena.h"
+#include "profiler.h"
 
+#include "simulation/components/component_registry.h"
+#include "simulation/sim_metrics.h"
 #include "ui/actions/action.h"
-#include "ui/actions/ui_canvas_hovered_action.h"
-#include "ui/actions/ui_close_requested_action.h"
-#include "ui/actions/ui_drag_drop_action.h"
-#include "ui/actions/ui_keypress_action.h"
-#include "ui/actions/ui_mouse_down_action.h"
-#include "ui/actions/ui_mouse_moved_action.h"
-#include "ui/actions/ui_mouse_up_action.h"
-#include "ui/actions/ui_mouse_wheel_action.h"
-#include "ui/actions/ui_sim_control_action.h"
 
+#include <memory_resource>
+#include <optional>
+#include <string>
 #include <vector>
 
 class UIRenderer final
@@ -29,16 +27,40 @@ public:
 
     void handleEvent(SDL_Event const& event);
     void clear();
-    auto draw() -> std::vector<std::unique_ptr<Action>>;
+    // Appends this frame's user input to actions
+    void draw(std::pmr::vector<Action>& actions);
+
+    void setFrameArenaStats(FrameArena::Stats const& stats);
+    // Rates are worked out from the difference to an earlier snapshot, refreshed every kSimRateInterval
+    void setSimMetrics(SimMetrics::Snapshot const& snapshot);
+    // Shows a progress bar while a circuit is loading in the background, nullopt hides it
+    void setLoadProgress(std::optional<f32> progress);
     void present();
 
 private:
+    // Scope timings per thread, and a flame-style breakdown of the latest top-level scope
+    void drawProfiler();
+    void drawFlame(std::vector<Profiler::Sample> const& samples);
+
+    // ImGui drag n' drop payload type for components dragged out of the left panel
+    static constexpr auto kComponentPayload = "COMPONENT";
+
+    static constexpr f64 kSimRateInterval = 0.5; // Seconds
+
     WindowRenderer* m_WindowRenderer;
 
     // State
     bool m_IsHoveringCanvas = false;
     bool m_IsMouseDown      = false;
     f32  m_MouseWheel       = 0.0f;
+
+    std::optional<f32> m_LoadProgress;
+
+    // Stats
+    FrameArena::Stats    m_FrameArenaStats;
+    SimMetrics::Snapshot m_SimMetrics;
+    SimMetrics::Snapshot m_SimMetricsAtLastRate;
+    SimMetrics::Rates    m_SimRates;
 };
 
 inline UIRenderer::UIRenderer(WindowRenderer* windowRenderer)
@@ -83,10 +105,28 @@ inline void UIRenderer::clear()
     ImGui::NewFrame();
 }
 
-inline auto UIRenderer::draw() -> std::vector<std::unique_ptr<Action>>
+inline void UIRenderer::setFrameArenaStats(FrameArena::Stats const& stats)
+{
+    m_FrameArenaStats = stats;
+}
+
+inline void UIRenderer::setSimMetrics(SimMetrics::Snapshot const& snapshot)
 {
-    std::vector<std::unique_ptr<Action>> actions;
+    m_SimMetrics = snapshot;
+    if (snapshot.seconds - m_SimMetricsAtLastRate.seconds >= kSimRateInterval)
+    {
+        m_SimRates             = SimMetrics::rates(m_SimMetricsAtLastRate, snapshot);
+        m_SimMetricsAtLastRate = snapshot;
+    }
+}
+
+inline void UIRenderer::setLoadProgress(std::optional<f32> progress)
+{
+    m_LoadProgress = progress;
+}
 
+inline void UIRenderer::draw(std::pmr::vector<Action>& actions)
+{
     auto& io            = ImGui::GetIO();
     io.WantCaptureMouse = true;
 
@@ -109,7 +149,7 @@ inline auto UIRenderer::draw() -> std::vector<std::unique_ptr<Action>>
             {
                 if (ImGui::MenuItem("Close", "Ctrl+W"))
                 {
-                    actions.push_back(std::make_unique<UICloseRequestedAction>());
+                    actions.emplace_back(UICloseRequestedAction());
                 }
                 ImGui::EndMenu();
             }
@@ -123,12 +163,17 @@ inline auto UIRenderer::draw() -> std::vector<std::unique_ptr<Action>>
 
             ImGui::Separator();
 
-            const auto defineDragNDropButtonFn = [&](const char* label, const char* payload)
+            // The payload is the ComponentType itself, so dropping never has to look anything up by name
+            const auto defineDragNDropButtonFn = [&](ComponentType type)
             {
-                ImGui::Button(label, ImVec2(50, 50));
+                const auto label = std::string(componentTypeInfo(type).name);
+                ImGui::Button(label.c_str(), ImVec2(50, 50));
                 if (ImGui::BeginDragDropSource(ImGuiDragDropFlags_AcceptNoDrawDefaultRect))
                 {
-                    ImGui::SetDragDropPayload(payload, payload, sizeof(payload));
+                    ImGui::SetDragDropPayload(kComponentPayload, &type, sizeof(type));
+
+                    // Get a library prefab ready while it's in flight, so dropping it is quick
+                    PrefabLibrary::get().warm(type);
 
                     // Preview tooltip
                     ImGui::Text("Drag and drop me!");
@@ -137,14 +182,27 @@ inline auto UIRenderer::draw() -> std::vector<std::unique_ptr<Action>>
                 }
             };
 
-            defineDragNDropButtonFn("NAND", "NAND");
-            // Break
-            defineDragNDropButtonFn("Node", "NODE");
-            // Break
-            defineDragNDropButtonFn("CLK", "CLK");
-            // Break
+            for (usize type = 0; type < kComponentTypeCount; ++type)
+            {
+                if (kComponentTypes[type].isPrimitive())
+                {
+                    defineDragNDropButtonFn(static_cast<ComponentType>(type));
+                }
+            }
             ImGui::Separator();
 
+            // Library components, built from NANDs on first use
+            if (ImGui::CollapsingHeader("Library"))
+            {
+                for (usize type = 0; type < kComponentTypeCount; ++type)
+                {
+                    if (!kComponentTypes[type].isPrimitive())
+                    {
+                        defineDragNDropButtonFn(static_cast<ComponentType>(type));
+                    }
+                }
+            }
+
             ImGui::EndChild();
         }
 
@@ -158,34 +216,67 @@ inline auto UIRenderer::draw() -> std::vector<std::unique_ptr<Action>>
                 {
                     if (ImGui::Button("Step"))
                     {
-                        actions.push_back(std::make_unique<UISimControlAction>(SimControl::Step));
+                        actions.emplace_back(UISimControlAction(SimControl::Step));
                     }
                     ImGui::SameLine();
 
                     if (ImGui::Button("Run"))
                     {
-                        actions.push_back(std::make_unique<UISimControlAction>(SimControl::Run));
+                        actions.emplace_back(UISimControlAction(SimControl::Run));
                     }
                     ImGui::SameLine();
 
                     if (ImGui::Button("Stop"))
                     {
-                        actions.push_back(std::make_unique<UISimControlAction>(SimControl::Stop));
+                        actions.emplace_back(UISimControlAction(SimControl::Stop));
                     }
                     ImGui::SameLine();
 
                     if (ImGui::Button("Zoom +"))
                     {
-                        actions.push_back(std::make_unique<UIMouseWheelAction>(1.0f));
+                        actions.emplace_back(UIMouseWheelAction(1.0f));
                     }
                     ImGui::SameLine();
 
                     if (ImGui::Button("Zoom -"))
                     {
-                        actions.push_back(std::make_unique<UIMouseWheelAction>(-1.0f));
+                        actions.emplace_back(UIMouseWheelAction(-1.0f));
+                    }
+                    ImGui::SameLine();
+
+                    if (ImGui::Button("Save"))
+                    {
+                        actions.emplace_back(UISaveCircuitAction(CircuitFormat::Binary));
+                    }
+                    ImGui::SameLine();
+
+                    if (ImGui::Button("Open"))
+                    {
+                        actions.emplace_back(UILoadCircuitAction(CircuitFormat::Binary));
+                    }
+                    ImGui::SameLine();
+
+                    if (ImGui::Button("Save JSON"))
+                    {
+                        actions.emplace_back(UISaveCircuitAction(CircuitFormat::Json));
+                    }
+                    ImGui::SameLine();
+
+                    // Loads in the background, showing progress until it's done
+                    ImGui::BeginDisabled(m_LoadProgress.has_value());
+                    if (ImGui::Button("Open JSON"))
+                    {
+                        actions.emplace_back(UILoadCircuitAction(CircuitFormat::Json));
                     }
+                    ImGui::EndDisabled();
                     ImGui::SameLine();
 
+                    if (m_LoadProgress)
+                    {
+                        ImGui::ProgressBar(*m_LoadProgress, ImVec2(120.0f, 0.0f));
+                        ImGui::SameLine();
+                    }
+
                     /*
                     if (ImGui::Button("<"))
                     {
@@ -253,21 +344,21 @@ inline auto UIRenderer::draw() -> std::vector<std::unique_ptr<Action>>
                     if (!m_IsHoveringCanvas && isHoveringCanvas)
                     {
                         m_IsHoveringCanvas = true;
-                        actions.push_back(std::make_unique<UICanvasHoveredAction>());
+                        actions.emplace_back(UICanvasHoveredAction());
                     }
                     else if (m_IsHoveringCanvas && !isHoveringCanvas)
                     {
                         m_IsHoveringCanvas = false;
                         m_IsMouseDown      = false;
-                        actions.push_back(std::make_unique<UICanvasHoveredAction>());
+                        actions.emplace_back(UICanvasHoveredAction());
                     }
 
                     if (ImGui::BeginDragDropTarget())
                     {
                         // This is the only UI -> Canvas interaction!
-                        if (const ImGuiPayload* payload = ImGui::AcceptDragDropPayload(nullptr))
+                        if (const ImGuiPayload* payload = ImGui::AcceptDragDropPayload(kComponentPayload))
                         {
-                            actions.push_back(std::make_unique<UIDragDropAction>(canvasX, canvasY, (const char*)payload->Data));
+                            actions.emplace_back(UIDragDropAction(canvasX, canvasY, *static_cast<ComponentType const*>(payload->Data)));
                         }
 
                         ImGui::EndDragDropTarget();
@@ -290,6 +381,29 @@ inline auto UIRenderer::draw() -> std::vector<std::unique_ptr<Action>>
         ImGui::BeginChild("Right", ImVec2(0, 0), ImGuiChildFlags_Border);
         {
             // TODO: Draw stats & tables for components, gates, nodes, selection, etc.
+            ImGui::Text("Frame arena");
+            ImGui::Separator();
+            ImGui::Text("Allocations: %zu", m_FrameArenaStats.allocations);
+            ImGui::Text("Bytes: %zu", m_FrameArenaStats.bytes);
+            ImGui::Text("Heap allocations: %zu", m_FrameArenaStats.heapAllocations);
+
+            ImGui::Dummy(ImVec2(0.0f, ImGui::GetTextLineHeight()));
+            ImGui::Text("Simulation");
+            ImGui::Separator();
+            ImGui::Text("Steps/s: %.0f", m_SimRates.stepsPerSecond);
+            ImGui::Text("Gate evaluations/s: %.0f", m_SimRates.gateEvaluationsPerSecond);
+            ImGui::Text("Events/step: %.2f", m_SimRates.eventsPerStep);
+            ImGui::Text("Worklist high-water: %llu", static_cast<unsigned long long>(m_SimMetrics.worklistHighWater));
+            ImGui::Text("Command queue: %llu (max %llu)", static_cast<unsigned long long>(m_SimMetrics.queueDepth), static_cast<unsigned long long>(m_SimMetrics.queueHighWater));
+            ImGui::Text("Lock wait, sim: %.2f ms/s", m_SimRates.simLockWaitMsPerSecond);
+            ImGui::Text("Lock wait, UI: %.2f ms/s", m_SimRates.uiLockWaitMsPerSecond);
+            if (ImGui::Button("Dump JSON"))
+            {
+                actions.emplace_back(UIDumpMetricsAction());
+            }
+
+            ImGui::Dummy(ImVec2(0.0f, ImGui::GetTextLineHeight()));
+            drawProfiler();
             ImGui::EndChild();
         }
 
@@ -304,47 +418,61 @@ inline auto UIRenderer::draw() -> std::vector<std::unique_ptr<Action>>
     {
         if (validPosition && hasMoved)
         {
-            actions.push_back(std::make_unique<UIMouseMovedAction>(canvasX, canvasY, mouseDelta.x, mouseDelta.y));
+            actions.emplace_back(UIMouseMovedAction(canvasX, canvasY, mouseDelta.x, mouseDelta.y));
         }
 
         const bool isMouseDown = ImGui::IsMouseDown(ImGuiMouseButton_Left);
         if (m_IsMouseDown && !isMouseDown)
         {
             m_IsMouseDown = false;
-            actions.push_back(std::make_unique<UIMouseUpAction>());
+            actions.emplace_back(UIMouseUpAction());
         }
         else if (!m_IsMouseDown && isMouseDown)
         {
             m_IsMouseDown = true;
-            actions.push_back(std::make_unique<UIMouseDownAction>());
+            actions.emplace_back(UIMouseDownAction(io.KeyShift));
         }
 
         // TODO: Why isn't this working?
         if (io.MouseWheel != 0.0f)
         {
-            actions.push_back(std::make_unique<UIMouseWheelAction>(io.MouseWheel));
+            actions.emplace_back(UIMouseWheelAction(io.MouseWheel));
         }
 
         // TODO: After interacting with the Canvas this doesn't work reliably
         if (ImGui::IsKeyPressed(ImGuiKey_Escape))
         {
-            actions.push_back(std::make_unique<UICloseRequestedAction>());
+            actions.emplace_back(UICloseRequestedAction());
         }
 
         if (ImGui::IsKeyPressed(ImGuiKey_R))
         {
-            actions.push_back(std::make_unique<UIKeypressAction>('R'));
+            actions.emplace_back(UIKeypressAction('R'));
+        }
+
+        // Once per press, a held key would connect the same selection over and over
+        if (!io.KeyCtrl && ImGui::IsKeyPressed(ImGuiKey_C, false))
+        {
+            actions.emplace_back(UIKeypressAction('C'));
+        }
+
+        if (io.KeyCtrl && ImGui::IsKeyPressed(ImGuiKey_Z))
+        {
+            actions.emplace_back(UIKeypressAction('Z', true));
         }
 
-        if (ImGui::IsKeyPressed(ImGuiKey_C))
+        if (io.KeyCtrl && ImGui::IsKeyPressed(ImGuiKey_Y))
         {
-            actions.push_back(std::make_unique<UIKeypressAction>('C'));
+            actions.emplace_back(UIKeypressAction('Y', true));
+        }
+
+        if (io.KeyCtrl && ImGui::IsKeyPressed(ImGuiKey_D))
+        {
+            actions.emplace_back(UIKeypressAction('D', true));
         }
     }
 
     // TODO: Handle the mouse exiting the canvas during a drag - emitting a mouse-up action
-
-    return actions;
 }
 
 inline void UIRenderer::present()
@@ -357,3 +485,124 @@ inline void UIRenderer::present()
     SDL_RenderSetScale(m_WindowRenderer->sdlRenderer(), io.DisplayFramebufferScale.x, io.DisplayFramebufferScale.y);
     ImGui_ImplSDLRenderer2_RenderDrawData(ImGui::GetDrawData());
 }
+
+inline void UIRenderer::drawProfiler()
+{
+    ImGui::Text("Profiler");
+    ImGui::Separator();
+
+    auto& profiler = Profiler::get();
+    if (profiler.writingTrace())
+    {
+        ImGui::Text("Writing %s...", Config::kTracePath);
+    }
+    else if (Profiler::tracing())
+    {
+        if (ImGui::Button("Stop trace"))
+        {
+            profiler.stopTrace(Config::kTracePath);
+        }
+    }
+    else if (ImGui::Button("Record trace"))
+    {
+        profiler.startTrace();
+    }
+
+    bool enabled = Profiler::enabled();
+    if (ImGui::Checkbox("Enabled", &enabled))
+    {
+        Profiler::setEnabled(enabled);
+    }
+
+    if (!enabled)
+    {
+        return;
+    }
+
+    profiler.collect();
+
+    for (auto const& thread : profiler.threads())
+    {
+        if (!ImGui::CollapsingHeader(thread.name.c_str(), ImGuiTreeNodeFlags_DefaultOpen))
+        {
+            continue;
+        }
+
+        ImGui::PushID(thread.name.c_str());
+        if (ImGui::BeginTable("Stats", 4, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingFixedFit))
+        {
+            ImGui::TableSetupColumn("Scope");
+            ImGui::TableSetupColumn("Min ms");
+            ImGui::TableSetupColumn("Mean ms");
+            ImGui::TableSetupColumn("p99 ms");
+            ImGui::TableHeadersRow();
+
+            for (auto const& stats : thread.stats)
+            {
+                ImGui::TableNextRow();
+                ImGui::TableNextColumn();
+                ImGui::Text("%*s%s", static_cast<int>(stats.depth * 2), "", stats.name);
+                ImGui::TableNextColumn();
+                ImGui::Text("%.3f", stats.minMs);
+                ImGui::TableNextColumn();
+                ImGui::Text("%.3f", stats.meanMs);
+                ImGui::TableNextColumn();
+                ImGui::Text("%.3f", stats.p99Ms);
+            }
+            ImGui::EndTable();
+        }
+
+        drawFlame(thread.lastFrame);
+        ImGui::PopID();
+    }
+}
+
+inline void UIRenderer::drawFlame(std::vector<Profiler::Sample> const& samples)
+{
+    if (samples.empty())
+    {
+        return;
+    }
+
+    // Sorted by start time, so the enclosing top-level scope comes first
+    auto const& root = samples.front();
+
+    u32 maxDepth = 0;
+    for (auto const& sample : samples)
+    {
+        maxDepth = std::max(maxDepth, sample.depth);
+    }
+
+    const ImVec2 origin    = ImGui::GetCursorScreenPos();
+    const f32    width     = ImGui::GetContentRegionAvail().x;
+    const f32    rowHeight = ImGui::GetTextLineHeightWithSpacing();
+    const f64    scale     = width / static_cast<f64>(std::max<u64>(root.end - root.start, 1));
+
+    static constexpr std::array<ImU32, 4> kColours = {
+        IM_COL32(200, 90, 60, 255),
+        IM_COL32(210, 140, 60, 255),
+        IM_COL32(190, 170, 70, 255),
+        IM_COL32(120, 160, 80, 255),
+    };
+
+    auto* drawList = ImGui::GetWindowDrawList();
+    for (auto const& sample : samples)
+    {
+        const f32    x   = origin.x + static_cast<f32>((sample.start - root.start) * scale);
+        const f32    y   = origin.y + sample.depth * rowHeight;
+        const ImVec2 min = ImVec2(x, y);
+        const ImVec2 max = ImVec2(x + std::max(static_cast<f32>((sample.end - sample.start) * scale), 1.0f), y + rowHeight - 1.0f);
+
+        drawList->AddRectFilled(min, max, kColours[sample.depth % kColours.size()]);
+        drawList->PushClipRect(min, max, true);
+        drawList->AddText(ImVec2(min.x + 2.0f, min.y), IM_COL32(255, 255, 255, 255), sample.name);
+        drawList->PopClipRect();
+
+        if (ImGui::IsMouseHoveringRect(min, max))
+        {
+            ImGui::SetTooltip("%s: %.3f ms", sample.name, (sample.end - sample.start) / 1e6);
+        }
+    }
+
+    ImGui::Dummy(ImVec2(width, (maxDepth + 1) * rowHeight));
+}
@@ -3,14 +3,35 @@
 #include "config.h"
 #include "types.h"
 
+#include <array>
+#include <bitset>
+#include <cmath>
 #include <memory>
+#include <numbers>
 #include <optional>
 #include <stack>
+#include <tuple>
+#include <utility>
 #include <vector>
 
 #include <SDL.h>
 #include <imgui.h>
 
+namespace detail
+{
+    constexpr usize kCanvasTilesX = static_cast<usize>((Config::kCanvasWidth + Config::kCanvasTileSize - 1.0f) / Config::kCanvasTileSize);
+    constexpr usize kCanvasTilesY = static_cast<usize>((Config::kCanvasHeight + Config::kCanvasTileSize - 1.0f) / Config::kCanvasTileSize);
+} // namespace detail
+
+// Sprites that are pre-rendered into the glyph atlas, for every Facing and a few sizes
+enum class Glyph
+{
+    NAND,
+    Node,
+    Clock,
+    Box,
+};
+
 class WindowRenderer final
 {
 public:
@@ -24,24 +45,196 @@ public:
 
     void drawLine(const Position& start, const Position& end);
     void drawRectangle(const Position& topLeft, const Size& size);
+    void fillRectangle(const Position& topLeft, const Size& size);
     void drawCircle(const Position& center, f64 radius);
     void drawNAND(const Position& topLeft, const Size& size, Facing facing);
+    void drawGlyph(Glyph glyph, const Position& topLeft, const Size& size, Facing facing);
 
     void setColour(Colour colour);
     void setDrawToCanvas();
     void setDrawToScreen();
 
+    // Submits everything queued by the draw* calls so far
+    void flush();
+
+    // The canvas texture is kept between frames, and only the tiles marked dirty are redrawn.
+    // drawRegion(topLeft, size) is called with the canvas clipped to and cleared over each dirty region.
+    void markCanvasDirty();
+    void markCanvasDirty(const Position& topLeft, const Size& size);
+    template <typename Fn>
+    void redrawDirtyCanvas(Fn&& drawRegion);
+
     auto sdlWindow() -> SDL_Window*;
     auto sdlRenderer() -> SDL_Renderer*;
     auto sdlCanvasTexture() -> SDL_Texture*;
 
 private:
+    void pushQuad(SDL_FPoint a, SDL_FPoint b, SDL_FPoint c, SDL_FPoint d);
+    void pushQuad(std::array<SDL_FPoint, 4> const& points, std::array<SDL_FPoint, 4> const& texCoords);
+    void drawGlyphGeometry(Glyph glyph, const Position& topLeft, const Size& size, Facing facing);
+    void buildGlyphAtlas();
+
     // SDL2
     SDL_Window*   m_Window;
     SDL_Renderer* m_Renderer;
     SDL_Texture*  m_CanvasTexture;
+    SDL_Texture*  m_GlyphAtlas = nullptr;
+    bool          m_AtlasReady = false;
+
+    // Batched geometry, submitted with a single SDL_RenderGeometry call per flush.
+    // Everything is textured from the glyph atlas: glyphs sample their sprite, and plain
+    // geometry samples a solid white block, so the whole batch shares one texture.
+    SDL_Color               m_Colour = { 255, 255, 255, 255 };
+    std::vector<SDL_Vertex> m_Vertices;
+    std::vector<int>        m_Indices;
+
+    // Row-major, one bit per kCanvasTileSize square of the canvas
+    std::bitset<detail::kCanvasTilesX * detail::kCanvasTilesY> m_DirtyTiles;
 };
 
+namespace detail
+{
+    constexpr usize kMaxBatchVertices = 1 << 16;
+    constexpr usize kCircleSegments   = 16;
+
+    struct UnitSegment final
+    {
+        f32 x1;
+        f32 y1;
+        f32 x2;
+        f32 y2;
+    };
+
+    struct NANDShape final
+    {
+        std::array<UnitSegment, 10> segments;
+        f32                         circleX;
+        f32                         circleY;
+    };
+
+    // Unit-space outline of a NAND facing right, (0, 0) is the top left of its box
+    constexpr NANDShape kNANDShapeRight = {
+        {
+            // Legs
+            UnitSegment{ 0.0f, 0.3f, 0.2f, 0.3f },
+            UnitSegment{ 0.0f, 0.7f, 0.2f, 0.7f },
+            UnitSegment{ 0.8f, 0.5f, 1.0f, 0.5f },
+
+            // Body
+            UnitSegment{ 0.2f, 0.2f, 0.2f, 0.8f },
+            UnitSegment{ 0.2f, 0.2f, 0.5f, 0.2f },
+            UnitSegment{ 0.5f, 0.2f, 0.7f, 0.3f },
+            UnitSegment{ 0.7f, 0.3f, 0.8f, 0.5f },
+            UnitSegment{ 0.7f, 0.7f, 0.8f, 0.5f },
+            UnitSegment{ 0.5f, 0.8f, 0.7f, 0.7f },
+            UnitSegment{ 0.2f, 0.8f, 0.5f, 0.8f },
+        },
+        0.8f,
+        0.5f,
+    };
+
+    // The other facings are the right-facing outline mapped through facingTransform()
+    constexpr auto makeNANDShape(Facing facing) -> NANDShape
+    {
+        NANDShape shape = kNANDShapeRight;
+        for (auto& segment : shape.segments)
+        {
+            std::tie(segment.x1, segment.y1) = facingTransform(facing, segment.x1, segment.y1);
+            std::tie(segment.x2, segment.y2) = facingTransform(facing, segment.x2, segment.y2);
+        }
+        std::tie(shape.circleX, shape.circleY) = facingTransform(facing, shape.circleX, shape.circleY);
+        return shape;
+    }
+
+    // Indexed by Facing
+    constexpr std::array<NANDShape, 4> kNANDShapes = {
+        makeNANDShape(Facing::Right),
+        makeNANDShape(Facing::Down),
+        makeNANDShape(Facing::Left),
+        makeNANDShape(Facing::Up),
+    };
+
+    // Unit-space outlines of the other glyphs, facing right
+    constexpr std::array<UnitSegment, 4> kNodeShape = {
+        UnitSegment{ 0.3f, 0.3f, 0.7f, 0.3f },
+        UnitSegment{ 0.7f, 0.3f, 0.7f, 0.7f },
+        UnitSegment{ 0.7f, 0.7f, 0.3f, 0.7f },
+        UnitSegment{ 0.3f, 0.7f, 0.3f, 0.3f },
+    };
+
+    constexpr std::array<UnitSegment, 11> kClockShape = {
+        // Body
+        UnitSegment{ 0.1f, 0.1f, 0.9f, 0.1f },
+        UnitSegment{ 0.9f, 0.1f, 0.9f, 0.9f },
+        UnitSegment{ 0.9f, 0.9f, 0.1f, 0.9f },
+        UnitSegment{ 0.1f, 0.9f, 0.1f, 0.1f },
+
+        // Square wave
+        UnitSegment{ 0.2f, 0.6f, 0.35f, 0.6f },
+        UnitSegment{ 0.35f, 0.6f, 0.35f, 0.4f },
+        UnitSegment{ 0.35f, 0.4f, 0.5f, 0.4f },
+        UnitSegment{ 0.5f, 0.4f, 0.5f, 0.6f },
+        UnitSegment{ 0.5f, 0.6f, 0.65f, 0.6f },
+        UnitSegment{ 0.65f, 0.6f, 0.65f, 0.4f },
+        UnitSegment{ 0.65f, 0.4f, 0.8f, 0.4f },
+    };
+
+    constexpr std::array<UnitSegment, 4> kBoxShape = {
+        UnitSegment{ 0.0f, 0.0f, 1.0f, 0.0f },
+        UnitSegment{ 1.0f, 0.0f, 1.0f, 1.0f },
+        UnitSegment{ 1.0f, 1.0f, 0.0f, 1.0f },
+        UnitSegment{ 0.0f, 1.0f, 0.0f, 0.0f },
+    };
+
+    // Glyph atlas layout: a solid white block in the top left corner, then one row per
+    // size bucket, with one column per (glyph, facing) pair.
+    constexpr usize                kGlyphCount     = 4;
+    constexpr usize                kFacingCount    = 4;
+    constexpr std::array<usize, 4> kGlyphBuckets   = { 16, 32, 64, 128 };
+    constexpr usize                kGlyphPadding   = 2;
+    constexpr usize                kAtlasSolidSize = 4;
+    constexpr usize                kAtlasWidth     = kGlyphCount * kFacingCount * (kGlyphBuckets.back() + kGlyphPadding);
+
+    constexpr auto glyphBucketY(usize bucket) -> usize
+    {
+        usize y = kAtlasSolidSize;
+        for (usize i = 0; i < bucket; ++i)
+        {
+            y += kGlyphBuckets[i] + kGlyphPadding;
+        }
+        return y;
+    }
+
+    constexpr usize kAtlasHeight = glyphBucketY(kGlyphBuckets.size());
+
+    // Top left pixel of a glyph's sprite in the atlas, the sprite is kGlyphBuckets[bucket] pixels square
+    constexpr auto glyphOrigin(Glyph glyph, Facing facing, usize bucket) -> std::pair<usize, usize>
+    {
+        const auto column = static_cast<usize>(glyph) * kFacingCount + static_cast<usize>(facing);
+        return { column * (kGlyphBuckets.back() + kGlyphPadding) + kGlyphPadding / 2, glyphBucketY(bucket) + kGlyphPadding / 2 };
+    }
+
+    // Texture coordinates for untextured geometry: the middle of the solid white block
+    constexpr SDL_FPoint                kSolidTexCoord  = { (kAtlasSolidSize / 2.0f) / kAtlasWidth, (kAtlasSolidSize / 2.0f) / kAtlasHeight };
+    constexpr std::array<SDL_FPoint, 4> kSolidTexCoords = { kSolidTexCoord, kSolidTexCoord, kSolidTexCoord, kSolidTexCoord };
+
+    // Points on the unit circle, with the first point repeated at the end
+    inline auto unitCircle() -> std::array<SDL_FPoint, kCircleSegments + 1> const&
+    {
+        static const auto kUnitCircle = []
+        {
+            std::array<SDL_FPoint, kCircleSegments + 1> points;
+            for (usize i = 0; i <= kCircleSegments; ++i)
+            {
+                const f64 angle = 2.0 * std::numbers::pi * static_cast<f64>(i) / static_cast<f64>(kCircleSegments);
+                points[i]       = { static_cast<f32>(std::cos(angle)), static_cast<f32>(std::sin(angle)) };
+            }
+            return points;
+        }();
+        return kUnitCircle;
+    }
+} // namespace detail
+
 inline WindowRenderer::WindowRenderer(std::string const& title, Size const& size)
 {
     // Setup SDL
@@ -71,10 +264,22 @@ inline WindowRenderer::WindowRenderer(std::string const& title, Size const& size
     }
 
     m_CanvasTexture = SDL_CreateTexture(m_Renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, Config::kCanvasWidth, Config::kCanvasHeight);
+
+    m_Vertices.reserve(detail::kMaxBatchVertices);
+    m_Indices.reserve(detail::kMaxBatchVertices / 4 * 6);
+
+    buildGlyphAtlas();
+
+    // Nothing has been drawn to the canvas yet
+    markCanvasDirty();
 }
 
 inline WindowRenderer::~WindowRenderer()
 {
+    if (m_GlyphAtlas != nullptr)
+    {
+        SDL_DestroyTexture(m_GlyphAtlas);
+    }
     SDL_DestroyTexture(m_CanvasTexture);
     SDL_DestroyRenderer(m_Renderer);
     SDL_DestroyWindow(m_Window);
@@ -83,10 +288,16 @@ inline WindowRenderer::~WindowRenderer()
 
 inline void WindowRenderer::handleEvent(SDL_Event const& event)
 {
+    // Target textures lose their contents when the device is reset
+    if (event.type == SDL_RENDER_TARGETS_RESET || event.type == SDL_RENDER_DEVICE_RESET)
+    {
+        markCanvasDirty();
+    }
 }
 
 inline void WindowRenderer::clear()
 {
+    flush();
     SDL_RenderClear(m_Renderer);
     SDL_SetRenderDrawColor(m_Renderer, 0, 0, 0, 255);
 }
@@ -97,126 +308,298 @@ inline void WindowRenderer::draw()
 
 inline void WindowRenderer::present()
 {
+    flush();
     SDL_RenderPresent(m_Renderer);
 }
 
 inline void WindowRenderer::drawLine(const Position& start, const Position& end)
 {
-    SDL_RenderDrawLine(m_Renderer, start.x, start.y, end.x, end.y);
+    // Lines are queued as 1px wide quads. Offset onto pixel centres and extend half a pixel
+    // past each end so the result matches what SDL_RenderDrawLine would have lit.
+    const f32 x1 = start.x + 0.5f;
+    const f32 y1 = start.y + 0.5f;
+    const f32 x2 = end.x + 0.5f;
+    const f32 y2 = end.y + 0.5f;
+
+    const f32 length = std::hypot(x2 - x1, y2 - y1);
+    const f32 dx     = length > 0.0f ? (x2 - x1) / length * 0.5f : 0.5f;
+    const f32 dy     = length > 0.0f ? (y2 - y1) / length * 0.5f : 0.0f;
+
+    pushQuad({ x1 - dx - dy, y1 - dy + dx },
+             { x1 - dx + dy, y1 - dy - dx },
+             { x2 + dx + dy, y2 + dy - dx },
+             { x2 + dx - dy, y2 + dy + dx });
 }
 
 inline void WindowRenderer::drawRectangle(const Position& topLeft, const Size& size)
 {
-    SDL_Rect rect;
-    rect.x = topLeft.x;
-    rect.y = topLeft.y;
-    rect.w = size.width;
-    rect.h = size.height;
-    SDL_RenderDrawRect(m_Renderer, &rect);
+    const Position topRight    = { topLeft.x + size.width, topLeft.y };
+    const Position bottomLeft  = { topLeft.x, topLeft.y + size.height };
+    const Position bottomRight = { topLeft.x + size.width, topLeft.y + size.height };
+
+    drawLine(topLeft, topRight);
+    drawLine(topRight, bottomRight);
+    drawLine(bottomRight, bottomLeft);
+    drawLine(bottomLeft, topLeft);
+}
+
+inline void WindowRenderer::fillRectangle(const Position& topLeft, const Size& size)
+{
+    const f32 x1 = topLeft.x;
+    const f32 y1 = topLeft.y;
+    const f32 x2 = topLeft.x + size.width;
+    const f32 y2 = topLeft.y + size.height;
+
+    pushQuad({ x1, y1 }, { x2, y1 }, { x2, y2 }, { x1, y2 });
 }
 
 inline void WindowRenderer::drawCircle(const Position& center, f64 radius)
 {
-    constexpr int kSegments = 16;
-    for (int i = 0; i < kSegments; ++i)
+    auto const& unitCircle = detail::unitCircle();
+    for (usize i = 0; i < detail::kCircleSegments; ++i)
     {
-        const f64 angle1 = 2.0 * M_PI * static_cast<f64>(i) / static_cast<f64>(kSegments);
-        const f64 angle2 = 2.0 * M_PI * static_cast<f64>(i + 1) / static_cast<f64>(kSegments);
+        drawLine({ center.x + radius * unitCircle[i].x, center.y + radius * unitCircle[i].y },
+                 { center.x + radius * unitCircle[i + 1].x, center.y + radius * unitCircle[i + 1].y });
+    }
+}
+
+inline void WindowRenderer::drawNAND(const Position& topLeft, const Size& size, Facing facing)
+{
+    auto const& shape = detail::kNANDShapes[static_cast<usize>(facing)];
+    for (auto const& segment : shape.segments)
+    {
+        drawLine({ topLeft.x + size.width * segment.x1, topLeft.y + size.height * segment.y1 },
+                 { topLeft.x + size.width * segment.x2, topLeft.y + size.height * segment.y2 });
+    }
 
-        const f64 x1 = center.x + radius * std::cos(angle1);
-        const f64 y1 = center.y + radius * std::sin(angle1);
-        const f64 x2 = center.x + radius * std::cos(angle2);
-        const f64 y2 = center.y + radius * std::sin(angle2);
+    drawCircle({ topLeft.x + size.width * shape.circleX, topLeft.y + size.height * shape.circleY }, size.width * 0.05f);
+}
 
-        SDL_RenderDrawLine(m_Renderer, x1, y1, x2, y2);
+inline void WindowRenderer::drawGlyph(Glyph glyph, const Position& topLeft, const Size& size, Facing facing)
+{
+    // Bigger than the biggest sprite (or no atlas at all), tessellate it instead so it stays crisp
+    const auto extent = std::max(size.width, size.height);
+    if (!m_AtlasReady || extent > detail::kGlyphBuckets.back())
+    {
+        drawGlyphGeometry(glyph, topLeft, size, facing);
+        return;
     }
+
+    // Smallest sprite that's at least as big as the requested size, so we only ever scale down
+    usize bucket = 0;
+    while (detail::kGlyphBuckets[bucket] < extent)
+    {
+        ++bucket;
+    }
+
+    const auto [spriteX, spriteY] = detail::glyphOrigin(glyph, facing, bucket);
+    const f32 spriteSize          = detail::kGlyphBuckets[bucket];
+
+    const f32 u1 = spriteX / static_cast<f32>(detail::kAtlasWidth);
+    const f32 v1 = spriteY / static_cast<f32>(detail::kAtlasHeight);
+    const f32 u2 = (spriteX + spriteSize) / static_cast<f32>(detail::kAtlasWidth);
+    const f32 v2 = (spriteY + spriteSize) / static_cast<f32>(detail::kAtlasHeight);
+
+    const f32 x1 = topLeft.x;
+    const f32 y1 = topLeft.y;
+    const f32 x2 = topLeft.x + size.width;
+    const f32 y2 = topLeft.y + size.height;
+
+    pushQuad({ SDL_FPoint{ x1, y1 }, SDL_FPoint{ x2, y1 }, SDL_FPoint{ x2, y2 }, SDL_FPoint{ x1, y2 } },
+             { SDL_FPoint{ u1, v1 }, SDL_FPoint{ u2, v1 }, SDL_FPoint{ u2, v2 }, SDL_FPoint{ u1, v2 } });
 }
 
-inline void WindowRenderer::drawNAND(const Position& topLeft, const Size& size, Facing facing)
+inline void WindowRenderer::drawGlyphGeometry(Glyph glyph, const Position& topLeft, const Size& size, Facing facing)
 {
-    switch (facing)
+    const auto drawSegments = [&](auto const& segments)
     {
-        case Facing::Right:
+        for (auto const& segment : segments)
         {
-            // Legs
-            drawLine({ topLeft.x + size.width * 0.0f, topLeft.y + size.height * 0.3f }, { topLeft.x + size.width * 0.2f, topLeft.y + size.height * 0.3f });
-            drawLine({ topLeft.x + size.width * 0.0f, topLeft.y + size.height * 0.7f }, { topLeft.x + size.width * 0.2f, topLeft.y + size.height * 0.7f });
-            drawLine({ topLeft.x + size.width * 0.8f, topLeft.y + size.height * 0.5f }, { topLeft.x + size.width * 1.0f, topLeft.y + size.height * 0.5f });
-
-            // Body
-            drawLine({ topLeft.x + size.width * 0.2f, topLeft.y + size.height * 0.2f }, { topLeft.x + size.width * 0.2f, topLeft.y + size.height * 0.8f });
-            drawLine({ topLeft.x + size.width * 0.2f, topLeft.y + size.height * 0.2f }, { topLeft.x + size.width * 0.5f, topLeft.y + size.height * 0.2f });
-            drawLine({ topLeft.x + size.width * 0.5f, topLeft.y + size.height * 0.2f }, { topLeft.x + size.width * 0.7f, topLeft.y + size.height * 0.3f });
-            drawLine({ topLeft.x + size.width * 0.7f, topLeft.y + size.height * 0.3f }, { topLeft.x + size.width * 0.8f, topLeft.y + size.height * 0.5f });
-            drawLine({ topLeft.x + size.width * 0.7f, topLeft.y + size.height * 0.7f }, { topLeft.x + size.width * 0.8f, topLeft.y + size.height * 0.5f });
-            drawLine({ topLeft.x + size.width * 0.5f, topLeft.y + size.height * 0.8f }, { topLeft.x + size.width * 0.7f, topLeft.y + size.height * 0.7f });
-            drawLine({ topLeft.x + size.width * 0.2f, topLeft.y + size.height * 0.8f }, { topLeft.x + size.width * 0.5f, topLeft.y + size.height * 0.8f });
-
-            // Draw circle
-            drawCircle({ topLeft.x + size.width * 0.8f, topLeft.y + size.height * 0.5f }, size.width * 0.05f);
+            const auto [x1, y1] = facingTransform(facing, segment.x1, segment.y1);
+            const auto [x2, y2] = facingTransform(facing, segment.x2, segment.y2);
+            drawLine({ topLeft.x + size.width * x1, topLeft.y + size.height * y1 },
+                     { topLeft.x + size.width * x2, topLeft.y + size.height * y2 });
         }
-        break;
-        case Facing::Down:
-        {
-            // Legs
-            drawLine({ topLeft.x + size.width * 0.3f, topLeft.y + size.height * 0.0f }, { topLeft.x + size.width * 0.3f, topLeft.y + size.height * 0.2f });
-            drawLine({ topLeft.x + size.width * 0.7f, topLeft.y + size.height * 0.0f }, { topLeft.x + size.width * 0.7f, topLeft.y + size.height * 0.2f });
-            drawLine({ topLeft.x + size.width * 0.5f, topLeft.y + size.height * 0.8f }, { topLeft.x + size.width * 0.5f, topLeft.y + size.height * 1.0f });
+    };
 
-            // Body
-            drawLine({ topLeft.x + size.width * 0.2f, topLeft.y + size.height * 0.2f }, { topLeft.x + size.width * 0.8f, topLeft.y + size.height * 0.2f });
-            drawLine({ topLeft.x + size.width * 0.2f, topLeft.y + size.height * 0.2f }, { topLeft.x + size.width * 0.2f, topLeft.y + size.height * 0.5f });
-            drawLine({ topLeft.x + size.width * 0.2f, topLeft.y + size.height * 0.5f }, { topLeft.x + size.width * 0.3f, topLeft.y + size.height * 0.7f });
-            drawLine({ topLeft.x + size.width * 0.3f, topLeft.y + size.height * 0.7f }, { topLeft.x + size.width * 0.5f, topLeft.y + size.height * 0.8f });
-            drawLine({ topLeft.x + size.width * 0.7f, topLeft.y + size.height * 0.7f }, { topLeft.x + size.width * 0.5f, topLeft.y + size.height * 0.8f });
-            drawLine({ topLeft.x + size.width * 0.8f, topLeft.y + size.height * 0.5f }, { topLeft.x + size.width * 0.8f, topLeft.y + size.height * 0.2f });
-            drawLine({ topLeft.x + size.width * 0.8f, topLeft.y + size.height * 0.5f }, { topLeft.x + size.width * 0.7f, topLeft.y + size.height * 0.7f });
-
-            // Draw circle
-            drawCircle({ topLeft.x + size.width * 0.5f, topLeft.y + size.height * 0.8f }, size.width * 0.05f);
-        }
-        break;
-        case Facing::Left:
-        {
-            // Legs
-            drawLine({ topLeft.x + size.width * 1.0f, topLeft.y + size.height * 0.3f }, { topLeft.x + size.width * 0.8f, topLeft.y + size.height * 0.3f });
-            drawLine({ topLeft.x + size.width * 1.0f, topLeft.y + size.height * 0.7f }, { topLeft.x + size.width * 0.8f, topLeft.y + size.height * 0.7f });
-            drawLine({ topLeft.x + size.width * 0.2f, topLeft.y + size.height * 0.5f }, { topLeft.x + size.width * 0.0f, topLeft.y + size.height * 0.5f });
+    switch (glyph)
+    {
+        case Glyph::NAND:
+            drawNAND(topLeft, size, facing);
+            break;
+        case Glyph::Node:
+            drawSegments(detail::kNodeShape);
+            break;
+        case Glyph::Clock:
+            drawSegments(detail::kClockShape);
+            break;
+        case Glyph::Box:
+            drawSegments(detail::kBoxShape);
+            break;
+    }
+}
 
-            // Body
-            drawLine({ topLeft.x + size.width * 0.8f, topLeft.y + size.height * 0.2f }, { topLeft.x + size.width * 0.8f, topLeft.y + size.height * 0.8f });
-            drawLine({ topLeft.x + size.width * 0.8f, topLeft.y + size.height * 0.2f }, { topLeft.x + size.width * 0.5f, topLeft.y + size.height * 0.2f });
-            drawLine({ topLeft.x + size.width * 0.5f, topLeft.y + size.height * 0.2f }, { topLeft.x + size.width * 0.3f, topLeft.y + size.height * 0.3f });
-            drawLine({ topLeft.x + size.width * 0.3f, topLeft.y + size.height * 0.3f }, { topLeft.x + size.width * 0.2f, topLeft.y + size.height * 0.5f });
-            drawLine({ topLeft.x + size.width * 0.3f, topLeft.y + size.height * 0.7f }, { topLeft.x + size.width * 0.2f, topLeft.y + size.height * 0.5f });
-            drawLine({ topLeft.x + size.width * 0.5f, topLeft.y + size.height * 0.8f }, { topLeft.x + size.width * 0.3f, topLeft.y + size.height * 0.7f });
-            drawLine({ topLeft.x + size.width * 0.8f, topLeft.y + size.height * 0.8f }, { topLeft.x + size.width * 0.5f, topLeft.y + size.height * 0.8f });
-
-            // Draw circle
-            drawCircle({ topLeft.x + size.width * 0.2f, topLeft.y + size.height * 0.5f }, size.width * 0.05f);
+// Renders every glyph, in white, into one texture. Colours are applied per-vertex when the
+// glyphs are drawn, which modulates the white sprite into whatever state colour is needed.
+inline void WindowRenderer::buildGlyphAtlas()
+{
+    m_GlyphAtlas = SDL_CreateTexture(m_Renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, detail::kAtlasWidth, detail::kAtlasHeight);
+    if (m_GlyphAtlas == nullptr)
+    {
+        spdlog::warn("Could not create glyph atlas, falling back to geometry: {}", SDL_GetError());
+        return;
+    }
+
+    SDL_SetTextureBlendMode(m_GlyphAtlas, SDL_BLENDMODE_BLEND);
+    SDL_SetTextureScaleMode(m_GlyphAtlas, SDL_ScaleModeLinear);
+
+    SDL_SetRenderTarget(m_Renderer, m_GlyphAtlas);
+
+    // Transparent white, so linear filtering at the edges of a sprite doesn't pull in black
+    SDL_SetRenderDrawColor(m_Renderer, 255, 255, 255, 0);
+    SDL_RenderClear(m_Renderer);
+
+    setColour(Colour::White);
+    fillRectangle({ 0.0, 0.0 }, { detail::kAtlasSolidSize, detail::kAtlasSolidSize });
+
+    for (usize bucket = 0; bucket < detail::kGlyphBuckets.size(); ++bucket)
+    {
+        for (auto glyph : { Glyph::NAND, Glyph::Node, Glyph::Clock, Glyph::Box })
+        {
+            for (auto facing : { Facing::Right, Facing::Down, Facing::Left, Facing::Up })
+            {
+                const auto [x, y] = detail::glyphOrigin(glyph, facing, bucket);
+
+                // Lines light the pixel at each end, so an extent of size - 1 fills the sprite exactly
+                const f64 extent = detail::kGlyphBuckets[bucket] - 1.0;
+                drawGlyphGeometry(glyph, { static_cast<f64>(x), static_cast<f64>(y) }, { extent, extent }, facing);
+            }
         }
-        break;
-        case Facing::Up:
+    }
+
+    flush();
+    SDL_SetRenderTarget(m_Renderer, nullptr);
+
+    m_AtlasReady = true;
+}
+
+inline void WindowRenderer::pushQuad(SDL_FPoint a, SDL_FPoint b, SDL_FPoint c, SDL_FPoint d)
+{
+    pushQuad({ a, b, c, d }, detail::kSolidTexCoords);
+}
+
+inline void WindowRenderer::pushQuad(std::array<SDL_FPoint, 4> const& points, std::array<SDL_FPoint, 4> const& texCoords)
+{
+    if (m_Vertices.size() + 4 > detail::kMaxBatchVertices)
+    {
+        flush();
+    }
+
+    const int base = static_cast<int>(m_Vertices.size());
+    for (usize i = 0; i < 4; ++i)
+    {
+        m_Vertices.push_back({ points[i], m_Colour, texCoords[i] });
+    }
+
+    m_Indices.push_back(base + 0);
+    m_Indices.push_back(base + 1);
+    m_Indices.push_back(base + 2);
+    m_Indices.push_back(base + 0);
+    m_Indices.push_back(base + 2);
+    m_Indices.push_back(base + 3);
+}
+
+inline void WindowRenderer::flush()
+{
+    if (m_Vertices.empty())
+    {
+        return;
+    }
+
+    // The atlas can't be sampled while it's being drawn into
+    SDL_Texture* texture = m_AtlasReady ? m_GlyphAtlas : nullptr;
+    SDL_RenderGeometry(m_Renderer, texture, m_Vertices.data(), static_cast<int>(m_Vertices.size()), m_Indices.data(), static_cast<int>(m_Indices.size()));
+
+    m_Vertices.clear();
+    m_Indices.clear();
+}
+
+inline void WindowRenderer::markCanvasDirty()
+{
+    m_DirtyTiles.set();
+}
+
+inline void WindowRenderer::markCanvasDirty(const Position& topLeft, const Size& size)
+{
+    const auto firstX = std::max<isize>(static_cast<isize>(std::floor(topLeft.x / Config::kCanvasTileSize)), 0);
+    const auto firstY = std::max<isize>(static_cast<isize>(std::floor(topLeft.y / Config::kCanvasTileSize)), 0);
+    const auto lastX  = std::min<isize>(static_cast<isize>(std::floor((topLeft.x + size.width) / Config::kCanvasTileSize)), static_cast<isize>(detail::kCanvasTilesX) - 1);
+    const auto lastY  = std::min<isize>(static_cast<isize>(std::floor((topLeft.y + size.height) / Config::kCanvasTileSize)), static_cast<isize>(detail::kCanvasTilesY) - 1);
+
+    for (isize y = firstY; y <= lastY; ++y)
+    {
+        for (isize x = firstX; x <= lastX; ++x)
         {
-            // Legs
-            drawLine({ topLeft.x + size.width * 0.3f, topLeft.y + size.height * 1.0f }, { topLeft.x + size.width * 0.3f, topLeft.y + size.height * 0.8f });
-            drawLine({ topLeft.x + size.width * 0.7f, topLeft.y + size.height * 1.0f }, { topLeft.x + size.width * 0.7f, topLeft.y + size.height * 0.8f });
-            drawLine({ topLeft.x + size.width * 0.5f, topLeft.y + size.height * 0.2f }, { topLeft.x + size.width * 0.5f, topLeft.y + size.height * 0.0f });
+            m_DirtyTiles.set(y * detail::kCanvasTilesX + x);
+        }
+    }
+}
 
-            // Body
-            drawLine({ topLeft.x + size.width * 0.2f, topLeft.y + size.height * 0.8f }, { topLeft.x + size.width * 0.8f, topLeft.y + size.height * 0.8f });
-            drawLine({ topLeft.x + size.width * 0.2f, topLeft.y + size.height * 0.8f }, { topLeft.x + size.width * 0.2f, topLeft.y + size.height * 0.5f });
-            drawLine({ topLeft.x + size.width * 0.2f, topLeft.y + size.height * 0.5f }, { topLeft.x + size.width * 0.3f, topLeft.y + size.height * 0.3f });
-            drawLine({ topLeft.x + size.width * 0.3f, topLeft.y + size.height * 0.3f }, { topLeft.x + size.width * 0.5f, topLeft.y + size.height * 0.2f });
-            drawLine({ topLeft.x + size.width * 0.7f, topLeft.y + size.height * 0.3f }, { topLeft.x + size.width * 0.5f, topLeft.y + size.height * 0.2f });
-            drawLine({ topLeft.x + size.width * 0.8f, topLeft.y + size.height * 0.5f }, { topLeft.x + size.width * 0.8f, topLeft.y + size.height * 0.8f });
-            drawLine({ topLeft.x + size.width * 0.8f, topLeft.y + size.height * 0.5f }, { topLeft.x + size.width * 0.7f, topLeft.y + size.height * 0.3f });
-
-            // Draw circle
-            drawCircle({ topLeft.x + size.width * 0.5f, topLeft.y + size.height * 0.2f }, size.width * 0.05f);
+template <typename Fn>
+inline void WindowRenderer::redrawDirtyCanvas(Fn&& drawRegion)
+{
+    if (m_DirtyTiles.none())
+    {
+        return;
+    }
+
+    // Anything already queued was meant for the unclipped target
+    flush();
+
+    const auto redraw = [&](SDL_Rect const& rect)
+    {
+        SDL_RenderSetClipRect(m_Renderer, &rect);
+
+        // SDL_RenderClear ignores the clip rect, so fill the region instead
+        SDL_SetRenderDrawColor(m_Renderer, 0, 0, 0, 255);
+        SDL_RenderFillRect(m_Renderer, &rect);
+
+        drawRegion(Position{ static_cast<f64>(rect.x), static_cast<f64>(rect.y) }, Size{ static_cast<f64>(rect.w), static_cast<f64>(rect.h) });
+        flush();
+    };
+
+    constexpr auto kTileSize = static_cast<int>(Config::kCanvasTileSize);
+    if (m_DirtyTiles.all())
+    {
+        redraw({ 0, 0, static_cast<int>(Config::kCanvasWidth), static_cast<int>(Config::kCanvasHeight) });
+    }
+    else
+    {
+        // Merge each row's dirty tiles into horizontal runs
+        for (usize y = 0; y < detail::kCanvasTilesY; ++y)
+        {
+            usize x = 0;
+            while (x < detail::kCanvasTilesX)
+            {
+                if (!m_DirtyTiles.test(y * detail::kCanvasTilesX + x))
+                {
+                    ++x;
+                    continue;
+                }
+
+                const usize runStart = x;
+                while (x < detail::kCanvasTilesX && m_DirtyTiles.test(y * detail::kCanvasTilesX + x))
+                {
+                    ++x;
+                }
+
+                redraw({ static_cast<int>(runStart) * kTileSize, static_cast<int>(y) * kTileSize, static_cast<int>(x - runStart) * kTileSize, kTileSize });
+            }
         }
-        break;
     }
+
+    SDL_RenderSetClipRect(m_Renderer, nullptr);
+    m_DirtyTiles.reset();
 }
 
 inline void WindowRenderer::setColour(Colour colour)
@@ -224,48 +607,53 @@ inline void WindowRenderer::setColour(Colour colour)
     switch (colour)
     {
         case Colour::Red:
-            SDL_SetRenderDrawColor(m_Renderer, 255, 0, 0, 255);
+            m_Colour = { 255, 0, 0, 255 };
             break;
         case Colour::Green:
-            SDL_SetRenderDrawColor(m_Renderer, 0, 255, 0, 255);
+            m_Colour = { 0, 255, 0, 255 };
             break;
         case Colour::Blue:
-            SDL_SetRenderDrawColor(m_Renderer, 0, 0, 255, 255);
+            m_Colour = { 0, 0, 255, 255 };
             break;
         case Colour::Yellow:
-            SDL_SetRenderDrawColor(m_Renderer, 255, 255, 0, 255);
+            m_Colour = { 255, 255, 0, 255 };
             break;
         case Colour::Cyan:
-            SDL_SetRenderDrawColor(m_Renderer, 0, 255, 255, 255);
+            m_Colour = { 0, 255, 255, 255 };
             break;
         case Colour::Magenta:
-            SDL_SetRenderDrawColor(m_Renderer, 255, 0, 255, 255);
+            m_Colour = { 255, 0, 255, 255 };
             break;
         case Colour::White:
-            SDL_SetRenderDrawColor(m_Renderer, 255, 255, 255, 255);
+            m_Colour = { 255, 255, 255, 255 };
             break;
         case Colour::Black:
-            SDL_SetRenderDrawColor(m_Renderer, 0, 0, 0, 255);
+            m_Colour = { 0, 0, 0, 255 };
             break;
         case Colour::Grey:
-            SDL_SetRenderDrawColor(m_Renderer, 128, 128, 128, 255);
+            m_Colour = { 128, 128, 128, 255 };
             break;
         case Colour::LightGrey:
-            SDL_SetRenderDrawColor(m_Renderer, 192, 192, 192, 255);
+            m_Colour = { 192, 192, 192, 255 };
             break;
         case Colour::DarkGrey:
-            SDL_SetRenderDrawColor(m_Renderer, 64, 64, 64, 255);
+            m_Colour = { 64, 64, 64, 255 };
             break;
     }
+
+    // Still used by SDL_RenderClear & co.
+    SDL_SetRenderDrawColor(m_Renderer, m_Colour.r, m_Colour.g, m_Colour.b, m_Colour.a);
 }
 
 inline void WindowRenderer::setDrawToCanvas()
 {
+    flush();
     SDL_SetRenderTarget(m_Renderer, m_CanvasTexture);
 }
 
 inline void WindowRenderer::setDrawToScreen()
 {
+    flush();
     SDL_SetRenderTarget(m_Renderer, nullptr);
 }
 
@@ -0,0 +1,324 @@
+#pragma once
+
+#include "types.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// A uniform grid over world space, built in one pass from a list of boxes.
+// Each item is bucketed by its top-left corner only, so queries widen their search
+// area by the largest item size instead of storing an item in every cell it touches.
+// Items are stored CSR-style: m_CellStarts[cell]..m_CellStarts[cell + 1] indexes m_Items,
+// with a copy of each item's box kept alongside so queries never touch the source data.
+// The odd item much bigger than a cell, like a long wire, is kept in a list every query checks
+// instead, so it doesn't widen the search for all the others.
+//
+// The grid never has more than kMaxCells cells, the cells grow instead when the items are spread
+// far apart. Items that move after the build join the checked-every-time list too, until enough
+// have moved that the owner should build it again.
+class SpatialIndex final
+{
+public:
+    explicit SpatialIndex(f64 cellSize);
+
+    void clear();
+
+    // boxFn(index) -> std::pair<Position, Size> for index in [0, count)
+    template <typename BoxFn>
+    void build(usize count, BoxFn&& boxFn);
+
+    // Gives an item built into the index a new box
+    void update(u32 index, Position const& position, Size const& size);
+
+    // Whether so many items have moved since the build that queries would be faster after another
+    auto needsRebuild() const -> bool;
+
+    // Calls fn(index) for every item whose box overlaps the world-space rectangle [min, max].
+    template <typename Fn>
+    void query(Position const& min, Position const& max, Fn&& fn) const;
+
+    // Calls fn(cellMin, cellSize, count) for every non-empty block of stride x stride cells
+    // that overlaps the world-space rectangle [min, max]. Large items aren't counted, and items
+    // moved since the build are counted where they were.
+    template <typename Fn>
+    void forEachDensityTile(Position const& min, Position const& max, usize stride, Fn&& fn) const;
+
+    auto cellSize() const -> f64;
+    auto maxItemSize() const -> Size;
+    auto empty() const -> bool;
+
+private:
+    // Clamped to one cell outside the grid either side, so far off coordinates stay in range
+    auto cellX(f64 x) const -> isize;
+    auto cellY(f64 y) const -> isize;
+
+    // Items bigger than this many cells either way go in m_LargeItems
+    static constexpr f64 kMaxBucketedCells = 4.0;
+
+    // Caps the grid's memory however far apart the items are
+    static constexpr f64 kMaxCells = 1 << 20;
+
+    // Marks where an item's entry in m_Items was before it moved
+    static constexpr u32 kMoved = ~0u;
+
+    // Set in m_Slots for items whose entry is in m_LargeItems
+    static constexpr u32 kLargeSlot = 1u << 31;
+
+    f64 m_BaseCellSize;
+    f64 m_CellSize;
+
+    Position m_Origin      = { 0.0, 0.0 };
+    Size     m_MaxItemSize = { 0.0, 0.0 };
+    usize    m_Columns     = 0;
+    usize    m_Rows        = 0;
+
+    struct Entry final
+    {
+        u32      index;
+        Position position;
+        Size     size;
+    };
+
+    std::vector<u32>   m_CellStarts;
+    std::vector<Entry> m_Items;
+    std::vector<Entry> m_LargeItems;
+    std::vector<u32>   m_Slots;     // Each item's entry, in m_Items or (with kLargeSlot) m_LargeItems
+    usize              m_Moved = 0; // Items moved out of m_Items since the build
+};
+
+inline SpatialIndex::SpatialIndex(f64 cellSize)
+: m_BaseCellSize(cellSize)
+, m_CellSize(cellSize)
+{
+}
+
+inline void SpatialIndex::clear()
+{
+    m_CellSize    = m_BaseCellSize;
+    m_Columns     = 0;
+    m_Rows        = 0;
+    m_MaxItemSize = { 0.0, 0.0 };
+    m_Moved       = 0;
+    m_CellStarts.clear();
+    m_Items.clear();
+    m_LargeItems.clear();
+    m_Slots.clear();
+}
+
+template <typename BoxFn>
+inline void SpatialIndex::build(usize count, BoxFn&& boxFn)
+{
+    clear();
+
+    m_Items.reserve(count);
+    m_Slots.resize(count);
+
+    // Boxes that aren't finite can't be put in a cell, but can still be checked by every query
+    const f64 maxBucketedSize = kMaxBucketedCells * m_BaseCellSize;
+    Position  min             = { 0.0, 0.0 };
+    Position  max             = { 0.0, 0.0 };
+    for (usize i = 0; i < count; ++i)
+    {
+        auto [position, size] = boxFn(i);
+        if (size.width > maxBucketedSize || size.height > maxBucketedSize || !std::isfinite(position.x) || !std::isfinite(position.y))
+        {
+            m_Slots[i] = static_cast<u32>(m_LargeItems.size()) | kLargeSlot;
+            m_LargeItems.push_back({ static_cast<u32>(i), position, size });
+            continue;
+        }
+
+        if (m_Items.empty())
+        {
+            min = position;
+            max = position;
+        }
+
+        min.x = std::min(min.x, position.x);
+        min.y = std::min(min.y, position.y);
+        max.x = std::max(max.x, position.x);
+        max.y = std::max(max.y, position.y);
+
+        m_MaxItemSize.width  = std::max(m_MaxItemSize.width, size.width);
+        m_MaxItemSize.height = std::max(m_MaxItemSize.height, size.height);
+
+        // Stash the box unsorted for now, it's moved into place below
+        m_Items.push_back({ static_cast<u32>(i), position, size });
+    }
+
+    if (m_Items.empty())
+    {
+        return;
+    }
+
+    // Divided before subtracting, so corners at opposite ends of the doubles' range don't overflow
+    const auto cellsAcross = [&](f64 from, f64 to)
+    {
+        return std::floor(to / m_CellSize - from / m_CellSize) + 1.0;
+    };
+
+    while (cellsAcross(min.x, max.x) * cellsAcross(min.y, max.y) > kMaxCells)
+    {
+        m_CellSize *= 2.0;
+    }
+
+    m_Origin  = min;
+    m_Columns = static_cast<usize>(cellsAcross(min.x, max.x));
+    m_Rows    = static_cast<usize>(cellsAcross(min.y, max.y));
+
+    // Counting sort of the items into their cells
+    m_CellStarts.assign(m_Columns * m_Rows + 1, 0);
+    for (auto const& entry : m_Items)
+    {
+        ++m_CellStarts[cellY(entry.position.y) * m_Columns + cellX(entry.position.x) + 1];
+    }
+
+    for (usize cell = 1; cell < m_CellStarts.size(); ++cell)
+    {
+        m_CellStarts[cell] += m_CellStarts[cell - 1];
+    }
+
+    std::vector<u32>   cursors(m_CellStarts.begin(), m_CellStarts.end() - 1);
+    std::vector<Entry> sorted(m_Items.size());
+    for (auto const& entry : m_Items)
+    {
+        const auto cell         = cellY(entry.position.y) * m_Columns + cellX(entry.position.x);
+        m_Slots[entry.index]    = cursors[cell];
+        sorted[cursors[cell]++] = entry;
+    }
+
+    m_Items = std::move(sorted);
+}
+
+inline void SpatialIndex::update(u32 index, Position const& position, Size const& size)
+{
+    auto& slot = m_Slots[index];
+    if (slot & kLargeSlot)
+    {
+        m_LargeItems[slot & ~kLargeSlot] = { index, position, size };
+        return;
+    }
+
+    // Its cell is only right for where it was, so it's looked at by every query from now on
+    m_Items[slot].index = kMoved;
+    slot                = static_cast<u32>(m_LargeItems.size()) | kLargeSlot;
+    m_LargeItems.push_back({ index, position, size });
+    ++m_Moved;
+}
+
+inline auto SpatialIndex::needsRebuild() const -> bool
+{
+    return m_Moved > m_Items.size() / 8 + 64;
+}
+
+template <typename Fn>
+inline void SpatialIndex::query(Position const& min, Position const& max, Fn&& fn) const
+{
+    const auto overlaps = [&](Entry const& entry)
+    {
+        return entry.position.x <= max.x && entry.position.y <= max.y &&
+               entry.position.x + entry.size.width >= min.x && entry.position.y + entry.size.height >= min.y;
+    };
+
+    for (auto const& entry : m_LargeItems)
+    {
+        if (overlaps(entry))
+        {
+            fn(entry.index);
+        }
+    }
+
+    if (m_Items.empty())
+    {
+        return;
+    }
+
+    // Items are bucketed by their top-left corner, so anything starting up to
+    // one item-size above/left of the query area can still overlap it.
+    const auto firstX = std::max<isize>(cellX(min.x - m_MaxItemSize.width), 0);
+    const auto firstY = std::max<isize>(cellY(min.y - m_MaxItemSize.height), 0);
+    const auto lastX  = std::min<isize>(cellX(max.x), static_cast<isize>(m_Columns) - 1);
+    const auto lastY  = std::min<isize>(cellY(max.y), static_cast<isize>(m_Rows) - 1);
+
+    for (isize y = firstY; y <= lastY; ++y)
+    {
+        for (isize x = firstX; x <= lastX; ++x)
+        {
+            const auto cell = y * m_Columns + x;
+            for (u32 i = m_CellStarts[cell]; i < m_CellStarts[cell + 1]; ++i)
+            {
+                if (m_Items[i].index != kMoved && overlaps(m_Items[i]))
+                {
+                    fn(m_Items[i].index);
+                }
+            }
+        }
+    }
+}
+
+template <typename Fn>
+inline void SpatialIndex::forEachDensityTile(Position const& min, Position const& max, usize stride, Fn&& fn) const
+{
+    if (m_Items.empty())
+    {
+        return;
+    }
+
+    stride = std::max<usize>(stride, 1);
+
+    // Snap to stride-aligned blocks so tiles don't shimmer while panning
+    const auto firstX = std::max<isize>(cellX(min.x), 0) / stride * stride;
+    const auto firstY = std::max<isize>(cellY(min.y), 0) / stride * stride;
+    const auto lastX  = std::min<isize>(cellX(max.x), static_cast<isize>(m_Columns) - 1);
+    const auto lastY  = std::min<isize>(cellY(max.y), static_cast<isize>(m_Rows) - 1);
+
+    for (isize tileY = firstY; tileY <= lastY; tileY += stride)
+    {
+        for (isize tileX = firstX; tileX <= lastX; tileX += stride)
+        {
+            usize count = 0;
+            for (isize y = tileY; y < std::min<isize>(tileY + stride, m_Rows); ++y)
+            {
+                const auto rowStart = y * m_Columns;
+                const auto first    = rowStart + tileX;
+                const auto last     = rowStart + std::min<isize>(tileX + stride, m_Columns);
+                count += m_CellStarts[last] - m_CellStarts[first];
+            }
+
+            if (count > 0)
+            {
+                const Position tileMin  = { m_Origin.x + tileX * m_CellSize, m_Origin.y + tileY * m_CellSize };
+                const Size     tileSize = { stride * m_CellSize, stride * m_CellSize };
+                fn(tileMin, tileSize, count);
+            }
+        }
+    }
+}
+
+inline auto SpatialIndex::cellSize() const -> f64
+{
+    return m_CellSize;
+}
+
+inline auto SpatialIndex::maxItemSize() const -> Size
+{
+    return m_MaxItemSize;
+}
+
+inline auto SpatialIndex::empty() const -> bool
+{
+    return m_Items.empty() && m_LargeItems.empty();
+}
+
+inline auto SpatialIndex::cellX(f64 x) const -> isize
+{
+    // Written so that NaN lands on -1 too
+    const f64 cell = std::floor(x / m_CellSize - m_Origin.x / m_CellSize);
+    return cell >= static_cast<f64>(m_Columns) ? static_cast<isize>(m_Columns) : cell > -1.0 ? static_cast<isize>(cell) : -1;
+}
+
+inline auto SpatialIndex::cellY(f64 y) const -> isize
+{
+    const f64 cell = std::floor(y / m_CellSize - m_Origin.y / m_CellSize);
+    return cell >= static_cast<f64>(m_Rows) ? static_cast<isize>(m_Rows) : cell > -1.0 ? static_cast<isize>(cell) : -1;
+}
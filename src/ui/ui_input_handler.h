@@ -1,18 +1,17 @@
 #pragma once
 
+#include <algorithm>
+#include <cmath>
+#include <memory_resource>
 #include <vector>
 
 #include "config.h"
+#include "log.h"
 
 #include "ui/actions/action.h"
 #include "ui/canvas_view_model.h"
 
 #include "ui/events/event.h"
-#include "ui/events/ui_drag_drop_event.h"
-#include "ui/events/ui_drag_ended_event.h"
-#include "ui/events/ui_drag_started_event.h"
-#include "ui/events/ui_drag_update_event.h"
-#include "ui/events/ui_mouse_click_event.h"
 
 class UIInputHandler final
 {
@@ -20,16 +19,30 @@ public:
     UIInputHandler();
     ~UIInputHandler();
 
-    auto handleInput(CanvasViewModel* canvasViewModel, std::vector<std::unique_ptr<Action>> actions) -> std::vector<std::unique_ptr<Event>>;
+    // Appends the events built from this frame's actions to events
+    void handleInput(CanvasViewModel* canvasViewModel, std::pmr::vector<Action> const& actions, std::pmr::vector<Event>& events);
 
 private:
     Position m_CursorPosition;
     Delta    m_CursorDelta;
 
-    bool     m_IsDragging = false;
-    bool     m_HasDragged = false;
-    Position m_DragStart;
-    Position m_DragEnd;
+    // What a drag does is decided when it starts
+    enum class DragMode
+    {
+        Pan,    // Shift held
+        Move,   // Started on a component
+        Select, // Started on empty canvas
+    };
+
+    void select(CanvasViewModel* canvasViewModel, std::vector<ComponentId> selection, std::pmr::vector<Event>& events);
+
+    bool        m_IsDragging = false;
+    bool        m_HasDragged = false;
+    bool        m_PanHeld    = false;
+    Position    m_DragStart;
+    Position    m_DragEnd;
+    DragMode    m_DragMode      = DragMode::Pan;
+    ComponentId m_DragComponent = kInvalidComponentId;
 };
 
 inline UIInputHandler::UIInputHandler()
@@ -40,101 +53,140 @@ inline UIInputHandler::~UIInputHandler()
 {
 }
 
-inline auto UIInputHandler::handleInput(CanvasViewModel* canvasViewModel, std::vector<std::unique_ptr<Action>> actions) -> std::vector<std::unique_ptr<Event>>
+inline void UIInputHandler::handleInput(CanvasViewModel* canvasViewModel, std::pmr::vector<Action> const& actions, std::pmr::vector<Event>& events)
 {
-    std::vector<std::unique_ptr<Event>> events;
-
-    for (auto& action : actions)
+    for (auto const& action : actions)
     {
-        // spdlog::info("UIInputHandler::handleInput: action={}", action->getName());
-
-        // TODO: Do the type lookup without using the name, lol!
+        // spdlog::info("UIInputHandler::handleInput: action={}", toString(action));
 
-        if (action->getName() == "UIMouseDownAction" && !m_IsDragging)
-        {
-            auto dragAction = static_cast<UIMouseDownAction*>(action.get());
-            m_IsDragging    = true;
-            m_DragStart     = m_CursorPosition;
-        }
-
-        if (action->getName() == "UIMouseMovedAction")
-        {
-            auto moveAction  = static_cast<UIMouseMovedAction*>(action.get());
-            m_CursorPosition = Position(moveAction->x, moveAction->y);
-            m_CursorDelta    = Delta(moveAction->dx, moveAction->dy);
-
-            if (m_IsDragging)
+        std::visit(overloaded{
+            [&](UIMouseDownAction const& mouseDownAction)
             {
-                if (!m_HasDragged)
+                if (!m_IsDragging)
                 {
-                    events.emplace_back(std::make_unique<UIDragStartedEvent>());
-                    m_HasDragged = true;
+                    m_IsDragging = true;
+                    m_PanHeld    = mouseDownAction.shift;
+                    m_DragStart  = m_CursorPosition;
                 }
+            },
+            [&](UIMouseMovedAction const& moveAction)
+            {
+                m_CursorPosition = Position(moveAction.x, moveAction.y);
+                m_CursorDelta    = Delta(moveAction.dx, moveAction.dy);
 
-                events.emplace_back(std::make_unique<UIDragUpdateEvent>());
-
-                // TODO: Should this be in here, or up one level?
-                canvasViewModel->m_Offset.dx += m_CursorDelta.dx;
-                canvasViewModel->m_Offset.dy += m_CursorDelta.dy;
-            }
+                if (m_IsDragging)
+                {
+                    if (!m_HasDragged)
+                    {
+                        const auto start = canvasViewModel->toWorld(m_DragStart);
+                        m_DragComponent  = m_PanHeld ? kInvalidComponentId : canvasViewModel->componentAt(start);
+                        m_DragMode       = m_PanHeld ? DragMode::Pan : m_DragComponent != kInvalidComponentId ? DragMode::Move : DragMode::Select;
+                        events.emplace_back(UIDragStartedEvent(start, m_DragComponent));
+                        m_HasDragged = true;
+                    }
+
+                    const auto zoom = canvasViewModel->m_Zoom;
+                    events.emplace_back(UIDragUpdateEvent(Delta(m_CursorDelta.dx / zoom, m_CursorDelta.dy / zoom)));
+
+                    // TODO: Should this be in here, or up one level?
+                    if (m_DragMode == DragMode::Pan)
+                    {
+                        canvasViewModel->m_Offset.dx += m_CursorDelta.dx;
+                        canvasViewModel->m_Offset.dy += m_CursorDelta.dy;
+                    }
+                    else if (m_DragMode == DragMode::Select)
+                    {
+                        canvasViewModel->setSelectionBox(canvasViewModel->toWorld(m_DragStart), canvasViewModel->toWorld(m_CursorPosition));
+                    }
+                }
 
-            // If the mouse has moved, we have to check the visible components on the canvas
-            // to see if we're hovering over any of them.
-            // TODO: Culling & caching
-            for (auto& nandViewModel : canvasViewModel->m_NANDs)
-            {
-                if (canvasViewModel->m_Offset.dx + nandViewModel.position.x * canvasViewModel->m_Zoom <= m_CursorPosition.x &&
-                    canvasViewModel->m_Offset.dy + nandViewModel.position.y * canvasViewModel->m_Zoom <= m_CursorPosition.y &&
-                    canvasViewModel->m_Offset.dx + nandViewModel.position.x * canvasViewModel->m_Zoom + nandViewModel.size.width * canvasViewModel->m_Zoom >= m_CursorPosition.x &&
-                    canvasViewModel->m_Offset.dy + nandViewModel.position.y * canvasViewModel->m_Zoom + nandViewModel.size.height * canvasViewModel->m_Zoom >= m_CursorPosition.y)
+                // If the mouse has moved, we have to check the visible components on the canvas
+                // to see if we're hovering over any of them.
+                const auto cursor = canvasViewModel->toWorld(m_CursorPosition);
+                canvasViewModel->m_SpatialIndex.query(cursor, cursor, [&](u32 index)
                 {
                     // Component hovered
-                    spdlog::info("UIInputHandler::handleInput: nandViewModel={}", nandViewModel.toString());
+                    LOG_TRACE_EVERY(Config::kLogIntervalMs, "UIInputHandler::handleInput: componentViewModel={}", canvasViewModel->m_Components[index].toString());
+                });
+            },
+            [&](UIMouseUpAction const&)
+            {
+                if (!m_IsDragging)
+                {
+                    return;
                 }
-            }
-        }
 
-        if (action->getName() == "UIMouseUpAction" && m_IsDragging)
-        {
-            m_DragEnd = m_CursorPosition;
-            if (m_DragStart.x != m_DragEnd.x || m_DragStart.y != m_DragEnd.y)
+                m_DragEnd = m_CursorPosition;
+                if (m_DragStart.x != m_DragEnd.x || m_DragStart.y != m_DragEnd.y)
+                {
+                    if (m_HasDragged && m_DragMode == DragMode::Select)
+                    {
+                        const auto a = canvasViewModel->toWorld(m_DragStart);
+                        const auto b = canvasViewModel->toWorld(m_DragEnd);
+
+                        std::vector<ComponentId> selection;
+                        canvasViewModel->m_SpatialIndex.query({ std::min(a.x, b.x), std::min(a.y, b.y) }, { std::max(a.x, b.x), std::max(a.y, b.y) }, [&](u32 index)
+                        {
+                            selection.push_back(canvasViewModel->m_Components[index].id);
+                        });
+
+                        canvasViewModel->clearSelectionBox();
+                        select(canvasViewModel, std::move(selection), events);
+                    }
+
+                    events.emplace_back(UIDragEndedEvent());
+                }
+                else
+                {
+                    // Clicking selects whatever is under the cursor, or clears the selection
+                    std::vector<ComponentId> selection;
+                    if (const auto component = canvasViewModel->componentAt(canvasViewModel->toWorld(m_DragEnd)); component != kInvalidComponentId)
+                    {
+                        selection.push_back(component);
+                    }
+
+                    select(canvasViewModel, std::move(selection), events);
+                    events.emplace_back(UIMouseClickEvent());
+                }
+
+                m_IsDragging    = false;
+                m_HasDragged    = false;
+                m_DragComponent = kInvalidComponentId;
+            },
+            [&](UICanvasHoveredAction const&)
+            {
+                m_IsDragging = false;
+            },
+            [&](UIDragDropAction const& dragDropAction)
             {
-                events.emplace_back(std::make_unique<UIDragEndedEvent>());
-            }
-            else
+                // Dropped at a canvas position, placed at the world position under it
+                const auto world = canvasViewModel->toWorld(Position(dragDropAction.x, dragDropAction.y));
+                events.emplace_back(UIDragDropEvent(static_cast<f32>(world.x), static_cast<f32>(world.y), dragDropAction.type));
+            },
+            [&](UIKeypressAction const& keypressAction)
             {
-                events.emplace_back(std::make_unique<UIMouseClickEvent>());
-            }
-
-            m_IsDragging = false;
-            m_HasDragged = false;
-        }
-
-        if (action->getName() == "UICanvasHoveredAction")
-        {
-            m_IsDragging = false;
-        }
-
-        if (action->getName() == "UIDragDropAction")
-        {
-            auto dragDropAction = static_cast<UIDragDropAction*>(action.get());
-            events.emplace_back(std::make_unique<UIDragDropEvent>(dragDropAction->x, dragDropAction->y, dragDropAction->payload));
-        }
-
-        if (action->getName() == "UISimControlAction")
-        {
-            auto simControlAction = static_cast<UISimControlAction*>(action.get());
-            spdlog::info("UIInputHandler::handleInput: {}", simControlAction->toString());
-        }
-
-        if (action->getName() == "UIMouseWheelAction")
-        {
-            auto wheelAction = static_cast<UIMouseWheelAction*>(action.get());
-            spdlog::info("UIInputHandler::handleInput: {}", wheelAction->toString());
-
-            canvasViewModel->m_Zoom += wheelAction->val * 0.1f;
-        }
+                events.emplace_back(UIKeypressEvent(keypressAction.val, keypressAction.ctrl));
+            },
+            [&](UISimControlAction const& simControlAction)
+            {
+                spdlog::info("UIInputHandler::handleInput: {}", simControlAction.toString());
+            },
+            [&](UIMouseWheelAction const& wheelAction)
+            {
+                LOG_DEBUG_EVERY(Config::kLogIntervalMs, "UIInputHandler::handleInput: {}", wheelAction.toString());
+
+                canvasViewModel->m_Zoom = std::clamp(canvasViewModel->m_Zoom * std::pow(Config::kZoomStep, wheelAction.val), Config::kMinZoom, Config::kMaxZoom);
+            },
+            [&](auto const&)
+            {
+            },
+        }, action);
     }
+}
 
-    return events;
+inline void UIInputHandler::select(CanvasViewModel* canvasViewModel, std::vector<ComponentId> selection, std::pmr::vector<Event>& events)
+{
+    auto components = makeComponentSet(std::move(selection));
+    canvasViewModel->setSelection(*components);
+    events.emplace_back(UISelectionChangedEvent(std::move(components)));
 }
@@ -0,0 +1,134 @@
+#include "simulation/circuit_file.h"
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <string>
+#include <vector>
+
+// Saves a small circuit, then checks that each kind of corruption validate() looks for gets the file
+// rejected, and that the untouched file still opens.
+namespace
+{
+    int s_Failures = 0;
+
+    void check(bool condition, std::string const& what)
+    {
+        if (!condition)
+        {
+            std::fprintf(stderr, "FAILED: %s\n", what.c_str());
+            ++s_Failures;
+        }
+    }
+
+    // The saved file's bytes, with helpers for finding a section's elements in them
+    struct FileBytes final
+    {
+        std::vector<char> bytes;
+
+        auto entry(CircuitFile::Section id) -> CircuitFile::SectionEntry*
+        {
+            auto const& header = *reinterpret_cast<CircuitFile::Header const*>(bytes.data());
+            auto*       table  = reinterpret_cast<CircuitFile::SectionEntry*>(bytes.data() + sizeof(CircuitFile::Header));
+            for (u32 i = 0; i < header.sectionCount; ++i)
+            {
+                if (table[i].id == id)
+                {
+                    return &table[i];
+                }
+            }
+            return nullptr;
+        }
+
+        template <typename T>
+        auto at(CircuitFile::Section id, usize index) -> T&
+        {
+            return reinterpret_cast<T*>(bytes.data() + entry(id)->offset)[index];
+        }
+    };
+
+    auto readFile(std::string const& path) -> FileBytes
+    {
+        std::ifstream stream(path, std::ios::binary);
+        return { std::vector<char>((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>()) };
+    }
+
+    auto opens(FileBytes const& file, std::string const& path) -> bool
+    {
+        std::ofstream(path, std::ios::binary | std::ios::trunc).write(file.bytes.data(), file.bytes.size());
+        return MappedCircuitFile::open(path) != nullptr;
+    }
+} // namespace
+
+int main()
+{
+    using CircuitFile::Section;
+
+    const auto path      = (std::filesystem::temp_directory_path() / "nandy_circuit_file_test.nandy").string();
+    const auto corrupted = (std::filesystem::temp_directory_path() / "nandy_circuit_file_test_corrupted.nandy").string();
+
+    // A clock into a chain of nodes into a NAND, whose output feeds a second NAND
+    Circuit    circuit;
+    const auto clock = circuit.addComponent(ComponentKind::Clock, { 0.0, 0.0 });
+    const auto a     = circuit.addComponent(ComponentKind::Node, { 10.0, 0.0 });
+    const auto b     = circuit.addComponent(ComponentKind::Node, { 20.0, 0.0 });
+    const auto first = circuit.addComponent(ComponentKind::NAND, { 30.0, 0.0 });
+    const auto other = circuit.addComponent(ComponentKind::NAND, { 40.0, 0.0 });
+
+    const std::vector<Wire> wires = {
+        { circuit.nodeOf(clock, 0), circuit.nodeOf(a, 0) },
+        { circuit.nodeOf(a, 0), circuit.nodeOf(b, 0) },
+        { circuit.nodeOf(b, 0), circuit.nodeOf(first, 0) },
+        { circuit.nodeOf(b, 0), circuit.nodeOf(first, 1) },
+        { circuit.nodeOf(first, 2), circuit.nodeOf(other, 0) },
+    };
+    circuit.connect(wires);
+    circuit.step();
+
+    check(CircuitFile::save(circuit, path), "saving the circuit");
+    check(!std::filesystem::exists(path + ".tmp"), "the save's temporary file is renamed into place");
+    check(!CircuitFile::save(circuit, path + ".missing/circuit.nandy"), "a save that can't be written fails");
+    const FileBytes original = readFile(path);
+    check(opens(original, corrupted), "the untouched file opens");
+
+    struct Corruption final
+    {
+        std::string                      what;
+        std::function<void(FileBytes&)> apply;
+    };
+
+    const std::vector<Corruption> corruptions = {
+        { "fanout starts going down", [&](FileBytes& file) { file.at<u32>(Section::FanoutStarts, 2) = file.at<u32>(Section::FanoutStarts, 1) + 5; } },
+        { "fanout starts not ending at the fanout's size", [&](FileBytes& file) { file.at<u32>(Section::FanoutStarts, circuit.nodeComponents.size()) -= 1; } },
+        { "reader starts not starting at 0", [&](FileBytes& file) { file.at<u32>(Section::ReaderStarts, 0) = 1; } },
+        { "a gate that isn't a NAND", [&](FileBytes& file) { file.at<ComponentId>(Section::Gates, 0) = a; } },
+        { "a gate that was removed", [&](FileBytes& file) { file.at<u8>(Section::Alive, first) = 0; } },
+        { "gates out of order", [&](FileBytes& file) { std::swap(file.at<ComponentId>(Section::Gates, 0), file.at<ComponentId>(Section::Gates, 1)); } },
+        { "a reader that isn't a NAND", [&](FileBytes& file) { file.at<ComponentId>(Section::Readers, 0) = clock; } },
+        { "a clock that isn't a clock's node", [&](FileBytes& file) { file.at<NodeId>(Section::Clocks, 0) = circuit.nodeOf(first, 2); } },
+        { "a facing out of range", [&](FileBytes& file) { file.at<u32>(Section::Facings, 0) = 7; } },
+        { "a node that isn't one of its component's", [&](FileBytes& file) { file.at<ComponentId>(Section::NodeComponents, circuit.nodeOf(first, 1)) = a; } },
+        { "a net that isn't a root", [&](FileBytes& file) { file.at<NodeId>(Section::Nets, circuit.nodeOf(b, 0)) = circuit.nodeOf(a, 0); } },
+        { "a wire between two nets", [&](FileBytes& file) { file.at<NodeId>(Section::Fanout, 0) = circuit.nodeOf(other, 1); } },
+        { "an unknown kind name", [&](FileBytes& file) { file.bytes[file.entry(Section::KindNames)->offset] = 'X'; } },
+        { "a kind past the name table", [&](FileBytes& file) { file.at<u8>(Section::Kinds, 0) = 200; } },
+    };
+
+    for (auto const& corruption : corruptions)
+    {
+        FileBytes file = original;
+        corruption.apply(file);
+        check(!opens(file, corrupted), "rejects " + corruption.what);
+    }
+
+    std::filesystem::remove(path);
+    std::filesystem::remove(corrupted);
+
+    if (s_Failures == 0)
+    {
+        std::printf("circuit_file_test: all %zu corruptions rejected\n", corruptions.size());
+    }
+    return s_Failures == 0 ? 0 : 1;
+}
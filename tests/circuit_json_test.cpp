@@ -0,0 +1,140 @@
+#include "simulation/circuit_json.h"
+
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+// Feeds the JSON reader good and bad documents. Bad ones must be turned down with the reason the reader
+// gives for them, count hints must only be trusted when they're sensible, and a saved circuit must load
+// back as it was.
+namespace
+{
+    int s_Failures = 0;
+
+    void check(bool condition, std::string const& what)
+    {
+        if (!condition)
+        {
+            std::fprintf(stderr, "FAILED: %s\n", what.c_str());
+            ++s_Failures;
+        }
+    }
+
+    struct Result final
+    {
+        bool        loaded;
+        std::string error;
+    };
+
+    // Runs the reader over text the way CircuitJson::load() runs it over a file
+    auto read(std::string const& text, Circuit& circuit) -> Result
+    {
+        CircuitJson::detail::Reader reader(circuit, nullptr, static_cast<long>(text.size()), {});
+        const bool                  loaded = json::sax_parse(text, &reader) && reader.finish();
+        return { loaded, reader.error() };
+    }
+
+    void expectError(std::string const& text, std::string const& reason, std::string const& what)
+    {
+        Circuit    circuit;
+        const auto result = read(text, circuit);
+        check(!result.loaded, "rejects " + what);
+        check(result.error.find(reason) != std::string::npos, what + " gives '" + reason + "', not '" + result.error + "'");
+    }
+} // namespace
+
+int main()
+{
+    const std::string components = R"("components": [ { "kind": "NAND", "x": 0, "y": 0 }, { "kind": "NODE", "x": 10, "y": 0 } ])";
+
+    // Only an object will do at the top level
+    expectError(R"([ 1, 2 ])", "expected an object at the top level", "a top-level array");
+    expectError(R"(42)", "unexpected number", "a top-level number");
+    expectError(R"("circuit")", "unexpected string", "a top-level string");
+    expectError(R"(null)", "unexpected null", "a top-level null");
+    expectError(R"(true)", "unexpected boolean", "a top-level boolean");
+
+    // Wires are two whole, non-negative node ids that exist
+    expectError("{" + components + R"(, "wires": [ [ 0 ] ] })", "doesn't have two ends", "a wire with one end");
+    expectError("{" + components + R"(, "wires": [ [ 0, 1, 2 ] ] })", "bad wire 0", "a wire with three ends");
+    expectError("{" + components + R"(, "wires": [ [ 0, -1 ] ] })", "bad wire 0", "a negative wire end");
+    expectError("{" + components + R"(, "wires": [ [ 0, 1.5 ] ] })", "bad wire 0", "a fractional wire end");
+    expectError("{" + components + R"(, "wires": [ [ 0, "1" ] ] })", "unexpected string", "a wire end that's a string");
+    expectError("{" + components + R"(, "wires": [ [ 0, 4 ] ] })", "doesn't exist", "a wire to a node past the end");
+    expectError(R"({ "wires": [ [ 0, 9 ] ], )" + components + " }", "doesn't exist", "a wire read before the components, to a node they don't have");
+
+    // Components need a kind the registry knows, and a facing if they give one
+    expectError(R"({ "components": [ { "kind": "XOR3" } ] })", "unknown component kind 'XOR3'", "an unknown kind");
+    expectError(R"({ "components": [ { "kind": "NAND", "facing": "Sideways" } ] })", "unknown facing 'Sideways'", "an unknown facing");
+    expectError(R"({ "components": [ { "x": 5 } ] })", "component 0 has no kind", "a component with no kind");
+
+    expectError(R"({ "version": 99 })", "version 99", "a newer version");
+    expectError(R"({ "components": [ )", "parse error", "a truncated file");
+
+    {
+        // Things the reader doesn't know about are skipped, however they nest
+        Circuit    circuit;
+        const auto result = read(R"({ "version": 2, "author": "someone", "meta": { "tags": [ 1, { "a": null, "b": [ true ] } ] }, )" + components +
+                                     R"(, "wires": [ [ 2, 3 ] ], "notes": [ [ 1, 2, 3 ] ] })",
+                                 circuit);
+        check(result.loaded, "skips unknown keys, got '" + result.error + "'");
+        check(circuit.componentCount() == 2 && circuit.wires.size() == 1, "reads the known parts around unknown ones");
+    }
+
+    {
+        // Sensible count hints reserve up front
+        Circuit    circuit;
+        const auto result = read(R"({ "componentCount": 2, "nodeCount": 4, "wireCount": 1, )" + components + R"(, "wires": [ [ 2, 3 ] ] })", circuit);
+        check(result.loaded, "loads with count hints");
+        check(circuit.kinds.capacity() >= 2 && circuit.nodeComponents.capacity() >= 4 && circuit.wires.capacity() >= 1, "count hints reserve");
+    }
+
+    for (auto const* hint : { "1e18", "-5", "2.5", "1e400" })
+    {
+        // Hints that are huge, negative or fractional are ignored rather than reserved
+        Circuit    circuit;
+        const auto text   = std::string(R"({ "componentCount": )") + hint + R"(, "nodeCount": )" + hint + R"(, "wireCount": )" + hint + ", " + components + " }";
+        const auto result = read(text, circuit);
+        check(result.loaded || std::string(hint) == "1e400", std::string("loads with a count hint of ") + hint + ", got '" + result.error + "'");
+        check(circuit.kinds.capacity() < 1024 && circuit.nodeComponents.capacity() < 1024 && circuit.wires.capacity() < 1024, std::string("ignores a count hint of ") + hint);
+    }
+
+    {
+        // A saved circuit loads back the same, with removed components left out and the nodes renumbered
+        Circuit    circuit;
+        const auto gate    = circuit.addComponent(ComponentKind::NAND, { 1.5, -2.0 }, Facing::Down);
+        const auto removed = circuit.addComponent(ComponentKind::Node, { 0.0, 0.0 });
+        const auto node    = circuit.addComponent(ComponentKind::Node, { 30.0, 40.0 });
+        const auto clock   = circuit.addComponent(ComponentKind::Clock, { -10.0, 5.0 }, Facing::Left);
+        circuit.connect(std::vector<Wire>{ { circuit.nodeOf(clock, 0), circuit.nodeOf(gate, 0) }, { circuit.nodeOf(gate, 2), circuit.nodeOf(node, 0) } });
+        circuit.removeComponents(std::vector<ComponentId>{ removed });
+
+        const auto path = (std::filesystem::temp_directory_path() / "nandy_circuit_json_test.json").string();
+        check(CircuitJson::save(circuit, path), "saves");
+
+        Circuit loaded;
+        check(CircuitJson::load(path, loaded), "loads what it saved");
+        std::filesystem::remove(path);
+
+        const std::vector<ComponentId> live = { gate, node, clock };
+        check(loaded.componentCount() == live.size(), "only live components are saved");
+        for (ComponentId id = 0; id < std::min(loaded.componentCount(), live.size()); ++id)
+        {
+            const auto original = live[id];
+            check(loaded.kinds[id] == circuit.kinds[original] && loaded.facings[id] == circuit.facings[original] &&
+                      loaded.positions[id].x == circuit.positions[original].x && loaded.positions[id].y == circuit.positions[original].y,
+                  "component " + std::to_string(id) + " loads as it was saved");
+        }
+
+        check(loaded.wires.size() == 2 && loaded.wires[0].from == loaded.nodeOf(2, 0) && loaded.wires[0].to == loaded.nodeOf(0, 0) &&
+                  loaded.wires[1].from == loaded.nodeOf(0, 2) && loaded.wires[1].to == loaded.nodeOf(1, 0),
+              "wires load onto the renumbered nodes");
+    }
+
+    if (s_Failures == 0)
+    {
+        std::printf("circuit_json_test: every document read or rejected as expected\n");
+    }
+    return s_Failures == 0 ? 0 : 1;
+}
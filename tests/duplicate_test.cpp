@@ -0,0 +1,142 @@
+#include "simulation/circuit.h"
+#include "simulation/commands/duplicate_components_command.h"
+#include "simulation/history.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <ranges>
+#include <string>
+#include <vector>
+
+// Duplicates part of a small circuit through DuplicateComponentsCommand, which splices in a block with
+// appendBlock(), and checks the copy: same kinds and facings, offset positions, the wires inside the
+// selection and none of the ones leaving it, a netlist that matches a fresh build, and an undo and redo.
+namespace
+{
+    int s_Failures = 0;
+
+    void check(bool condition, std::string const& what)
+    {
+        if (!condition)
+        {
+            std::fprintf(stderr, "FAILED: %s\n", what.c_str());
+            ++s_Failures;
+        }
+    }
+
+    auto sameTables(Netlist const& a, Netlist const& b) -> bool
+    {
+        return a.gates == b.gates && a.clocks == b.clocks && a.nets == b.nets && a.fanoutStarts == b.fanoutStarts &&
+               a.readerStarts == b.readerStarts && a.readers == b.readers;
+    }
+} // namespace
+
+int main()
+{
+    // An SR latch from two cross-coupled NANDs, with a node on each input and one wire out to a node
+    // that isn't selected
+    Circuit    circuit;
+    const auto set     = circuit.addComponent(ComponentKind::Node, { 0.0, 0.0 });
+    const auto reset   = circuit.addComponent(ComponentKind::Node, { 0.0, 40.0 });
+    const auto top     = circuit.addComponent(ComponentKind::NAND, { 20.0, 0.0 });
+    const auto bottom  = circuit.addComponent(ComponentKind::NAND, { 20.0, 40.0 }, Facing::Left);
+    const auto outside = circuit.addComponent(ComponentKind::Node, { 60.0, 0.0 });
+    const auto removed = circuit.addComponent(ComponentKind::Node, { 5.0, 5.0 });
+
+    const std::vector<Wire> wires = {
+        { circuit.nodeOf(set, 0), circuit.nodeOf(top, 0) },
+        { circuit.nodeOf(reset, 0), circuit.nodeOf(bottom, 1) },
+        { circuit.nodeOf(top, 2), circuit.nodeOf(bottom, 0) },
+        { circuit.nodeOf(bottom, 2), circuit.nodeOf(top, 1) },
+        { circuit.nodeOf(top, 2), circuit.nodeOf(outside, 0) },
+        { circuit.nodeOf(removed, 0), circuit.nodeOf(set, 0) },
+    };
+    circuit.connect(wires);
+    circuit.removeComponents(std::vector<ComponentId>{ removed });
+    circuit.step();
+
+    History history(1u << 20);
+
+    // A removed component in the selection is left out of the copy
+    const std::vector<ComponentId> selection   = { set, reset, top, bottom, removed };
+    const usize                    before      = circuit.componentCount();
+    const usize                    wiresBefore = circuit.wires.size();
+
+    DuplicateComponentsCommand duplicate(selection, Delta(100.0, 50.0));
+    duplicate.apply(circuit, history);
+
+    const std::vector<ComponentId> originals = { set, reset, top, bottom };
+    check(duplicate.created.size() == originals.size(), "one copy per live selected component");
+    check(circuit.componentCount() == before + originals.size(), "the copies are appended");
+
+    for (usize i = 0; i < std::min(duplicate.created.size(), originals.size()); ++i)
+    {
+        const auto copy     = duplicate.created[i];
+        const auto original = originals[i];
+        const auto name     = "copy " + std::to_string(i);
+        check(copy == before + i, name + " is numbered in block order");
+        check(circuit.kinds[copy] == circuit.kinds[original], name + " has its original's kind");
+        check(circuit.facings[copy] == circuit.facings[original], name + " has its original's facing");
+        check(circuit.alive[copy], name + " is alive");
+        check(circuit.positions[copy].x == circuit.positions[original].x + 100.0 && circuit.positions[copy].y == circuit.positions[original].y + 50.0,
+              name + " is offset from its original");
+    }
+
+    // The four wires inside the selection come across, renumbered onto the copies. The ones to the
+    // unselected and removed nodes don't.
+    auto copyOf = [&](NodeId node)
+    {
+        const auto component = circuit.nodeComponents[node];
+        const auto index     = std::ranges::find(originals, component) - originals.begin();
+        return circuit.nodeOf(duplicate.created[index], node - circuit.firstNodes[component]);
+    };
+
+    std::vector<Wire> expected;
+    for (usize i = 0; i < 4; ++i)
+    {
+        expected.push_back({ copyOf(wires[i].from), copyOf(wires[i].to) });
+    }
+
+    const auto key = [](Wire const& wire)
+    {
+        return static_cast<u64>(wire.from) << 32 | wire.to;
+    };
+    auto added = std::vector<Wire>(circuit.wires.begin() + wiresBefore, circuit.wires.end());
+    std::ranges::sort(added, {}, key);
+    std::ranges::sort(expected, {}, key);
+    check(std::ranges::equal(added, expected, {}, key, key), "only the wires inside the selection are copied");
+    check(std::ranges::equal(duplicate.createdWires, circuit.wires | std::views::drop(wiresBefore), {}, key, key), "the command knows the wires it made");
+
+    // Splicing the block in was recorded as an edit, so the netlist is patched rather than rebuilt
+    circuit.step();
+    Netlist built;
+    built.build(circuit.kinds, circuit.alive, circuit.firstNodes, circuit.nodeComponents, circuit.wires);
+    check(sameTables(circuit.netlist(), built), "the patched netlist matches a build");
+
+    // Copying the copy gives the same block as copying the original
+    const auto fromOriginal = circuit.extractBlock(originals);
+    const auto fromCopy     = circuit.extractBlock(duplicate.created);
+    check(fromOriginal.kinds == fromCopy.kinds && fromOriginal.facings == fromCopy.facings && fromOriginal.firstNodes == fromCopy.firstNodes &&
+              fromOriginal.nodeComponents == fromCopy.nodeComponents && std::ranges::equal(fromOriginal.wires, fromCopy.wires, {}, key, key),
+          "the copy's block matches the original's");
+
+    check(history.undo(circuit), "the duplicate can be undone");
+    check(std::ranges::none_of(duplicate.created, [&](ComponentId id) { return circuit.alive[id]; }), "undo removes the copies");
+    check(circuit.wires.size() == wiresBefore, "undo removes the copied wires");
+
+    check(history.redo(circuit), "the duplicate can be redone");
+    check(std::ranges::all_of(duplicate.created, [&](ComponentId id) { return circuit.alive[id]; }), "redo brings the copies back");
+    check(circuit.wires.size() == wiresBefore + expected.size(), "redo brings the copied wires back");
+
+    // Nothing live selected, nothing copied or recorded
+    const usize undoCount = history.undoCount();
+    DuplicateComponentsCommand nothing(std::vector<ComponentId>{ removed }, Delta(10.0, 10.0));
+    nothing.apply(circuit, history);
+    check(nothing.created.empty() && history.undoCount() == undoCount, "duplicating only removed components does nothing");
+
+    if (s_Failures == 0)
+    {
+        std::printf("duplicate_test: copies match their originals\n");
+    }
+    return s_Failures == 0 ? 0 : 1;
+}
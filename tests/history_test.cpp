@@ -0,0 +1,290 @@
+#include "simulation/circuit.h"
+#include "simulation/commands/add_component_command.h"
+#include "simulation/commands/connect_components_command.h"
+#include "simulation/commands/disconnect_components_command.h"
+#include "simulation/commands/duplicate_components_command.h"
+#include "simulation/commands/mass_connect_command.h"
+#include "simulation/commands/move_components_command.h"
+#include "simulation/commands/remove_components_command.h"
+#include "simulation/history.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+// Applies random commands through a History, snapshotting the circuit after each undoable step, then
+// undoes and redoes the lot and checks every step lands back on its snapshot. Run once with room for
+// everything, and once with a history so small that old steps are evicted and its buffer compacted.
+namespace
+{
+    int s_Failures = 0;
+
+    void check(bool condition, std::string const& what)
+    {
+        if (!condition)
+        {
+            std::fprintf(stderr, "FAILED: %s\n", what.c_str());
+            ++s_Failures;
+        }
+    }
+
+    // What undo and redo have to put back: which components are alive, where they are, and the wires.
+    // Undoing an add leaves the dead components' slots behind, so later slots only have to be dead.
+    struct Snapshot final
+    {
+        std::vector<u8>       alive;
+        std::vector<Position> positions;
+        std::vector<Wire>     wires; // Sorted, copies and all
+    };
+
+    auto snapshot(Circuit const& circuit) -> Snapshot
+    {
+        Snapshot result = { circuit.alive, circuit.positions, circuit.wires };
+        std::ranges::sort(result.wires, {}, [](Wire const& wire)
+        {
+            return static_cast<u64>(wire.from) << 32 | wire.to;
+        });
+        return result;
+    }
+
+    auto matches(Circuit const& circuit, Snapshot const& expected) -> bool
+    {
+        const auto actual = snapshot(circuit);
+        for (ComponentId id = 0; id < actual.alive.size(); ++id)
+        {
+            const bool wasAlive = id < expected.alive.size() && expected.alive[id];
+            if (actual.alive[id] != wasAlive)
+            {
+                return false;
+            }
+
+            if (wasAlive && (actual.positions[id].x != expected.positions[id].x || actual.positions[id].y != expected.positions[id].y))
+            {
+                return false;
+            }
+        }
+
+        return std::ranges::equal(actual.wires, expected.wires, [](Wire const& a, Wire const& b)
+        {
+            return a.from == b.from && a.to == b.to;
+        });
+    }
+
+    void run(usize capacity, std::string const& name)
+    {
+        std::mt19937 random(7);
+        auto         below = [&](usize count)
+        {
+            return static_cast<usize>(random() % count);
+        };
+
+        Circuit circuit;
+        History history(capacity);
+        for (usize i = 0; i < 40; ++i)
+        {
+            circuit.addComponent(i % 2 ? ComponentKind::Node : ComponentKind::NAND, { static_cast<f64>(i % 8 * 10), static_cast<f64>(i / 8 * 10) });
+        }
+
+        auto liveIds = [&](usize count)
+        {
+            std::vector<ComponentId> ids;
+            for (usize i = 0; i < count; ++i)
+            {
+                const auto id = static_cast<ComponentId>(below(circuit.componentCount()));
+                if (circuit.alive[id])
+                {
+                    ids.push_back(id);
+                }
+            }
+            std::ranges::sort(ids);
+            ids.erase(std::ranges::unique(ids).begin(), ids.end());
+            return ids;
+        };
+
+        // Between live components' nodes, as the canvas only offers those
+        auto liveNode = [&]()
+        {
+            while (true)
+            {
+                const auto node = static_cast<NodeId>(below(circuit.nodeComponents.size()));
+                if (circuit.alive[circuit.nodeComponents[node]])
+                {
+                    return node;
+                }
+            }
+        };
+
+        auto randomWires = [&](usize count)
+        {
+            std::vector<Wire> wires;
+            for (usize i = 0; i < count; ++i)
+            {
+                wires.push_back({ liveNode(), liveNode() });
+            }
+            return wires;
+        };
+
+        // snapshots[n] is the circuit with n steps applied
+        std::vector<Snapshot> snapshots = { snapshot(circuit) };
+        u64                   transaction = 1;
+        for (usize step = 0; step < 300; ++step)
+        {
+            // Every step records one entry, bar a mass connect with no pairs left to wire
+            std::vector<std::unique_ptr<Command>> commands;
+            bool                                  massConnect = false;
+            switch (below(8))
+            {
+                case 0:
+                    commands.push_back(std::make_unique<AddComponentCommand>(static_cast<f32>(below(100)), static_cast<f32>(below(100)), below(2) ? ComponentType::NAND : ComponentType::Node));
+                    break;
+                case 1:
+                {
+                    // A drag: several moves of the same components in one transaction, which undo as one step
+                    const auto ids = makeComponentSet(liveIds(4));
+                    if (ids->empty())
+                    {
+                        continue;
+                    }
+
+                    for (usize i = 0; i < 3; ++i)
+                    {
+                        commands.push_back(std::make_unique<MoveComponentsCommand>(ids, Delta(static_cast<f64>(below(9)) - 4.0, static_cast<f64>(below(9)) - 4.0)));
+                    }
+                    break;
+                }
+                case 2:
+                {
+                    // Sometimes repeating a wire that's already there
+                    auto wires = randomWires(3);
+                    if (!circuit.wires.empty() && below(2))
+                    {
+                        wires.push_back(circuit.wires[below(circuit.wires.size())]);
+                    }
+                    commands.push_back(std::make_unique<ConnectComponentsCommand>(std::move(wires)));
+                    break;
+                }
+                case 3:
+                {
+                    if (circuit.wires.empty())
+                    {
+                        continue;
+                    }
+
+                    // Some of the wires, plus one that probably isn't there
+                    std::vector<Wire> wires = randomWires(1);
+                    for (usize i = 0; i < 2; ++i)
+                    {
+                        wires.push_back(circuit.wires[below(circuit.wires.size())]);
+                    }
+                    commands.push_back(std::make_unique<DisconnectComponentCommand>(std::move(wires)));
+                    break;
+                }
+                case 4:
+                case 5:
+                {
+                    const auto ids = liveIds(below(2) ? 2 : 5);
+                    if (ids.empty())
+                    {
+                        continue;
+                    }
+
+                    if (below(2))
+                    {
+                        commands.push_back(std::make_unique<RemoveComponentsCommand>(ids));
+                    }
+                    else
+                    {
+                        commands.push_back(std::make_unique<DuplicateComponentsCommand>(ids, Delta(20.0, 20.0)));
+                    }
+                    break;
+                }
+                case 6:
+                    commands.push_back(std::make_unique<MassConnectCommand>(liveIds(8)));
+                    massConnect = true;
+                    break;
+                case 7:
+                {
+                    // Undo a little and then edit, which drops the steps that could have been redone
+                    const usize back = std::min<usize>(below(3) + 1, history.undoCount());
+                    for (usize i = 0; i < back; ++i)
+                    {
+                        history.undo(circuit);
+                        snapshots.pop_back();
+                    }
+                    check(matches(circuit, snapshots.back()), name + ": undo before an edit, step " + std::to_string(step));
+                    commands.push_back(std::make_unique<ConnectComponentsCommand>(randomWires(1)));
+                    break;
+                }
+            }
+
+            const usize wireCount = circuit.wires.size();
+            for (auto& command : commands)
+            {
+                command->transaction = commands.size() > 1 ? transaction : 0;
+                command->apply(circuit, history);
+            }
+            ++transaction;
+
+            check(history.redoCount() == 0, name + ": an edit leaves nothing to redo, step " + std::to_string(step));
+
+            if (!massConnect || circuit.wires.size() != wireCount)
+            {
+                snapshots.push_back(snapshot(circuit));
+            }
+        }
+
+        check(history.bytes() <= history.capacity() || history.undoCount() == 1, name + ": history stays within its capacity");
+
+        // Only the newest steps are still there if some were evicted
+        const usize steps = history.undoCount();
+        const usize first = snapshots.size() - 1 - steps;
+        check(matches(circuit, snapshots.back()), name + ": circuit matches the last snapshot");
+
+        for (usize undone = 1; undone <= steps; ++undone)
+        {
+            check(history.undo(circuit), name + ": undo " + std::to_string(undone));
+            check(matches(circuit, snapshots[snapshots.size() - 1 - undone]), name + ": state after undo " + std::to_string(undone));
+        }
+        check(!history.undo(circuit), name + ": nothing left to undo");
+        check(matches(circuit, snapshots[first]), name + ": undone back to the oldest kept step");
+
+        for (usize redone = 1; redone <= steps; ++redone)
+        {
+            check(history.redo(circuit), name + ": redo " + std::to_string(redone));
+            check(matches(circuit, snapshots[first + redone]), name + ": state after redo " + std::to_string(redone));
+        }
+        check(!history.redo(circuit), name + ": nothing left to redo");
+
+        std::printf("history_test: %s, %zu of %zu steps kept\n", name.c_str(), steps, snapshots.size() - 1);
+    }
+} // namespace
+
+int main()
+{
+    {
+        // Undoing a connect that repeated a wire only takes away the copy it added
+        Circuit    circuit;
+        History    history(1024);
+        const auto a    = circuit.addComponent(ComponentKind::Node, { 0.0, 0.0 });
+        const auto b    = circuit.addComponent(ComponentKind::Node, { 10.0, 0.0 });
+        const Wire wire = { circuit.nodeOf(a, 0), circuit.nodeOf(b, 0) };
+
+        ConnectComponentsCommand({ wire }).apply(circuit, history);
+        ConnectComponentsCommand({ wire }).apply(circuit, history);
+        history.undo(circuit);
+        check(circuit.wires.size() == 1, "undoing a repeated connect leaves the first copy");
+
+        DisconnectComponentCommand({ wire, wire }).apply(circuit, history);
+        history.undo(circuit);
+        check(circuit.wires.size() == 1, "undoing a disconnect puts back only what it removed");
+        history.redo(circuit);
+        check(circuit.wires.empty(), "redoing the disconnect removes it again");
+    }
+
+    run(64u << 20, "everything kept");
+    run(2048, "old steps evicted");
+    return s_Failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,216 @@
+#include "parallel.h"
+#include "simulation/netlist.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+// Builds netlists for random circuits and checks them against tables worked out the slow, obvious way:
+// nets by walking each node's wires, each rooted at its lowest node. Circuits big enough to unite their
+// nets across threads are built with one worker and with several, which must come out the same. The
+// several-worker builds are the ones to run under -fsanitize=thread.
+namespace
+{
+    int s_Failures = 0;
+
+    void check(bool condition, std::string const& what)
+    {
+        if (!condition)
+        {
+            std::fprintf(stderr, "FAILED: %s\n", what.c_str());
+            ++s_Failures;
+        }
+    }
+
+    // The arrays of a circuit, laid out as Circuit keeps them
+    struct Arrays final
+    {
+        std::vector<ComponentKind> kinds;
+        std::vector<u8>            alive;
+        std::vector<NodeId>        firstNodes;
+        std::vector<ComponentId>   nodeComponents;
+        std::vector<Wire>          wires;
+    };
+
+    auto randomArrays(usize components, usize wires, u32 seed) -> Arrays
+    {
+        std::mt19937 random(seed);
+
+        Arrays arrays;
+        for (ComponentId id = 0; id < components; ++id)
+        {
+            const auto kind = random() % 16 == 0 ? ComponentKind::Clock : random() % 2 ? ComponentKind::NAND : ComponentKind::Node;
+            arrays.kinds.push_back(kind);
+            arrays.alive.push_back(random() % 8 != 0);
+            arrays.firstNodes.push_back(static_cast<NodeId>(arrays.nodeComponents.size()));
+            arrays.nodeComponents.insert(arrays.nodeComponents.end(), componentInfo(kind).nodeCount, id);
+        }
+
+        // Mostly between nearby nodes, so there are plenty of nets of every size rather than one giant one
+        const auto nodes = arrays.nodeComponents.size();
+        for (usize i = 0; i < wires; ++i)
+        {
+            const auto from = static_cast<NodeId>(random() % nodes);
+            const auto to   = random() % 4 == 0 ? static_cast<NodeId>(random() % nodes) : static_cast<NodeId>((from + 1 + random() % 8) % nodes);
+            arrays.wires.push_back({ from, to });
+        }
+        return arrays;
+    }
+
+    auto build(Arrays const& arrays) -> Netlist
+    {
+        Netlist netlist;
+        netlist.build(arrays.kinds, arrays.alive, arrays.firstNodes, arrays.nodeComponents, arrays.wires);
+        return netlist;
+    }
+
+    // Each node's net, by its lowest node, found by flooding out from every node not yet reached in ascending order
+    auto referenceNets(Arrays const& arrays) -> std::vector<NodeId>
+    {
+        const auto                       nodes = arrays.nodeComponents.size();
+        std::vector<std::vector<NodeId>> neighbours(nodes);
+        for (auto const& wire : arrays.wires)
+        {
+            neighbours[wire.from].push_back(wire.to);
+            neighbours[wire.to].push_back(wire.from);
+        }
+
+        std::vector<NodeId> nets(nodes, kInvalidNodeId);
+        std::vector<NodeId> stack;
+        for (NodeId root = 0; root < nodes; ++root)
+        {
+            if (nets[root] != kInvalidNodeId)
+            {
+                continue;
+            }
+
+            nets[root] = root;
+            stack.push_back(root);
+            while (!stack.empty())
+            {
+                const auto node = stack.back();
+                stack.pop_back();
+                for (auto next : neighbours[node])
+                {
+                    if (nets[next] == kInvalidNodeId)
+                    {
+                        nets[next] = root;
+                        stack.push_back(next);
+                    }
+                }
+            }
+        }
+        return nets;
+    }
+
+    void checkAgainstReference(Netlist const& netlist, Arrays const& arrays, std::string const& what)
+    {
+        const auto nets = referenceNets(arrays);
+        check(netlist.nets == nets, what + ": nets");
+
+        // Fanout lists each node's wires in wire order
+        std::vector<std::vector<NodeId>> fanout(arrays.nodeComponents.size());
+        for (auto const& wire : arrays.wires)
+        {
+            fanout[wire.from].push_back(wire.to);
+        }
+
+        bool fanoutMatches = netlist.fanoutStarts.size() == fanout.size() + 1;
+        for (NodeId node = 0; fanoutMatches && node < fanout.size(); ++node)
+        {
+            fanoutMatches = std::ranges::equal(std::span(netlist.fanout).subspan(netlist.fanoutStarts[node], netlist.fanoutStarts[node + 1] - netlist.fanoutStarts[node]), fanout[node]);
+        }
+        check(fanoutMatches, what + ": fanout");
+
+        // Live gates and clocks in id order, and each gate listed under the nets of its two inputs
+        std::vector<ComponentId>              gates;
+        std::vector<NodeId>                   clocks;
+        std::vector<std::vector<ComponentId>> readers(arrays.nodeComponents.size());
+        for (ComponentId id = 0; id < arrays.kinds.size(); ++id)
+        {
+            if (arrays.alive[id] && arrays.kinds[id] == ComponentKind::NAND)
+            {
+                gates.push_back(id);
+                readers[nets[arrays.firstNodes[id]]].push_back(id);
+                readers[nets[arrays.firstNodes[id] + 1]].push_back(id);
+            }
+            else if (arrays.alive[id] && arrays.kinds[id] == ComponentKind::Clock)
+            {
+                clocks.push_back(arrays.firstNodes[id]);
+            }
+        }
+        check(netlist.gates == gates, what + ": gates");
+        check(netlist.clocks == clocks, what + ": clocks");
+
+        bool readersMatch = netlist.readerStarts.size() == readers.size() + 1;
+        for (NodeId net = 0; readersMatch && net < readers.size(); ++net)
+        {
+            auto listed = std::vector<ComponentId>(netlist.readers.begin() + netlist.readerStarts[net], netlist.readers.begin() + netlist.readerStarts[net + 1]);
+            std::ranges::sort(readers[net]);
+            readersMatch = listed == readers[net];
+        }
+        check(readersMatch, what + ": readers");
+
+        // Every net's ring goes through all of its nodes and no others
+        std::vector<u32> netSizes(nets.size(), 0);
+        for (auto net : nets)
+        {
+            ++netSizes[net];
+        }
+
+        bool ringsMatch = netlist.netNext.size() == nets.size();
+        for (NodeId root = 0; ringsMatch && root < nets.size(); ++root)
+        {
+            if (nets[root] != root)
+            {
+                continue;
+            }
+
+            u32    steps = 0;
+            NodeId node  = root;
+            do
+            {
+                ringsMatch = nets[node] == root && ++steps <= netSizes[root];
+                node       = netlist.netNext[node];
+            } while (ringsMatch && node != root);
+            ringsMatch = ringsMatch && steps == netSizes[root];
+        }
+        check(ringsMatch, what + ": net rings");
+    }
+} // namespace
+
+int main()
+{
+    // Small circuits, united on the calling thread
+    for (u32 seed = 1; seed <= 50; ++seed)
+    {
+        const auto arrays = randomArrays(200 + seed * 20, 300 + seed * 30, seed);
+        checkAgainstReference(build(arrays), arrays, "small circuit " + std::to_string(seed));
+    }
+
+    // Enough wires for several chunks, so the nets are united across threads whenever there's more than one worker
+    const auto arrays = randomArrays(250'000, 400'000, 99);
+
+    Parallel::setWorkerCount(1);
+    const auto serial = build(arrays);
+    checkAgainstReference(serial, arrays, "big circuit, 1 worker");
+
+    for (u32 workers : { 4u, 8u })
+    {
+        Parallel::setWorkerCount(workers);
+        const auto shared = build(arrays);
+        const auto what   = "big circuit, " + std::to_string(workers) + " workers";
+        check(shared.nets == serial.nets, what + ": nets match 1 worker's");
+        check(shared.fanout == serial.fanout && shared.readers == serial.readers, what + ": tables match 1 worker's");
+        checkAgainstReference(shared, arrays, what);
+    }
+    Parallel::setWorkerCount(0);
+
+    if (s_Failures == 0)
+    {
+        std::printf("netlist_build_test: all builds match the reference tables\n");
+    }
+    return s_Failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,210 @@
+#include "simulation/circuit.h"
+#include "simulation/netlist.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+// Makes rounds of random edits to a circuit, and after each one checks that the netlist the circuit
+// patched has the tables a build() from scratch would give it. Fanout is compared per node as a set
+// of wires, as patch() may leave a node's wires in a different order.
+namespace
+{
+    int s_Failures = 0;
+
+    void check(bool condition, std::string const& what)
+    {
+        if (!condition)
+        {
+            std::fprintf(stderr, "FAILED: %s\n", what.c_str());
+            ++s_Failures;
+        }
+    }
+
+    // Each node's fanout, sorted
+    auto sortedFanout(Netlist const& netlist) -> std::vector<NodeId>
+    {
+        auto fanout = netlist.fanout;
+        for (usize node = 0; node + 1 < netlist.fanoutStarts.size(); ++node)
+        {
+            std::sort(fanout.begin() + netlist.fanoutStarts[node], fanout.begin() + netlist.fanoutStarts[node + 1]);
+        }
+        return fanout;
+    }
+
+    // Whether every net's ring goes through exactly its nodes
+    auto ringsMatchNets(Netlist const& netlist) -> bool
+    {
+        std::vector<u32> netSizes(netlist.nets.size(), 0);
+        for (auto net : netlist.nets)
+        {
+            ++netSizes[net];
+        }
+
+        for (NodeId root = 0; root < netlist.nets.size(); ++root)
+        {
+            if (netlist.nets[root] != root)
+            {
+                continue;
+            }
+
+            u32    steps = 0;
+            NodeId node  = root;
+            do
+            {
+                if (netlist.nets[node] != root || ++steps > netSizes[root])
+                {
+                    return false;
+                }
+                node = netlist.netNext[node];
+            } while (node != root);
+
+            if (steps != netSizes[root])
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void compare(Circuit& circuit, usize round)
+    {
+        auto const& patched = circuit.netlist();
+
+        Netlist built;
+        built.build(circuit.kinds, circuit.alive, circuit.firstNodes, circuit.nodeComponents, circuit.wires);
+
+        const auto where = " after round " + std::to_string(round);
+        check(patched.gates == built.gates, "gates" + where);
+        check(patched.clocks == built.clocks, "clocks" + where);
+        check(patched.nets == built.nets, "nets" + where);
+        check(patched.fanoutStarts == built.fanoutStarts, "fanout starts" + where);
+        check(sortedFanout(patched) == sortedFanout(built), "fanout" + where);
+        check(patched.readerStarts == built.readerStarts, "reader starts" + where);
+        check(patched.readers == built.readers, "readers" + where);
+        check(ringsMatchNets(patched), "net rings" + where);
+    }
+} // namespace
+
+int main()
+{
+    constexpr usize kRounds = 2000;
+
+    std::mt19937 random(2024);
+    auto         below = [&](usize count)
+    {
+        return static_cast<usize>(random() % count);
+    };
+
+    const std::array kKinds = { ComponentKind::NAND, ComponentKind::Node, ComponentKind::Clock };
+    auto             place  = [&](Circuit& circuit)
+    {
+        // Mostly gates and nodes, the odd clock
+        const auto kind = below(16) == 0 ? ComponentKind::Clock : kKinds[below(2)];
+        return circuit.addComponent(kind, { static_cast<f64>(below(1000)), static_cast<f64>(below(1000)) });
+    };
+
+    auto randomWire = [&](Circuit const& circuit) -> Wire
+    {
+        return { static_cast<NodeId>(below(circuit.nodeComponents.size())), static_cast<NodeId>(below(circuit.nodeComponents.size())) };
+    };
+
+    // Enough wires that the edits each round stay well inside the budget for patching
+    Circuit circuit;
+    for (usize i = 0; i < 2000; ++i)
+    {
+        place(circuit);
+    }
+
+    std::vector<Wire> wires;
+    for (usize i = 0; i < 4000; ++i)
+    {
+        wires.push_back(randomWire(circuit));
+    }
+    circuit.connect(wires);
+    circuit.step();
+
+    std::vector<ComponentId> removed;
+    for (usize round = 0; round < kRounds; ++round)
+    {
+        const usize edits = 1 + below(8);
+        for (usize edit = 0; edit < edits; ++edit)
+        {
+            switch (below(7))
+            {
+                case 0:
+                {
+                    place(circuit);
+                    break;
+                }
+                case 1:
+                {
+                    // Sometimes a wire that's already there, which adds a second copy
+                    const auto wire = below(4) == 0 ? circuit.wires[below(circuit.wires.size())] : randomWire(circuit);
+                    circuit.connect({ &wire, 1 });
+                    break;
+                }
+                case 2:
+                {
+                    const auto wire = circuit.wires[below(circuit.wires.size())];
+                    circuit.disconnect({ &wire, 1 });
+                    break;
+                }
+                case 3:
+                {
+                    // Removed and added back before the netlist sees it, so the two cancel out
+                    const auto wire = circuit.wires[below(circuit.wires.size())];
+                    circuit.disconnect({ &wire, 1 });
+                    circuit.connect({ &wire, 1 });
+                    break;
+                }
+                case 4:
+                {
+                    const auto id = static_cast<ComponentId>(below(circuit.componentCount()));
+                    if (circuit.alive[id])
+                    {
+                        circuit.removeComponents({ &id, 1 });
+                        removed.push_back(id);
+                    }
+                    break;
+                }
+                case 5:
+                {
+                    if (!removed.empty())
+                    {
+                        const auto id = removed[below(removed.size())];
+                        std::erase(removed, id);
+                        circuit.restoreComponents({ &id, 1 });
+                    }
+                    break;
+                }
+                case 6:
+                {
+                    std::vector<ComponentId> ids;
+                    const auto               first = static_cast<ComponentId>(below(circuit.componentCount()));
+                    for (ComponentId id = first; id < std::min<usize>(first + 4, circuit.componentCount()); ++id)
+                    {
+                        ids.push_back(id);
+                    }
+                    circuit.appendBlock(circuit.extractBlock(ids), { 0.0, 0.0 });
+                    break;
+                }
+            }
+        }
+
+        circuit.step();
+        compare(circuit, round);
+        if (s_Failures > 0)
+        {
+            break;
+        }
+    }
+
+    if (s_Failures == 0)
+    {
+        std::printf("netlist_patch_test: %zu rounds of edits patched to the built tables\n", kRounds);
+    }
+    return s_Failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,85 @@
+#include "simulation/components/component_registry.h"
+#include "simulation/prefab_cache.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Rebuilds every library prefab from its factory and compares it with the copy in the disk cache. The
+// cache is kept in the working directory between runs, so a factory that changed without its recipe's
+// revision being bumped is caught against the copy built before the change. Prefabs with nothing cached
+// yet are built through the library, which caches them, and checked against what it wrote.
+namespace
+{
+    int s_Failures = 0;
+
+    void check(bool condition, std::string const& what)
+    {
+        if (!condition)
+        {
+            std::fprintf(stderr, "FAILED: %s\n", what.c_str());
+            ++s_Failures;
+        }
+    }
+
+    auto samePrefab(Prefab const& a, Prefab const& b) -> bool
+    {
+        auto samePosition = [](Position const& p, Position const& q)
+        {
+            return p.x == q.x && p.y == q.y;
+        };
+
+        return a.block.kinds == b.block.kinds && std::ranges::equal(a.block.positions, b.block.positions, samePosition) &&
+               a.block.facings == b.block.facings && a.block.firstNodes == b.block.firstNodes &&
+               a.block.nodeComponents == b.block.nodeComponents && a.block.wires == b.block.wires && a.inputs == b.inputs &&
+               a.outputs == b.outputs && a.size.width == b.size.width && a.size.height == b.size.height;
+    }
+} // namespace
+
+int main()
+{
+    auto& library = PrefabLibrary::get();
+
+    usize            fromEarlierRun = 0;
+    std::vector<u64> keys;
+    for (usize index = 0; index < kComponentTypeCount; ++index)
+    {
+        const auto  type = static_cast<ComponentType>(index);
+        auto const& info = componentTypeInfo(type);
+        if (info.isPrimitive())
+        {
+            continue;
+        }
+
+        const auto name = std::string(info.name);
+        const auto key  = prefabKey(type);
+        keys.push_back(key);
+
+        const auto fresh  = library.rebuild(type);
+        auto       cached = PrefabCache::load(key);
+        if (cached)
+        {
+            ++fromEarlierRun;
+            check(samePrefab(*cached, fresh), name + " matches its cached copy; if its factory changed, bump its revision in prefabRecipe()");
+        }
+        else
+        {
+            check(library.find(type) != nullptr && samePrefab(*library.find(type), fresh), name + " builds the same through the library");
+
+            cached = PrefabCache::load(key);
+            check(cached && samePrefab(*cached, fresh), name + " reads back from the cache as it was built");
+        }
+
+        check(fresh.inputs.size() == info.ports.inputs && fresh.outputs.size() == info.ports.outputs, name + " has the pins its registry entry says");
+    }
+
+    std::ranges::sort(keys);
+    check(std::ranges::adjacent_find(keys) == keys.end(), "every library component has its own key");
+
+    if (s_Failures == 0)
+    {
+        std::printf("prefab_cache_test: %zu prefabs match their cached copies, %zu from an earlier run\n", keys.size(), fromEarlierRun);
+    }
+    return s_Failures == 0 ? 0 : 1;
+}